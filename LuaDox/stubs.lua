@@ -205,6 +205,38 @@ function ofs.BeginDisabled(disabled) end
 -- @treturn nil
 function ofs.EndDisabled(disabled) end
 
+--- Jobs.
+-- @section jobs
+
+--- Run a function of a lua file on a worker thread
+--
+-- The file runs in its own lua state without access to `ofs` or `player`.
+-- Arguments and results are copied, only plain values, tables and scripts can be passed.
+-- Scripts are passed as an immutable `ScriptData` copy.
+-- Inside the job `progress(value)` reports a progress between 0 and 1 and `print` writes to the extension log once the job is done.
+-- @tparam string file Path relative to the extension directory
+-- @tparam string function Name of a global function in the file
+-- @tparam any args Passed to the function
+-- @tparam function callback Called with the result or nil and an error message
+-- @treturn Job job
+-- @example
+--   -- worker.lua
+--   function highest(args)
+--     local best = 0
+--     for idx = 1, #args.script do
+--       local at, pos = args.script:get(idx)
+--       best = math.max(best, pos)
+--       progress(idx / #args.script)
+--     end
+--     return best
+--   end
+--
+--   -- main.lua
+--   ofs.Job("worker.lua", "highest", { script = ofs.Script(ofs.ActiveIdx()) }, function(result, err)
+--     print(result or err)
+--   end)
+function ofs.Job(file, func, args, callback) end
+
 --- Player functions
 --
 -- @module player
@@ -274,6 +306,13 @@ path = ""
 -- @type string
 name = ""
 
+--- Read-only view over the actions without copying them
+--
+-- Only valid until the script changes. Nil for the clipboard.
+-- @meta read-only
+-- @type FunscriptView
+view = nil
+
 --- Gets if the script has a selection
 -- @treturn bool hasSelection
 function Funscript:hasSelection() end
@@ -283,6 +322,9 @@ function Funscript:hasSelection() end
 function Funscript:commit() end
 
 --- Sort the actions array
+--
+-- The actions are sorted by time to begin with. Call this after changing
+-- the time of actions or adding actions to keep the queries below fast.
 -- @treturn nil
 function Funscript:sort() end
 
@@ -304,6 +346,24 @@ function Funscript:closestActionAfter(time) end
 -- @treturn number index
 function Funscript:closestActionBefore(time) end
 
+--- Get the indices of the actions in a time range
+-- @tparam number fromTime Time in seconds
+-- @tparam number toTime Time in seconds, inclusive
+-- @treturn number first
+-- @treturn number last Smaller than first if there are none
+-- @example
+--   local first, last = script:actionsInRange(10.0, 20.0)
+--   for idx = first, last do
+--     print(script.actions[idx].pos)
+--   end
+function Funscript:actionsInRange(fromTime, toTime) end
+
+--- Get the index of the action at a given time
+-- @tparam number time Time in seconds
+-- @tparam number|nil maxErrorTime Allowed distance in seconds, defaults to 0
+-- @treturn number|nil index
+function Funscript:indexAtTime(time, maxErrorTime) end
+
 --- Get an array of selected indices into the actions array
 -- @treturn number[] indices
 function Funscript:selectedIndices() end
@@ -324,6 +384,55 @@ function Funscript:markForRemoval(actionIdx) end
 -- @treturn number removedCount
 function Funscript:removeMarked() end
 
+--- View returned by `script.view`
+--
+-- Reads the actions of the script directly, which avoids copying large scripts.
+-- Using it after the script was modified raises an error.
+-- @see funscript
+-- @display FunscriptView
+-- @class FunscriptView
+
+--- Number of actions, also available as `#view`
+-- @treturn number length
+function FunscriptView:length() end
+
+--- Gets if the view can still be used
+-- @meta read-only
+-- @type bool
+valid = true
+
+--- Get an action
+-- @tparam number idx
+-- @treturn number at Time in seconds
+-- @treturn number pos
+function FunscriptView:get(idx) end
+
+--- Gets if an action is selected
+-- @tparam number idx
+-- @treturn bool selected
+function FunscriptView:selected(idx) end
+
+--- Index of the first action at or after a given time
+-- @tparam number time Time in seconds
+-- @treturn number index Length + 1 if there is none
+function FunscriptView:lowerBound(time) end
+
+--- Index of the first action after a given time
+-- @tparam number time Time in seconds
+-- @treturn number index Length + 1 if there is none
+function FunscriptView:upperBound(time) end
+
+--- Iterate over the actions in a time range
+-- @tparam number fromTime Time in seconds
+-- @tparam number toTime Time in seconds, inclusive
+-- @treturn function iterator
+-- @example
+--   local view = ofs.Script(ofs.ActiveIdx()).view
+--   for idx, at, pos in view:range(10.0, 20.0) do
+--     print(idx, at, pos)
+--   end
+function FunscriptView:range(fromTime, toTime) end
+
 
 --- Action creation
 -- @module action
@@ -356,6 +465,53 @@ pos = 0
 selected = false
 
 
+--- Job handle returned by `ofs.Job()`
+--
+-- Jobs of unloaded extensions get cancelled.
+-- @see jobs
+-- @display Job
+-- @class Job
+
+--- Gets if the callback was called
+-- @meta read-only
+-- @type bool
+done = false
+
+--- Progress reported by the job
+-- @meta read-only
+-- @type number
+progress = 0.0
+
+--- Cancel the job, the callback doesn't get called
+-- @treturn nil
+function Job:cancel() end
+
+--- Immutable copy of the actions of a script passed to or returned from a job
+-- @see jobs
+-- @display ScriptData
+-- @class ScriptData
+
+--- Number of actions, also available as `#data`
+-- @treturn number length
+function ScriptData:length() end
+
+--- Get an action
+-- @tparam number idx
+-- @treturn number at Time in seconds
+-- @treturn number pos
+function ScriptData:get(idx) end
+
+--- Index of the first action at or after a given time
+-- @tparam number time Time in seconds
+-- @treturn number index Length + 1 if there is none
+function ScriptData:lowerBound(time) end
+
+--- Index of the first action after a given time
+-- @tparam number time Time in seconds
+-- @treturn number index Length + 1 if there is none
+function ScriptData:upperBound(time) end
+
+
 --- Process creation
 -- @module process
 
@@ -396,3 +552,50 @@ function Process:detach() end
 --- Kill the process
 -- @treturn nil
 function Process:kill() end
+
+--- Start a process without blocking
+--
+-- The output is read line by line in the background.
+-- Lines are passed to the handlers or can be polled with `readLines()` if there is no handler.
+-- @display AsyncProcess.new
+-- @tparam string program
+-- @tparam string[]|nil args
+-- @tparam table|nil handlers Optional `stdout(line)`, `stderr(line)` and `exit(code)` functions
+-- @treturn AsyncProcess|nil Returns a process on success or nil
+-- @example
+--   AsyncProcess.new("ffmpeg", { "-i", "video.mp4", "out.wav" }, {
+--     stderr = function(line) print(line) end,
+--     exit = function(code) print("ffmpeg returned", code) end
+--   })
+function AsyncProcess.new(program, args, handlers) end
+
+--- Process handle returned by `AsyncProcess.new()`
+--
+-- Processes of unloaded extensions get killed.
+-- @see process
+-- @display AsyncProcess
+-- @class AsyncProcess
+
+--- Is the process alive
+-- @treturn bool isAlive
+function AsyncProcess:alive() end
+
+--- Get the exit code
+-- @treturn number|nil Nil while the process is running
+function AsyncProcess:exitCode() end
+
+--- Get the lines written to stdout since the last call
+--
+-- Empty if there is a stdout handler.
+-- @treturn string[] lines
+function AsyncProcess:readLines() end
+
+--- Get the lines written to stderr since the last call
+--
+-- Empty if there is a stderr handler.
+-- @treturn string[] lines
+function AsyncProcess:readErrorLines() end
+
+--- Kill the process
+-- @treturn nil
+function AsyncProcess:kill() end
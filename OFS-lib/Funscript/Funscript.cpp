@@ -26,6 +26,7 @@ std::array<const char*, 9> Funscript::AxisNames = {
 
 Funscript::Funscript() noexcept
 {
+    LineCache = std::make_unique<FunscriptLineCache>();
     notifyActionsChanged(false);
     undoSystem = std::make_unique<FunscriptUndoSystem>(this);
     editTime = std::chrono::system_clock::now();
@@ -107,8 +108,17 @@ void Funscript::saveMetadata(nlohmann::json& outMetadataObj, const Funscript::Me
 }
 
 void Funscript::notifyActionsChanged(bool isEdit) noexcept
+{
+    notifyActionsChanged(isEdit, std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max());
+}
+
+void Funscript::notifyActionsChanged(bool isEdit, float startTime, float endTime) noexcept
 {
     funscriptChanged = true;
+    dirtyStartTime = std::min(dirtyStartTime, startTime);
+    dirtyEndTime = std::max(dirtyEndTime, endTime);
+    LineCache->Invalidate(startTime, endTime);
+    actionsVersion += 1;
     if (isEdit && !unsavedEdits) {
         unsavedEdits = true;
         editTime = std::chrono::system_clock::now();
@@ -120,7 +130,9 @@ void Funscript::Update() noexcept
     OFS_PROFILE(__FUNCTION__);
     if (funscriptChanged) {
         funscriptChanged = false;
-        EV::Enqueue<FunscriptActionsChangedEvent>(this);
+        EV::Enqueue<FunscriptActionsChangedEvent>(this, dirtyStartTime, dirtyEndTime);
+        dirtyStartTime = std::numeric_limits<float>::max();
+        dirtyEndTime = std::numeric_limits<float>::lowest();
     }
     if (selectionChanged) {
         selectionChanged = false;
@@ -128,25 +140,25 @@ void Funscript::Update() noexcept
     }
 }
 
-float Funscript::GetPositionAtTime(float time) const noexcept
+float Funscript::GetPositionAtTime(const FunscriptArray& actions, float time) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
-    if (data.Actions.size() == 0) {
+    if (actions.size() == 0) {
         return 0;
     }
-    else if (data.Actions.size() == 1)
-        return data.Actions[0].pos;
+    else if (actions.size() == 1)
+        return actions[0].pos;
 
     int i = 0;
-    auto it = data.Actions.lower_bound(FunscriptAction(time, 0));
-    if (it != data.Actions.end()) {
-        i = std::distance(data.Actions.begin(), it);
+    auto it = actions.lower_bound(FunscriptAction(time, 0));
+    if (it != actions.end()) {
+        i = std::distance(actions.begin(), it);
         if (i > 0) --i;
     }
 
-    for (; i < data.Actions.size() - 1; i++) {
-        auto& action = data.Actions[i];
-        auto& next = data.Actions[i + 1];
+    for (; i < actions.size() - 1; i++) {
+        auto& action = actions[i];
+        auto& next = actions[i + 1];
 
         if (time > action.atS && time < next.atS) {
             // interpolate position
@@ -162,7 +174,7 @@ float Funscript::GetPositionAtTime(float time) const noexcept
         }
     }
 
-    return data.Actions.back().pos;
+    return actions.back().pos;
 }
 
 void Funscript::AddMultipleActions(const FunscriptArray& actions) noexcept
@@ -172,7 +184,9 @@ void Funscript::AddMultipleActions(const FunscriptArray& actions) noexcept
         data.Actions.emplace(action);
     }
     sortActions(data.Actions);
-    notifyActionsChanged(true);
+    if (!actions.empty()) {
+        notifyActionsChanged(true, actions.front().atS, actions.back().atS);
+    }
 }
 
 
@@ -185,7 +199,7 @@ bool Funscript::EditAction(FunscriptAction oldAction, FunscriptAction newAction)
         act->atS = newAction.atS;
         act->pos = newAction.pos;
         checkForInvalidatedActions();
-        notifyActionsChanged(true);
+        notifyActionsChanged(true, std::min(oldAction.atS, newAction.atS), std::max(oldAction.atS, newAction.atS));
         sortActions(data.Actions);
         return true;
     }
@@ -197,8 +211,9 @@ void Funscript::AddEditAction(FunscriptAction action, float frameTime) noexcept
     OFS_PROFILE(__FUNCTION__);
     auto close = getActionAtTime(data.Actions, action.atS, frameTime);
     if (close != nullptr) {
+        float oldTime = close->atS;
         *close = action;
-        notifyActionsChanged(true);
+        notifyActionsChanged(true, std::min(oldTime, action.atS), std::max(oldTime, action.atS));
         checkForInvalidatedActions();
     }
     else {
@@ -227,7 +242,7 @@ void Funscript::RemoveAction(FunscriptAction action, bool checkInvalidSelection)
     auto it = data.Actions.find(action);
     if (it != data.Actions.end()) {
         data.Actions.erase(it);
-        notifyActionsChanged(true);
+        notifyActionsChanged(true, action.atS, action.atS);
 
         if (checkInvalidSelection) {
             checkForInvalidatedActions();
@@ -247,7 +262,9 @@ void Funscript::RemoveActions(const FunscriptArray& removeActions) noexcept
         });
     data.Actions.erase(it, data.Actions.end());
 
-    notifyActionsChanged(true);
+    if (!removeActions.empty()) {
+        notifyActionsChanged(true, removeActions.front().atS, removeActions.back().atS);
+    }
     checkForInvalidatedActions();
 }
 
@@ -301,14 +318,114 @@ std::vector<FunscriptAction> Funscript::GetLastStroke(float time) noexcept
     return stroke;
 }
 
+// Finds the window between the common prefix and suffix of both arrays
+// and the time range it covers. Returns false if they're equal.
+static bool diffWindow(const FunscriptArray& actions, const FunscriptArray& other,
+    size_t& prefix, size_t& suffix, float& startTime, float& endTime) noexcept
+{
+    auto same = [](FunscriptAction a, FunscriptAction b) noexcept { return a == b && a.tag == b.tag; };
+    prefix = 0;
+    size_t maxCommon = std::min(actions.size(), other.size());
+    while (prefix < maxCommon && same(actions[prefix], other[prefix])) ++prefix;
+    suffix = 0;
+    while (suffix < maxCommon - prefix
+        && same(actions[actions.size() - suffix - 1], other[other.size() - suffix - 1])) ++suffix;
+
+    size_t oldEnd = actions.size() - suffix;
+    size_t newEnd = other.size() - suffix;
+    if (prefix == oldEnd && prefix == newEnd) return false;
+
+    startTime = std::numeric_limits<float>::max();
+    endTime = std::numeric_limits<float>::lowest();
+    if (prefix < oldEnd) {
+        startTime = actions[prefix].atS;
+        endTime = actions[oldEnd - 1].atS;
+    }
+    if (prefix < newEnd) {
+        startTime = std::min(startTime, other[prefix].atS);
+        endTime = std::max(endTime, other[newEnd - 1].atS);
+    }
+    return true;
+}
+
+// Copies the actions in [startTime, endTime].
+static void copyRange(const FunscriptArray& actions, float startTime, float endTime, FunscriptArray& out) noexcept
+{
+    auto first = actions.lower_bound(FunscriptAction(startTime, 0));
+    auto last = actions.upper_bound(FunscriptAction(endTime, 0));
+    out.assign(first, last);
+}
+
+// Replaces the actions in [startTime, endTime].
+static void replaceRange(FunscriptArray& actions, float startTime, float endTime, const FunscriptArray& with) noexcept
+{
+    auto first = actions.lower_bound(FunscriptAction(startTime, 0));
+    auto last = actions.upper_bound(FunscriptAction(endTime, 0));
+    auto insertAt = actions.erase(first, last);
+    actions.insert(insertAt, with.begin(), with.end());
+}
+
 void Funscript::SetActions(const FunscriptArray& override_with) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
-    // data.Actions.clear();
-    // data.Actions.assign(override_with.begin(), override_with.end());
-    // sortActions(data.Actions);
-    data.Actions = override_with;
-    notifyActionsChanged(true);
+    auto& actions = data.Actions;
+
+    // only the window between the common prefix and suffix gets replaced
+    size_t prefix, suffix;
+    float dirtyStart, dirtyEnd;
+    if (!diffWindow(actions, override_with, prefix, suffix, dirtyStart, dirtyEnd)) return;
+    size_t oldEnd = actions.size() - suffix;
+    size_t newEnd = override_with.size() - suffix;
+
+    size_t replaced = std::min(oldEnd, newEnd) - prefix;
+    std::copy_n(override_with.begin() + prefix, replaced, actions.begin() + prefix);
+    if (oldEnd > newEnd) {
+        actions.erase(actions.begin() + prefix + replaced, actions.begin() + oldEnd);
+    }
+    else {
+        actions.insert(actions.begin() + prefix + replaced, override_with.begin() + prefix + replaced, override_with.begin() + newEnd);
+    }
+    notifyActionsChanged(true, dirtyStart, dirtyEnd);
+}
+
+bool Funscript::DiffRange(const FunscriptArray& actions, const FunscriptArray& selection, float* outStart, float* outEnd) const noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    size_t prefix, suffix;
+    float actionsStart, actionsEnd;
+    float selectionStart, selectionEnd;
+    bool actionsDiffer = diffWindow(data.Actions, actions, prefix, suffix, actionsStart, actionsEnd);
+    bool selectionDiffers = diffWindow(data.Selection, selection, prefix, suffix, selectionStart, selectionEnd);
+    if (!actionsDiffer && !selectionDiffers) return false;
+
+    *outStart = std::numeric_limits<float>::max();
+    *outEnd = std::numeric_limits<float>::lowest();
+    if (actionsDiffer) {
+        *outStart = actionsStart;
+        *outEnd = actionsEnd;
+    }
+    if (selectionDiffers) {
+        *outStart = std::min(*outStart, selectionStart);
+        *outEnd = std::max(*outEnd, selectionEnd);
+    }
+    return true;
+}
+
+Funscript::FunscriptData Funscript::CopyRange(float startTime, float endTime) const noexcept
+{
+    FunscriptData range;
+    copyRange(data.Actions, startTime, endTime, range.Actions);
+    copyRange(data.Selection, startTime, endTime, range.Selection);
+    return range;
+}
+
+void Funscript::RollbackRange(float startTime, float endTime, const FunscriptData& range) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    replaceRange(data.Actions, startTime, endTime, range.Actions);
+    replaceRange(data.Selection, startTime, endTime, range.Selection);
+    notifyActionsChanged(true, startTime, endTime);
+    notifySelectionChanged();
 }
 
 void Funscript::RemoveActionsInInterval(float fromTime, float toTime) noexcept
@@ -321,7 +438,33 @@ void Funscript::RemoveActionsInInterval(float fromTime, float toTime) noexcept
             }),
         data.Actions.end());
     checkForInvalidatedActions();
-    notifyActionsChanged(true);
+    notifyActionsChanged(true, fromTime, toTime);
+}
+
+void Funscript::MergeActions(const FunscriptArray& actions) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    if (actions.empty()) return;
+
+    FunscriptArray merged;
+    merged.reserve(data.Actions.size() + actions.size());
+    auto existing = data.Actions.begin();
+    auto incoming = actions.begin();
+    while (existing != data.Actions.end() && incoming != actions.end()) {
+        if (existing->atS < incoming->atS) {
+            merged.emplace_back(*existing++);
+        }
+        else {
+            if (existing->atS == incoming->atS) ++existing;
+            merged.emplace_back(*incoming++);
+        }
+    }
+    merged.insert(merged.end(), existing, data.Actions.end());
+    merged.insert(merged.end(), incoming, actions.end());
+    data.Actions = std::move(merged);
+
+    checkForInvalidatedActions();
+    notifyActionsChanged(true, actions.front().atS, actions.back().atS);
 }
 
 void Funscript::RangeExtendSelection(int32_t rangeExtend) noexcept
@@ -412,6 +555,7 @@ void Funscript::RangeExtendSelection(int32_t rangeExtend) noexcept
     }
     ClearSelection();
     ExtendRange(rangeExtendSelection, rangeExtend);
+    notifyActionsChanged(true);
 }
 
 bool Funscript::ToggleSelection(FunscriptAction action) noexcept
@@ -9,9 +9,11 @@
 #include <string>
 #include <memory>
 #include <chrono>
+#include <limits>
 
 #include "OFS_Util.h"
 #include "FunscriptSpline.h"
+#include "FunscriptLineCache.h"
 
 #include "OFS_Profiling.h"
 
@@ -23,19 +25,34 @@ class Funscript;
 class FunscriptActionsChangedEvent : public OFS_Event<FunscriptActionsChangedEvent>
 {
 	public:
+	static constexpr OFS_EventCoalescing Coalescing = OFS_EventCoalescing::Merge;
 	// FIXME: get rid of this raw pointer
 	const Funscript* Script = nullptr;
-	FunscriptActionsChangedEvent(const Funscript* changedScript) noexcept
-		: Script(changedScript) {}
+	// time range which contains all changed actions
+	float DirtyStartTime;
+	float DirtyEndTime;
+	FunscriptActionsChangedEvent(const Funscript* changedScript, float dirtyStart, float dirtyEnd) noexcept
+		: Script(changedScript), DirtyStartTime(dirtyStart), DirtyEndTime(dirtyEnd) {}
+
+	uint64_t CoalesceKey() const noexcept override { return (uint64_t)(uintptr_t)Script; }
+	void Merge(const BaseEvent& older) noexcept override
+	{
+		auto& ev = static_cast<const FunscriptActionsChangedEvent&>(older);
+		DirtyStartTime = std::min(DirtyStartTime, ev.DirtyStartTime);
+		DirtyEndTime = std::max(DirtyEndTime, ev.DirtyEndTime);
+	}
 };
 
 class FunscriptSelectionChangedEvent : public OFS_Event<FunscriptSelectionChangedEvent>
 {
 	public:
+	static constexpr OFS_EventCoalescing Coalescing = OFS_EventCoalescing::LatestWins;
 	// FIXME: get rid of this raw pointer
 	const Funscript* Script = nullptr;
 	FunscriptSelectionChangedEvent(const Funscript* changedScript) noexcept
 		: Script(changedScript) {}
+
+	uint64_t CoalesceKey() const noexcept override { return (uint64_t)(uintptr_t)Script; }
 };
 
 class FunscriptNameChangedEvent : public OFS_Event<FunscriptNameChangedEvent>
@@ -105,6 +122,9 @@ private:
 	bool funscriptChanged = false; // used to fire only one event every frame a change occurs
 	bool unsavedEdits = false; // used to track if the script has unsaved changes
 	bool selectionChanged = false;
+	uint32_t actionsVersion = 0; // incremented on every change to the actions
+	float dirtyStartTime = std::numeric_limits<float>::max();
+	float dirtyEndTime = std::numeric_limits<float>::lowest();
 	FunscriptData data;
 
 	void checkForInvalidatedActions() noexcept;
@@ -187,13 +207,15 @@ private:
 	void moveActionsPosition(std::vector<FunscriptAction*> moving, int32_t posOffset);
 	inline void sortSelection() noexcept { sortActions(data.Selection); }
 	inline void sortActions(FunscriptArray& actions) noexcept { std::sort(actions.begin(), actions.end()); }
-	inline void addAction(FunscriptArray& actions, FunscriptAction newAction) noexcept { actions.emplace(newAction); notifyActionsChanged(true); }
+	inline void addAction(FunscriptArray& actions, FunscriptAction newAction) noexcept { actions.emplace(newAction); notifyActionsChanged(true, newAction.atS, newAction.atS); }
 	inline void notifySelectionChanged() noexcept { selectionChanged = true; }
 
 	static void loadMetadata(const nlohmann::json& metadataObj, Funscript::Metadata& outMetadata) noexcept;
 	static void saveMetadata(nlohmann::json& outMetadataObj, const Funscript::Metadata& inMetadata) noexcept;
 
+	// marks the whole script as changed
 	void notifyActionsChanged(bool isEdit) noexcept; 
+	void notifyActionsChanged(bool isEdit, float startTime, float endTime) noexcept;
 	std::string currentPathRelative;
 	std::string title;
 public:
@@ -204,6 +226,7 @@ public:
 
 	bool Enabled = true;
 	std::unique_ptr<FunscriptUndoSystem> undoSystem;
+	std::unique_ptr<FunscriptLineCache> LineCache;
 
 	std::string ConvertToCSV() noexcept;
         std::string RelativePathWithReplaceExt(std::string ext) const noexcept;
@@ -217,6 +240,12 @@ public:
 
 	inline void Rollback(FunscriptData&& data) noexcept { this->data = std::move(data); notifyActionsChanged(true); }
 	inline void Rollback(const FunscriptData& data) noexcept { this->data = data; notifyActionsChanged(true); }
+	// Time range outside of which the actions and selection match the given ones. False if nothing differs.
+	bool DiffRange(const FunscriptArray& actions, const FunscriptArray& selection, float* outStart, float* outEnd) const noexcept;
+	// The actions and selection between startTime and endTime.
+	FunscriptData CopyRange(float startTime, float endTime) const noexcept;
+	// Replaces the actions and selection between startTime and endTime with a CopyRange result.
+	void RollbackRange(float startTime, float endTime, const FunscriptData& range) noexcept;
 	void Update() noexcept;
 
 	bool Deserialize(const nlohmann::json& json, Funscript::Metadata* outMetadata, bool loadChapters) noexcept;
@@ -231,6 +260,7 @@ public:
 	inline const FunscriptData& Data() const noexcept { return data; }
 	inline const auto& Selection() const noexcept { return data.Selection; }
 	inline const auto& Actions() const noexcept { return data.Actions; }
+	inline uint32_t ActionsVersion() const noexcept { return actionsVersion; }
 
 	inline const FunscriptAction* GetAction(FunscriptAction action) noexcept { return getAction(action); }
 	inline const FunscriptAction* GetActionAtTime(float time, float errorTime) noexcept { return getActionAtTime(data.Actions, time, errorTime); }
@@ -238,7 +268,9 @@ public:
 	inline const FunscriptAction* GetPreviousActionBehind(float time) noexcept { return getPreviousActionBehind(time); }
 	inline const FunscriptAction* GetClosestAction(float time) noexcept { return getActionAtTime(data.Actions, time, std::numeric_limits<float>::max()); }
 
-	float GetPositionAtTime(float time) const noexcept;
+	inline float GetPositionAtTime(float time) const noexcept { return GetPositionAtTime(data.Actions, time); }
+	// Linear interpolation, usable on copies of the actions from other threads.
+	static float GetPositionAtTime(const FunscriptArray& actions, float time) noexcept;
 	
 	inline void AddAction(FunscriptAction newAction) noexcept { addAction(data.Actions, newAction); }
 	void AddMultipleActions(const FunscriptArray& actions) noexcept;
@@ -256,6 +288,8 @@ public:
 	inline const std::chrono::system_clock::time_point& EditTime() const { return editTime; }
 
 	void RemoveActionsInInterval(float fromTime, float toTime) noexcept;
+	// Merges sorted actions in a single pass. Existing actions with the same timestamp get replaced.
+	void MergeActions(const FunscriptArray& actions) noexcept;
 
 	// selection api
 	void RangeExtendSelection(int32_t rangeExtend) noexcept;
@@ -287,7 +321,8 @@ public:
 
 	FunscriptSpline ScriptSpline;
 	inline const float Spline(float time) noexcept {
-		return ScriptSpline.Sample(data.Actions, time);
+		ScriptSpline.Update(data.Actions, actionsVersion);
+		return ScriptSpline.Sample(time);
 	}
 
 	inline const float SplineClamped(float time) noexcept {
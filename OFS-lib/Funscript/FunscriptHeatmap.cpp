@@ -149,17 +149,23 @@ FunscriptHeatmap::FunscriptHeatmap() noexcept
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void FunscriptHeatmap::Update(float totalDuration, const FunscriptArray& actions) noexcept
+void FunscriptHeatmap::updateTexels(float totalDuration, const FunscriptArray& actions, uint32_t firstTexel, uint32_t lastTexel) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
+    if (firstTexel >= lastTexel) return;
+    const uint32_t texelCount = lastTexel - firstTexel;
     std::vector<float> speedBuffer; 
-    speedBuffer.resize(SpeedTextureResolution, 0.f);
+    speedBuffer.resize(texelCount, 0.f);
     std::vector<uint16_t> sampleCountBuffer;
-    sampleCountBuffer.resize(SpeedTextureResolution, 0);
+    sampleCountBuffer.resize(texelCount, 0);
 
     float timeStep = totalDuration / SpeedTextureResolution;
 
-    for(uint32_t i = 0, j = 1, size = actions.size(); j < size; i = j++)
+    // start a stroke early, the float to index conversion isn't exact
+    uint32_t first = actions.lower_bound(FunscriptAction(firstTexel * timeStep, 0)) - actions.begin();
+    first = first > 2 ? first - 2 : 0;
+
+    for(uint32_t i = first, j = first + 1, size = actions.size(); j < size; i = j++)
     {
         auto prev = actions[i];
         auto next = actions[j];
@@ -169,28 +175,31 @@ void FunscriptHeatmap::Update(float totalDuration, const FunscriptArray& actions
     
         uint32_t prevSampleIdx = prev.atS / timeStep;
         uint32_t nextSampleIdx = next.atS / timeStep;
+        if(prevSampleIdx >= lastTexel) break;
         if(prevSampleIdx == nextSampleIdx)
         {
-            if(prevSampleIdx < SpeedTextureResolution)
+            if(prevSampleIdx >= firstTexel)
             {
-                sampleCountBuffer[prevSampleIdx] += 1;
-                speedBuffer[prevSampleIdx] += speed;
+                sampleCountBuffer[prevSampleIdx - firstTexel] += 1;
+                speedBuffer[prevSampleIdx - firstTexel] += speed;
             }
         }
         else
         {
             if(prevSampleIdx < SpeedTextureResolution && nextSampleIdx < SpeedTextureResolution)
             {
-                for(int x = prevSampleIdx; x < nextSampleIdx; x += 1)
+                uint32_t from = std::max(prevSampleIdx, firstTexel);
+                uint32_t to = std::min(nextSampleIdx, lastTexel);
+                for(uint32_t x = from; x < to; x += 1)
                 {
-                    sampleCountBuffer[x] += 1;
-                    speedBuffer[x] += speed;
+                    sampleCountBuffer[x - firstTexel] += 1;
+                    speedBuffer[x - firstTexel] += speed;
                 }
             }
         }
     }
 
-    for(uint32_t i=0; i < SpeedTextureResolution; i += 1)
+    for(uint32_t i=0; i < texelCount; i += 1)
     {
         speedBuffer[i] /= sampleCountBuffer[i] > 0 ? (float)sampleCountBuffer[i] : 1.f;
         speedBuffer[i] /= MaxSpeedPerSecond;
@@ -198,10 +207,32 @@ void FunscriptHeatmap::Update(float totalDuration, const FunscriptArray& actions
     }
 
     glBindTexture(GL_TEXTURE_2D, speedTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, SpeedTextureResolution, 1, 0, GL_RED, GL_FLOAT, speedBuffer.data());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, firstTexel, 0, texelCount, 1, GL_RED, GL_FLOAT, speedBuffer.data());
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void FunscriptHeatmap::Update(float totalDuration, const FunscriptArray& actions) noexcept
+{
+    updateTexels(totalDuration, actions, 0, SpeedTextureResolution);
+}
+
+void FunscriptHeatmap::Update(float totalDuration, const FunscriptArray& actions, float dirtyStart, float dirtyEnd) noexcept
+{
+    if (totalDuration <= 0.f || dirtyStart > dirtyEnd) return;
+    // the strokes leading into and out of the changed range changed as well
+    float from = dirtyStart;
+    auto startIt = actions.lower_bound(FunscriptAction(dirtyStart, 0));
+    if (startIt != actions.begin()) from = (startIt - 1)->atS;
+    float to = dirtyEnd;
+    auto endIt = actions.upper_bound(FunscriptAction(dirtyEnd, 0));
+    if (endIt != actions.end()) to = endIt->atS;
+
+    float timeStep = totalDuration / SpeedTextureResolution;
+    uint32_t firstTexel = from > 0.f ? (uint32_t)std::min(from / timeStep, (float)SpeedTextureResolution) : 0;
+    uint32_t lastTexel = to > 0.f ? (uint32_t)std::min(to / timeStep + 1.f, (float)SpeedTextureResolution) : 0;
+    updateTexels(totalDuration, actions, firstTexel, lastTexel);
+}
+
 void FunscriptHeatmap::DrawHeatmap(ImDrawList* drawList, const ImVec2& min, const ImVec2& max) noexcept
 {
     drawList->AddCallback([](const ImDrawList* parentList, const ImDrawCmd* cmd) noexcept
@@ -4,6 +4,8 @@
 
 class FunscriptHeatmap
 {
+private:
+	void updateTexels(float totalDuration, const FunscriptArray& actions, uint32_t firstTexel, uint32_t lastTexel) noexcept;
 public:
 	static constexpr float MaxSpeedPerSecond = 400.f;
 	static constexpr int16_t MaxResolution = 4096;
@@ -19,6 +21,8 @@ public:
 
 	void DrawHeatmap(ImDrawList* drawList, const ImVec2& min, const ImVec2& max) noexcept;
 	void Update(float totalDuration , const FunscriptArray& actions) noexcept;
+	// only redoes the part of the texture affected by changes between dirtyStart and dirtyEnd
+	void Update(float totalDuration, const FunscriptArray& actions, float dirtyStart, float dirtyEnd) noexcept;
 
 	std::vector<uint8_t> RenderToBitmap(int16_t width, int16_t height) noexcept;
 };
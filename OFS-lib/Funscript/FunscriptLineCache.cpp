@@ -0,0 +1,255 @@
+#include "FunscriptLineCache.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+
+#include "SDL_thread.h"
+#include "SDL_atomic.h"
+#include "SDL_timer.h"
+
+#include <atomic>
+#include <cmath>
+
+struct FunscriptLineCache::State
+{
+	SDL_SpinLock lock = {0};
+
+	// written by the main thread, the current actions between pendingDirtyStart and pendingDirtyEnd
+	FunscriptArray pendingActions;
+	uint32_t pendingVersion = 0;
+	float pendingDirtyStart = std::numeric_limits<float>::max();
+	float pendingDirtyEnd = std::numeric_limits<float>::lowest();
+	bool hasPending = false;
+
+	// only touched by the worker, the knots are its copy of the actions
+	FunscriptSpline spline;
+
+	// the worker writes the buffer which is neither shown nor ready
+	Tessellation buffers[2];
+	int32_t readyIdx = -1;
+	int32_t frontIdx = -1;
+};
+
+struct LineCacheThread
+{
+	SDL_SpinLock lock = {0};
+	SDL_cond* WaitWork = nullptr;
+	std::vector<std::shared_ptr<FunscriptLineCache::State>> jobs;
+
+	std::atomic<bool> ShouldExit = false;
+	std::atomic<bool> Exited = false;
+	bool Running = false;
+};
+
+static LineCacheThread Thread;
+
+inline static void sampleSegment(std::vector<FunscriptLineCache::Point>& points, FunscriptSpline& spline, const FunscriptArray& actions, int32_t i) noexcept
+{
+	float samples[FunscriptLineCache::MaxSamplesPerSegment];
+	float startTime = actions[i].atS;
+	float duration = actions[i + 1].atS - startTime;
+	int32_t sampleCount = Util::Clamp<int32_t>(
+		(int32_t)std::ceil(duration / FunscriptLineCache::SampleInterval),
+		1, FunscriptLineCache::MaxSamplesPerSegment);
+	float timeStep = duration / sampleCount;
+
+	spline.SampleRange(startTime, timeStep, sampleCount, samples);
+	points.emplace_back(FunscriptLineCache::Point{ startTime, (float)actions[i].pos });
+	for (int32_t j = 1; j < sampleCount; j += 1) {
+		float time = startTime + (float)j * timeStep;
+		points.emplace_back(FunscriptLineCache::Point{ time, Util::Clamp(samples[j] * 100.f, 0.f, 100.f) });
+	}
+}
+
+void FunscriptLineCache::Tessellate(Tessellation& tess, FunscriptSpline& spline, uint32_t version,
+	float dirtyStart, float dirtyEnd) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	tess.version = version;
+	if (dirtyStart > dirtyEnd) return;
+
+	// everything outside of the dirty range is unchanged so it's at the same index in both
+	const auto& actions = spline.Knots();
+	const FunscriptAction startAction(dirtyStart, 0);
+	const FunscriptAction endAction(dirtyEnd, 0);
+	const int32_t first = tess.actions.lower_bound(startAction) - tess.actions.begin();
+	const int32_t oldEnd = tess.actions.upper_bound(endAction) - tess.actions.begin();
+	const int32_t newEnd = actions.upper_bound(endAction) - actions.begin();
+	const int32_t oldCount = tess.actions.size();
+	const int32_t newCount = actions.size();
+
+	// a catmull-rom segment depends on the two actions on either side.
+	// the final action counts as a segment of a single point.
+	const int32_t firstSegment = std::max(0, first - 2);
+	const int32_t oldSegmentEnd = std::max(firstSegment, std::min(oldCount, oldEnd + 1));
+	const int32_t newSegmentEnd = std::max(firstSegment, std::min(newCount, newEnd + 1));
+
+	auto pointIndex = [&tess](int32_t segment) noexcept {
+		return segment < (int32_t)tess.segmentOffsets.size() ? tess.segmentOffsets[segment] : (uint32_t)tess.points.size();
+	};
+	const uint32_t firstPoint = pointIndex(firstSegment);
+	const uint32_t oldPointEnd = pointIndex(oldSegmentEnd);
+
+	std::vector<Point> points;
+	std::vector<uint32_t> offsets;
+	offsets.reserve(newSegmentEnd - firstSegment);
+	for (int32_t i = firstSegment; i < newSegmentEnd; i += 1) {
+		offsets.emplace_back(firstPoint + points.size());
+		if (i + 1 < newCount) {
+			sampleSegment(points, spline, actions, i);
+		}
+		else {
+			points.emplace_back(Point{ actions.back().atS, (float)actions.back().pos });
+		}
+	}
+
+	// the untouched tail only needs its offsets shifted
+	const int64_t shift = (int64_t)points.size() - (int64_t)(oldPointEnd - firstPoint);
+	for (int32_t i = oldSegmentEnd; i < oldCount; i += 1) {
+		tess.segmentOffsets[i] = (uint32_t)(tess.segmentOffsets[i] + shift);
+	}
+	tess.points.erase(tess.points.begin() + firstPoint, tess.points.begin() + oldPointEnd);
+	tess.points.insert(tess.points.begin() + firstPoint, points.begin(), points.end());
+	tess.segmentOffsets.erase(tess.segmentOffsets.begin() + firstSegment, tess.segmentOffsets.begin() + oldSegmentEnd);
+	tess.segmentOffsets.insert(tess.segmentOffsets.begin() + firstSegment, offsets.begin(), offsets.end());
+
+	tess.actions.erase(tess.actions.begin() + first, tess.actions.begin() + oldEnd);
+	tess.actions.insert(tess.actions.begin() + first, actions.begin() + first, actions.begin() + newEnd);
+}
+
+static int LineCacheThreadFunction(void* threadData) noexcept
+{
+	auto& thread = *(LineCacheThread*)threadData;
+	auto waitMut = SDL_CreateMutex();
+	SDL_LockMutex(waitMut);
+
+	std::vector<std::shared_ptr<FunscriptLineCache::State>> jobs;
+	FunscriptArray slice;
+	while (!thread.ShouldExit) {
+		SDL_AtomicLock(&thread.lock);
+		bool noWork = thread.jobs.empty();
+		SDL_AtomicUnlock(&thread.lock);
+
+		// the timeout guards against a signal sent before we started waiting
+		if (noWork) SDL_CondWaitTimeout(thread.WaitWork, waitMut, 100);
+
+		SDL_AtomicLock(&thread.lock);
+		jobs.swap(thread.jobs);
+		SDL_AtomicUnlock(&thread.lock);
+
+		for (auto& state : jobs) {
+			uint32_t version;
+			SDL_AtomicLock(&state->lock);
+			slice.swap(state->pendingActions);
+			version = state->pendingVersion;
+			float dirtyStart = state->pendingDirtyStart;
+			float dirtyEnd = state->pendingDirtyEnd;
+			state->pendingDirtyStart = std::numeric_limits<float>::max();
+			state->pendingDirtyEnd = std::numeric_limits<float>::lowest();
+			state->hasPending = false;
+			// a result the main thread didn't pick up yet gets updated again
+			int32_t backIdx = state->readyIdx >= 0 ? state->readyIdx : (state->frontIdx == 0 ? 1 : 0);
+			state->readyIdx = -1;
+			SDL_AtomicUnlock(&state->lock);
+
+			state->spline.Replace(dirtyStart, dirtyEnd, slice, version);
+			for (auto& buffer : state->buffers) {
+				buffer.lagStart = std::min(buffer.lagStart, dirtyStart);
+				buffer.lagEnd = std::max(buffer.lagEnd, dirtyEnd);
+			}
+
+			// the other buffer catches up with this change once it gets written again
+			auto& back = state->buffers[backIdx];
+			FunscriptLineCache::Tessellate(back, state->spline, version, back.lagStart, back.lagEnd);
+			back.lagStart = std::numeric_limits<float>::max();
+			back.lagEnd = std::numeric_limits<float>::lowest();
+
+			SDL_AtomicLock(&state->lock);
+			state->readyIdx = backIdx;
+			SDL_AtomicUnlock(&state->lock);
+		}
+		jobs.clear();
+	}
+
+	SDL_DestroyMutex(waitMut);
+	thread.Exited = true;
+	return 0;
+}
+
+bool FunscriptLineCache::Init() noexcept
+{
+	if (Thread.Running) return true;
+	Thread.WaitWork = SDL_CreateCond();
+	auto t = SDL_CreateThread(LineCacheThreadFunction, "FunscriptLineCache", &Thread);
+	SDL_DetachThread(t);
+	Thread.Running = t != nullptr;
+	return Thread.Running;
+}
+
+void FunscriptLineCache::Shutdown() noexcept
+{
+	if (!Thread.Running) return;
+	Thread.ShouldExit = true;
+	SDL_CondSignal(Thread.WaitWork);
+	while (!Thread.Exited) {
+		SDL_Delay(1);
+	}
+	SDL_DestroyCond(Thread.WaitWork);
+	Thread.jobs.clear();
+	Thread.Running = false;
+}
+
+FunscriptLineCache::FunscriptLineCache() noexcept
+{
+	state = std::make_shared<State>();
+}
+
+void FunscriptLineCache::Request(const FunscriptArray& actions, uint32_t version) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	if (!Thread.Running || requestedVersion == version) return;
+	requestedVersion = version;
+
+	bool queueJob;
+	SDL_AtomicLock(&state->lock);
+	state->pendingVersion = version;
+	// ranges of requests the worker didn't get to yet add up
+	state->pendingDirtyStart = std::min(state->pendingDirtyStart, dirtyStart);
+	state->pendingDirtyEnd = std::max(state->pendingDirtyEnd, dirtyEnd);
+	// the worker only needs the actions in that range, it has a copy of the rest
+	if (state->pendingDirtyStart <= state->pendingDirtyEnd) {
+		state->pendingActions.assign(actions.lower_bound(FunscriptAction(state->pendingDirtyStart, 0)),
+			actions.upper_bound(FunscriptAction(state->pendingDirtyEnd, 0)));
+	}
+	else {
+		state->pendingActions.clear();
+	}
+	queueJob = !state->hasPending;
+	state->hasPending = true;
+	SDL_AtomicUnlock(&state->lock);
+	dirtyStart = std::numeric_limits<float>::max();
+	dirtyEnd = std::numeric_limits<float>::lowest();
+
+	if (queueJob) {
+		SDL_AtomicLock(&Thread.lock);
+		Thread.jobs.emplace_back(state);
+		SDL_AtomicUnlock(&Thread.lock);
+		SDL_CondSignal(Thread.WaitWork);
+	}
+}
+
+const FunscriptLineCache::Tessellation* FunscriptLineCache::Get(uint32_t version) noexcept
+{
+	SDL_AtomicLock(&state->lock);
+	if (state->readyIdx >= 0) {
+		// the old front can be written by the worker from now on
+		state->frontIdx = state->readyIdx;
+		state->readyIdx = -1;
+	}
+	int32_t frontIdx = state->frontIdx;
+	SDL_AtomicUnlock(&state->lock);
+
+	if (frontIdx >= 0 && state->buffers[frontIdx].version == version) {
+		return &state->buffers[frontIdx];
+	}
+	return nullptr;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "FunscriptAction.h"
+#include "FunscriptSpline.h"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <limits>
+
+// Caches the tessellated spline of a script so the timeline doesn't have to sample it every frame.
+// Rebuilds happen on a worker thread which only gets the actions touched by an edit
+// and only re-samples the segments around them. The result is double buffered.
+class FunscriptLineCache
+{
+public:
+	static constexpr float SampleInterval = 1.f / 120.f;
+	static constexpr uint32_t MaxSamplesPerSegment = 256;
+
+	struct Point
+	{
+		float atS;
+		float pos;
+	};
+
+	struct Tessellation
+	{
+		uint32_t version = 0;
+		FunscriptArray actions;
+		std::vector<Point> points;
+		// segment i starts at points[segmentOffsets[i]] and ends at points[segmentOffsets[i+1]]
+		// the last offset points at the final action
+		std::vector<uint32_t> segmentOffsets;
+		// changes since this buffer was last tessellated, see State
+		float lagStart = std::numeric_limits<float>::lowest();
+		float lagEnd = std::numeric_limits<float>::max();
+
+		inline uint32_t SegmentCount() const noexcept { return actions.size() > 1 ? actions.size() - 1 : 0; }
+	};
+
+	struct State;
+
+private:
+	std::shared_ptr<State> state;
+	uint32_t requestedVersion = 0xFFFF'FFFF;
+	// time range of all changes since the last request
+	float dirtyStart = std::numeric_limits<float>::lowest();
+	float dirtyEnd = std::numeric_limits<float>::max();
+
+public:
+	static bool Init() noexcept;
+	static void Shutdown() noexcept;
+
+	FunscriptLineCache() noexcept;
+
+	// Main thread only. Marks the actions between startTime and endTime as changed.
+	inline void Invalidate(float startTime, float endTime) noexcept
+	{
+		dirtyStart = std::min(dirtyStart, startTime);
+		dirtyEnd = std::max(dirtyEnd, endTime);
+	}
+
+	// Main thread only. Queues a rebuild unless one was already requested for this version.
+	void Request(const FunscriptArray& actions, uint32_t version) noexcept;
+	// Main thread only. Returns nullptr while no tessellation for this version is available.
+	const Tessellation* Get(uint32_t version) noexcept;
+
+	// Brings tess up to date with the knots of the spline.
+	// Only the actions between dirtyStart and dirtyEnd may differ from the last tessellated ones.
+	static void Tessellate(Tessellation& tess, FunscriptSpline& spline, uint32_t version,
+		float dirtyStart = std::numeric_limits<float>::lowest(), float dirtyEnd = std::numeric_limits<float>::max()) noexcept;
+};
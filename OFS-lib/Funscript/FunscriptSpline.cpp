@@ -0,0 +1,185 @@
+#include "FunscriptSpline.h"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define OFS_SPLINE_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OFS_SPLINE_SSE 1
+#endif
+
+int32_t FunscriptSpline::findSegment(float time) noexcept
+{
+	// returns -1 before the first action and segments.size() after the last one
+	if (cacheIdx + 1 >= knots.size()) { cacheIdx = 0; }
+
+	if (knots[cacheIdx].atS <= time && knots[cacheIdx + 1].atS > time) {
+		// cache hit!
+		return cacheIdx;
+	}
+	else if (cacheIdx + 2 < knots.size() && knots[cacheIdx + 1].atS <= time && knots[cacheIdx + 2].atS > time) {
+		// sort of a cache hit
+		cacheIdx += 1;
+		return cacheIdx;
+	}
+
+	// cache miss
+	auto it = knots.upper_bound(FunscriptAction(time, 0));
+	if (it == knots.begin()) return -1;
+	else if (it == knots.end()) return segments.size();
+
+	cacheIdx = std::distance(knots.begin(), it) - 1;
+	return cacheIdx;
+}
+
+void FunscriptSpline::Update(const FunscriptArray& actions, uint32_t actionsVersion) noexcept
+{
+	if (version == actionsVersion) return;
+	OFS_PROFILE(__FUNCTION__);
+	version = actionsVersion;
+
+	const int32_t oldCount = knots.size();
+	const int32_t newCount = actions.size();
+
+	// find the range of actions which changed
+	int32_t prefix = 0;
+	const int32_t maxCommon = std::min(oldCount, newCount);
+	while (prefix < maxCommon && knots[prefix] == actions[prefix]) prefix += 1;
+	int32_t suffix = 0;
+	while (suffix < maxCommon - prefix && knots[oldCount - 1 - suffix] == actions[newCount - 1 - suffix]) suffix += 1;
+
+	if (prefix == oldCount && prefix == newCount) return;
+
+	replaceKnots(prefix, oldCount - suffix, actions.begin() + prefix, actions.end() - suffix);
+}
+
+void FunscriptSpline::replaceKnots(int32_t first, int32_t oldEnd, FunscriptArray::const_iterator from, FunscriptArray::const_iterator to) noexcept
+{
+	const int32_t oldCount = knots.size();
+	knots.erase(knots.begin() + first, knots.begin() + oldEnd);
+	knots.insert(knots.begin() + first, from, to);
+	const int32_t newCount = knots.size();
+	const int32_t suffix = oldCount - oldEnd;
+
+	// a segment depends on the two actions on either side
+	const int32_t segmentStart = std::max(0, first - 2);
+	const int32_t oldSegmentEnd = std::max(segmentStart, std::min(oldCount - 1, oldCount - suffix + 1));
+	const int32_t newSegmentEnd = std::max(segmentStart, std::min(newCount - 1, newCount - suffix + 1));
+
+	std::vector<Segment> changed;
+	changed.reserve(newSegmentEnd - segmentStart);
+	for (int32_t i = segmentStart; i < newSegmentEnd; i += 1) {
+		changed.emplace_back(MakeSegment(knots, i));
+	}
+
+	segments.erase(segments.begin() + segmentStart, segments.begin() + oldSegmentEnd);
+	segments.insert(segments.begin() + segmentStart, changed.begin(), changed.end());
+	cacheIdx = 0;
+}
+
+FunscriptSpline::Splice FunscriptSpline::Replace(float startTime, float endTime, const FunscriptArray& actions, uint32_t actionsVersion) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	version = actionsVersion;
+	Splice splice;
+	if (startTime > endTime) {
+		// nothing changed
+		splice.first = splice.oldEnd = splice.newEnd = knots.size();
+		return splice;
+	}
+	splice.first = knots.lower_bound(FunscriptAction(startTime, 0)) - knots.begin();
+	splice.oldEnd = knots.upper_bound(FunscriptAction(endTime, 0)) - knots.begin();
+	splice.newEnd = splice.first + (int32_t)actions.size();
+	replaceKnots(splice.first, splice.oldEnd, actions.begin(), actions.end());
+	return splice;
+}
+
+void FunscriptSpline::SampleRange(float t0, float dt, int32_t count, float* out) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	if (knots.size() < 2) {
+		float value = knots.empty() ? 0.f : knots.front().pos / 100.f;
+		std::fill(out, out + count, value);
+		return;
+	}
+
+	const float frontValue = knots.front().pos / 100.f;
+	const float backValue = knots.back().pos / 100.f;
+	const int32_t segmentCount = segments.size();
+
+	// the time of sample k is always t0 + k * dt so every path produces the same values
+	auto timeAt = [t0, dt](int32_t k) noexcept {
+		float time = (float)k * dt;
+		time = t0 + time;
+		return time;
+	};
+	auto sampleScalar = [&](int32_t k) noexcept {
+		float time = timeAt(k);
+		int32_t idx = findSegment(time);
+		if (idx < 0) out[k] = frontValue;
+		else if (idx >= segmentCount) out[k] = backValue;
+		else out[k] = Evaluate(segments[idx], time);
+	};
+
+	int32_t k = 0;
+#if defined(OFS_SPLINE_AVX) || defined(OFS_SPLINE_SSE)
+#if defined(OFS_SPLINE_AVX)
+	constexpr int32_t Width = 8;
+	using Vec = __m256;
+	auto set1 = [](float v) noexcept { return _mm256_set1_ps(v); };
+	auto mul = [](Vec a, Vec b) noexcept { return _mm256_mul_ps(a, b); };
+	auto add = [](Vec a, Vec b) noexcept { return _mm256_add_ps(a, b); };
+	auto sub = [](Vec a, Vec b) noexcept { return _mm256_sub_ps(a, b); };
+	auto store = [](float* dst, Vec v) noexcept { _mm256_storeu_ps(dst, v); };
+	auto lanes = [](int32_t k) noexcept {
+		return _mm256_cvtepi32_ps(_mm256_setr_epi32(k, k + 1, k + 2, k + 3, k + 4, k + 5, k + 6, k + 7));
+	};
+#else
+	constexpr int32_t Width = 4;
+	using Vec = __m128;
+	auto set1 = [](float v) noexcept { return _mm_set1_ps(v); };
+	auto mul = [](Vec a, Vec b) noexcept { return _mm_mul_ps(a, b); };
+	auto add = [](Vec a, Vec b) noexcept { return _mm_add_ps(a, b); };
+	auto sub = [](Vec a, Vec b) noexcept { return _mm_sub_ps(a, b); };
+	auto store = [](float* dst, Vec v) noexcept { _mm_storeu_ps(dst, v); };
+	auto lanes = [](int32_t k) noexcept {
+		return _mm_cvtepi32_ps(_mm_setr_epi32(k, k + 1, k + 2, k + 3));
+	};
+#endif
+	if (dt > 0.f) {
+		const Vec t0v = set1(t0);
+		const Vec dtv = set1(dt);
+		while (k + Width <= count) {
+			float firstTime = timeAt(k);
+			float lastTime = timeAt(k + Width - 1);
+			int32_t idx = findSegment(firstTime);
+
+			bool sameSegment = idx >= 0 && idx < segmentCount
+				&& lastTime < knots[idx + 1].atS;
+			if (!sameSegment) {
+				// the batch crosses an action or lies outside the script
+				sampleScalar(k);
+				k += 1;
+				continue;
+			}
+
+			auto& seg = segments[idx];
+			Vec time = add(t0v, mul(lanes(k), dtv));
+			Vec s = mul(sub(time, set1(seg.atS)), set1(seg.invDuration));
+			Vec v = mul(s, set1(seg.c3));
+			v = add(set1(seg.c2), v);
+			v = mul(s, v);
+			v = add(set1(seg.c1), v);
+			v = mul(s, v);
+			v = add(set1(seg.c0), v);
+			store(out + k, v);
+			k += Width;
+		}
+	}
+#endif
+	for (; k < count; k += 1) {
+		sampleScalar(k);
+	}
+}
@@ -2,99 +2,118 @@
 #include "OFS_Profiling.h"
 #include "FunscriptAction.h"
 #include <vector>
-#include "glm/gtx/spline.hpp"
+#include <cstdint>
 
 
 class FunscriptSpline
 {
+public:
+	// catmull-rom segment between two actions as a cubic in s = (time - atS) * invDuration
+	struct Segment
+	{
+		float atS;
+		float invDuration;
+		float c0, c1, c2, c3;
+	};
+
+private:
+	FunscriptArray knots;
+	std::vector<Segment> segments;
+	uint32_t version = 0xFFFF'FFFF;
 	int32_t cacheIdx = 0;
+
+	int32_t findSegment(float time) noexcept;
+	// replaces the knots [first, oldEnd) with [from, to) and recomputes the segments around them
+	void replaceKnots(int32_t first, int32_t oldEnd, FunscriptArray::const_iterator from, FunscriptArray::const_iterator to) noexcept;
+
 public:
-	static inline float catmull_rom_spline(const FunscriptArray& actions, int32_t i, float time) noexcept
+	// flatten keeps segments between two equal positions from overshooting
+	static inline Segment MakeSegment(const FunscriptArray& actions, int32_t i, bool flatten = true) noexcept
 	{
-		OFS_PROFILE(__FUNCTION__);
-		int i0 = glm::clamp<int>(i - 1, 0, actions.size() - 1);
-		int i1 = glm::clamp<int>(i, 0, actions.size() - 1);
-		int i2 = glm::clamp<int>(i + 1, 0, actions.size() - 1);
-		int i3 = glm::clamp<int>(i + 2, 0, actions.size() - 1);
-
-		glm::vec1 v0(actions[i0].pos / 100.f);
-		glm::vec1 v1(actions[i1].pos / 100.f);
-		glm::vec1 v2(actions[i2].pos / 100.f);
-		glm::vec1 v3(actions[i3].pos / 100.f);
-		
-		time -= actions[i1].atS;
-		time /= actions[i2].atS - actions[i1].atS;
-
-		return glm::catmullRom(v0, v1, v2, v3, time).x;
+		int32_t last = (int32_t)actions.size() - 1;
+		int32_t i0 = i - 1 < 0 ? 0 : i - 1;
+		int32_t i2 = i + 1 > last ? last : i + 1;
+		int32_t i3 = i + 2 > last ? last : i + 2;
+
+		float v0 = actions[i0].pos / 100.f;
+		float v1 = actions[i].pos / 100.f;
+		float v2 = actions[i2].pos / 100.f;
+		float v3 = actions[i3].pos / 100.f;
+
+		Segment seg;
+		seg.atS = actions[i].atS;
+		seg.invDuration = 1.f / (actions[i2].atS - actions[i].atS);
+		seg.c0 = v1;
+		if (flatten && actions[i].pos == actions[i2].pos) {
+			// flat segments don't overshoot
+			seg.c1 = seg.c2 = seg.c3 = 0.f;
+		}
+		else {
+			seg.c1 = 0.5f * (v2 - v0);
+			seg.c2 = 0.5f * ((2.f * v0) - (5.f * v1) + (4.f * v2) - v3);
+			seg.c3 = 0.5f * ((3.f * v1) - v0 - (3.f * v2) + v3);
+		}
+		return seg;
 	}
 
-	static inline float catmul_rom_spline_alt(const FunscriptArray& actions, int32_t i, float time) noexcept
+	static inline float Evaluate(const Segment& seg, float time) noexcept
 	{
-		OFS_PROFILE(__FUNCTION__);
-		int i0 = glm::clamp<int>(i - 1, 0, actions.size() - 1);
-		int i1 = glm::clamp<int>(i, 0, actions.size() - 1);
-		int i2 = glm::clamp<int>(i + 1, 0, actions.size() - 1);
-		int i3 = glm::clamp<int>(i + 2, 0, actions.size() - 1);
-
-		if(actions[i1].pos == actions[i2].pos) return actions[i1].pos / 100.f;
-
-		glm::vec1 v0(actions[i0].pos / 100.f);
-		glm::vec1 v1(actions[i1].pos / 100.f);
-		glm::vec1 v2(actions[i2].pos / 100.f);
-		glm::vec1 v3(actions[i3].pos / 100.f);
-		
-		time -= actions[i1].atS;
-		time /= actions[i2].atS - actions[i1].atS;
-
-		return glm::catmullRom(v0, v1, v2, v3, time).x;
+		// SampleRange relies on this to match the vectorized path bit for bit,
+		// which is why the build disables floating point contraction into fma (-ffp-contract=off)
+		float s = time - seg.atS;
+		s = s * seg.invDuration;
+		float v = s * seg.c3;
+		v = seg.c2 + v;
+		v = s * v;
+		v = seg.c1 + v;
+		v = s * v;
+		v = seg.c0 + v;
+		return v;
 	}
 
-	inline float Sample(const FunscriptArray& actions, float time) noexcept 
+	// Updates the segment coefficients touched since the last update.
+	void Update(const FunscriptArray& actions, uint32_t actionsVersion) noexcept;
+
+	// Knots [first, oldEnd) were replaced by [first, newEnd).
+	struct Splice
 	{
-		OFS_PROFILE(__FUNCTION__);
-		if (actions.size() == 0) { return 0.f; }
-		else if (actions.size() == 1) { return actions.front().pos / 100.f; }
-		else if (cacheIdx + 1 >= actions.size()) { cacheIdx = 0; }
+		int32_t first = 0;
+		int32_t oldEnd = 0;
+		int32_t newEnd = 0;
+	};
 
-		if (actions[cacheIdx].atS <= time && actions[cacheIdx + 1].atS >= time) {
-			// cache hit!
-			return catmul_rom_spline_alt(actions, cacheIdx, time);
-		}
-		else if (cacheIdx + 2 < actions.size() && actions[cacheIdx+1].atS <= time && actions[cacheIdx+2].atS >= time) {
-			// sort of a cache hit
-			cacheIdx += 1;
-			return catmul_rom_spline_alt(actions, cacheIdx, time);
-		}
-		else {
-			// cache miss
-			// lookup index
-			auto it = actions.upper_bound(FunscriptAction(time, 0));
-			if (it == actions.end()) { 
-				return actions.back().pos / 100.f; 
-			}
-			else if (it == actions.begin())			{
-				return actions.front().pos / 100.f;
-			}
+	// Replaces the knots between startTime and endTime with the given actions, which all have to be in that range.
+	// Cheaper than Update if the caller knows what changed, the knots outside of the range are kept as they are.
+	Splice Replace(float startTime, float endTime, const FunscriptArray& actions, uint32_t actionsVersion) noexcept;
+	inline const FunscriptArray& Knots() const noexcept { return knots; }
 
-			it--;
-			// cache index
-			cacheIdx = std::distance(actions.begin(), it);
-			return catmul_rom_spline_alt(actions, cacheIdx, time);
-		}
+	inline float Sample(float time) noexcept
+	{
+		OFS_PROFILE(__FUNCTION__);
+		if (knots.empty()) { return 0.f; }
+		else if (knots.size() == 1) { return knots.front().pos / 100.f; }
 
-		return 0.f;
+		int32_t idx = findSegment(time);
+		if (idx < 0) return knots.front().pos / 100.f;
+		else if (idx >= (int32_t)segments.size()) return knots.back().pos / 100.f;
+		return Evaluate(segments[idx], time);
 	}
 
+	// Samples count values at t0, t0 + dt, t0 + 2*dt, ...
+	// Uses AVX/SSE when available, the result is identical to calling Sample for each time.
+	void SampleRange(float t0, float dt, int32_t count, float* out) noexcept;
+
 	inline static float SampleAtIndex(const FunscriptArray& actions, int32_t index, float time) noexcept
 	{
 		OFS_PROFILE(__FUNCTION__);
 		if (actions.empty()) { return 0.f; }
 		if (index + 1 < actions.size())	{
 			if (actions[index].atS <= time && actions[index + 1].atS >= time) {
-				return catmull_rom_spline(actions, index, time);
+				// the plain catmull-rom curve, unlike Sample this was never flattened
+				return Evaluate(MakeSegment(actions, index, false), time);
 			}
 		}
 
 		return actions.back().pos / 100.f;
 	}
-};
\ No newline at end of file
+};
@@ -20,12 +20,31 @@ void FunscriptUndoSystem::Snapshot(int32_t type, bool clearRedo) noexcept
 		ClearRedo();
 }
 
+void FunscriptUndoSystem::SnapshotRange(int32_t type, float startTime, float endTime) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	UndoStack.emplace_back(type, script->CopyRange(startTime, endTime), startTime, endTime);
+	ClearRedo();
+}
+
+void FunscriptUndoSystem::rollback(ScriptState& state, std::vector<ScriptState>& opposite) noexcept
+{
+	// the opposite entry covers the same range
+	opposite.emplace_back(state.type, script->CopyRange(state.startTime, state.endTime), state.startTime, state.endTime);
+	script->RollbackRange(state.startTime, state.endTime, state.Data());
+}
+
 bool FunscriptUndoSystem::Undo() noexcept
 {
 	if (UndoStack.empty()) return false;
 	OFS_PROFILE(__FUNCTION__);
-	SnapshotRedo(UndoStack.back().type); // copy data to redo
-	script->Rollback(std::move(UndoStack.back().Data())); // move data
+	if (UndoStack.back().partial) {
+		rollback(UndoStack.back(), RedoStack);
+	}
+	else {
+		SnapshotRedo(UndoStack.back().type); // copy data to redo
+		script->Rollback(std::move(UndoStack.back().Data())); // move data
+	}
 	UndoStack.pop_back(); // pop of the stack
 	return true;
 }
@@ -34,8 +53,13 @@ bool FunscriptUndoSystem::Redo() noexcept
 {
 	if (RedoStack.empty()) return false;
 	OFS_PROFILE(__FUNCTION__);
-	Snapshot(RedoStack.back().type, false); // copy data to undo
-	script->Rollback(std::move(RedoStack.back().Data())); // move data
+	if (RedoStack.back().partial) {
+		rollback(RedoStack.back(), UndoStack);
+	}
+	else {
+		Snapshot(RedoStack.back().type, false); // copy data to undo
+		script->Rollback(std::move(RedoStack.back().Data())); // move data
+	}
 	RedoStack.pop_back(); // pop of the stack
 	return true;
 }
\ No newline at end of file
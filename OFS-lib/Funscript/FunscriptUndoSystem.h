@@ -9,12 +9,18 @@ private:
 public:
 	inline Funscript::FunscriptData& Data() { return data; }
 	int32_t type;
+	// only the actions and selection between startTime and endTime are stored
+	bool partial = false;
+	float startTime = 0.f;
+	float endTime = 0.f;
 	const char* Description() const noexcept;
 
 	ScriptState() noexcept 
 		: type(-1) {}
 	ScriptState(int32_t type, const Funscript::FunscriptData& data) noexcept
 		: type(type), data(data) {}
+	ScriptState(int32_t type, Funscript::FunscriptData&& range, float startTime, float endTime) noexcept
+		: type(type), data(std::move(range)), partial(true), startTime(startTime), endTime(endTime) {}
 };
 
 class FunscriptUndoSystem
@@ -23,11 +29,14 @@ class FunscriptUndoSystem
 
 	Funscript* script = nullptr;
 	void SnapshotRedo(int32_t type) noexcept;
+	void rollback(ScriptState& state, std::vector<ScriptState>& opposite) noexcept;
 	
 	std::vector<ScriptState> UndoStack;
 	std::vector<ScriptState> RedoStack;
 
 	void Snapshot(int32_t type, bool clearRedo = true) noexcept;
+	// only keeps the part of the script between startTime and endTime
+	void SnapshotRange(int32_t type, float startTime, float endTime) noexcept;
 	bool Undo() noexcept;
 	bool Redo() noexcept;
 	void ClearRedo() noexcept;
@@ -7,14 +7,18 @@
 
 std::array<int64_t, SDL_CONTROLLER_BUTTON_MAX> ButtonsHeldDown = { -1 };
 std::array<ControllerInput, 4> ControllerInput::Controllers;
+ControllerSampler ControllerInput::Sampler;
 int32_t ControllerInput::activeControllers = 0;
 
 void ControllerInput::OpenController(int device) noexcept
 {
+    // the sampler thread reads the controllers while holding the lock
+    SDL_LockJoysticks();
     gamepad = SDL_GameControllerOpen(device);
     SDL_Joystick* j = SDL_GameControllerGetJoystick(gamepad);
     instance_id = SDL_JoystickInstanceID(j);
     isConnected = true;
+    SDL_UnlockJoysticks();
     LOGF_INFO("Controller \"%s\" connected!", SDL_GameControllerName(gamepad));
     if (SDL_JoystickIsHaptic(j)) {
         haptic = SDL_HapticOpenFromJoystick(j);
@@ -37,13 +41,15 @@ void ControllerInput::OpenController(int device) noexcept
 void ControllerInput::CloseController() noexcept
 {
     if (isConnected) {
-        isConnected = false;
         if (haptic) {
             SDL_HapticClose(haptic);
             haptic = nullptr;
         }
+        SDL_LockJoysticks();
+        isConnected = false;
         SDL_GameControllerClose(gamepad);
         gamepad = nullptr;
+        SDL_UnlockJoysticks();
     }
 }
 
@@ -123,6 +129,7 @@ void ControllerInput::UpdateControllers() noexcept
 
 void ControllerInput::Shutdown() noexcept
 {
+    Sampler.Stop();
     for (auto& controller : Controllers) {
         controller.CloseController();
     }
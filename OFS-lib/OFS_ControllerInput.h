@@ -1,5 +1,6 @@
 #pragma once
 #include "OFS_Event.h"
+#include "OFS_ControllerSampler.h"
 
 #include "SDL_gamecontroller.h"
 #include "SDL_haptic.h"
@@ -25,6 +26,7 @@ private:
 
 public:
     static std::array<ControllerInput, 4> Controllers;
+    static ControllerSampler Sampler;
 
     void Init() noexcept;
     void Update() noexcept;
@@ -33,6 +35,8 @@ public:
     static void UpdateControllers() noexcept;
 
     inline const char* GetName() const noexcept { return SDL_GameControllerName(gamepad); }
+    // only valid while the joysticks are locked, see SDL_LockJoysticks
+    inline SDL_GameController* Gamepad() const noexcept { return gamepad; }
     inline bool Connected() const noexcept { return isConnected; }
     static inline bool AnythingConnected() noexcept { return activeControllers > 0; }
 };
\ No newline at end of file
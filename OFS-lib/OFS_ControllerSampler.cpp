@@ -0,0 +1,155 @@
+#include "OFS_ControllerSampler.h"
+#include "OFS_ControllerInput.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+
+#include "SDL_joystick.h"
+#include "SDL_thread.h"
+#include "SDL_timer.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+// differences between the player and the extrapolated time below this get smoothed out
+static constexpr float ResyncThreshold = 0.05f;
+// sleeping can overshoot, the rest is spent yielding
+static constexpr uint64_t SpinUs = 200;
+
+ControllerSampler::~ControllerSampler() noexcept
+{
+    Stop();
+}
+
+float ControllerSampler::clockTime(uint64_t counter) noexcept
+{
+    SDL_AtomicLock(&clockLock);
+    PlaybackClock current = clock;
+    SDL_AtomicUnlock(&clockLock);
+    if (!current.playing || counter < current.counter) return current.time;
+    return current.time + (float)((double)(counter - current.counter) / (double)SDL_GetPerformanceFrequency()) * current.speed;
+}
+
+void ControllerSampler::push(const Sample& sample) noexcept
+{
+    uint32_t current = tail.load(std::memory_order_relaxed);
+    if (current - head.load(std::memory_order_acquire) >= Capacity) {
+        // the main thread didn't drain for a long time
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring[current & Mask] = sample;
+    tail.store(current + 1, std::memory_order_release);
+}
+
+int ControllerSampler::samplerThread(void* user) noexcept
+{
+    auto ctx = static_cast<ControllerSampler*>(user);
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+
+    const uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t nextDue = SDL_GetPerformanceCounter();
+    float lastTime = 0.f;
+    Sample sample;
+    while (!ctx->shouldExit) {
+        uint64_t now = SDL_GetPerformanceCounter();
+        if (now >= nextDue) {
+            OFS_PROFILE("ControllerSample");
+            sample.time = ctx->clockTime(now);
+            // the smoothing can step back a little, that's no seek
+            if (sample.time < lastTime && lastTime - sample.time < ResyncThreshold) {
+                sample.time = lastTime;
+            }
+            lastTime = sample.time;
+
+            sample.axes.fill(0);
+            SDL_LockJoysticks();
+            // otherwise the axes only get refreshed when the main thread pumps events
+            SDL_GameControllerUpdate();
+            for (auto& controller : ControllerInput::Controllers) {
+                if (!controller.Connected()) continue;
+                for (int32_t axis = 0; axis < SDL_CONTROLLER_AXIS_MAX; axis += 1) {
+                    int16_t value = SDL_GameControllerGetAxis(controller.Gamepad(), (SDL_GameControllerAxis)axis);
+                    if (std::abs(value) > std::abs(sample.axes[axis])) {
+                        sample.axes[axis] = value;
+                    }
+                }
+            }
+            SDL_UnlockJoysticks();
+            ctx->push(sample);
+
+            uint64_t step = ctx->interval;
+            nextDue += step;
+            // don't try to catch up after a stall
+            if (nextDue <= now) nextDue = now + step;
+        }
+
+        // at high rates the whole interval is below a millisecond,
+        // sleep at microsecond granularity and only yield for the last bit
+        now = SDL_GetPerformanceCounter();
+        if (nextDue > now) {
+            uint64_t remainingUs = (nextDue - now) * 1000000 / frequency;
+            if (remainingUs >= 2000) SDL_Delay(remainingUs / 1000 - 1);
+            else if (remainingUs > SpinUs) std::this_thread::sleep_for(std::chrono::microseconds(remainingUs - SpinUs));
+            else SDL_Delay(0);
+        }
+    }
+
+    ctx->hasExited = true;
+    return 0;
+}
+
+bool ControllerSampler::Start(int32_t rate) noexcept
+{
+    rate = Util::Clamp(rate, MinRate, MaxRate);
+    interval = SDL_GetPerformanceFrequency() / rate;
+    if (running) return true;
+
+    if (!ring) ring = std::make_unique<Sample[]>(Capacity);
+    // nothing else touches the ring while the thread isn't running
+    head = 0;
+    tail = 0;
+    dropped = 0;
+
+    shouldExit = false;
+    hasExited = false;
+    auto thread = SDL_CreateThread(samplerThread, "ControllerSampler", this);
+    if (!thread) {
+        LOGF_ERROR("Failed to start the controller sampler: %s", SDL_GetError());
+        hasExited = true;
+        return false;
+    }
+    SDL_DetachThread(thread);
+    running = true;
+    return true;
+}
+
+void ControllerSampler::Stop() noexcept
+{
+    if (!running) return;
+    shouldExit = true;
+    while (!hasExited) {
+        SDL_Delay(1);
+    }
+    running = false;
+}
+
+void ControllerSampler::SetClock(float time, float speed, bool playing) noexcept
+{
+    uint64_t counter = SDL_GetPerformanceCounter();
+    float predicted = clockTime(counter);
+    // the player time only advances once per video frame,
+    // following it exactly would make the timestamps stutter
+    if (clock.playing && playing && clock.speed == speed) {
+        float error = time - predicted;
+        if (std::abs(error) < ResyncThreshold) time = predicted + error * 0.1f;
+    }
+
+    SDL_AtomicLock(&clockLock);
+    clock.time = time;
+    clock.speed = speed;
+    clock.playing = playing;
+    clock.counter = counter;
+    SDL_AtomicUnlock(&clockLock);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "SDL_atomic.h"
+#include "SDL_gamecontroller.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Polls the axes of the connected controllers on its own thread at a fixed rate.
+// The samples are timestamped with the extrapolated player time,
+// so their resolution doesn't depend on the frame rate.
+class ControllerSampler
+{
+    public:
+    struct Sample
+    {
+        // player time in seconds
+        float time;
+        // the value with the largest magnitude of all connected controllers
+        std::array<int16_t, SDL_CONTROLLER_AXIS_MAX> axes;
+    };
+
+    static constexpr int32_t MinRate = 60;
+    static constexpr int32_t MaxRate = 1000;
+    static constexpr uint32_t Capacity = 8192;
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+    private:
+    static constexpr uint32_t Mask = Capacity - 1;
+
+    // the last known player time, extrapolated while playing
+    struct PlaybackClock
+    {
+        float time = 0.f;
+        float speed = 1.f;
+        bool playing = false;
+        uint64_t counter = 0;
+    };
+
+    // single producer single consumer
+    std::unique_ptr<Sample[]> ring;
+    alignas(64) std::atomic<uint32_t> tail = 0;
+    alignas(64) std::atomic<uint32_t> head = 0;
+    std::atomic<uint32_t> dropped = 0;
+
+    SDL_SpinLock clockLock = {0};
+    PlaybackClock clock;
+
+    std::atomic<uint64_t> interval = 0;
+    std::atomic<bool> running = false;
+    std::atomic<bool> shouldExit = false;
+    std::atomic<bool> hasExited = true;
+
+    static int samplerThread(void* user) noexcept;
+    float clockTime(uint64_t counter) noexcept;
+    void push(const Sample& sample) noexcept;
+
+    public:
+    ControllerSampler() noexcept = default;
+    ControllerSampler(const ControllerSampler&) = delete;
+    ControllerSampler(ControllerSampler&&) = delete;
+    ~ControllerSampler() noexcept;
+
+    // Main thread only. Starting a running sampler changes the rate.
+    bool Start(int32_t rate) noexcept;
+    void Stop() noexcept;
+    inline bool Running() const noexcept { return running; }
+
+    // Main thread only. Called every frame while running,
+    // small differences to the extrapolated time are smoothed out.
+    void SetClock(float time, float speed, bool playing) noexcept;
+
+    // Main thread only. Samples which didn't fit into the buffer since the last call.
+    inline uint32_t TakeDropped() noexcept { return dropped.exchange(0); }
+
+    // Main thread only. Calls fn for every sample taken since the last call.
+    template<typename Fn>
+    void Drain(Fn&& fn) noexcept
+    {
+        if (!ring) return;
+        uint32_t current = head.load(std::memory_order_relaxed);
+        const uint32_t end = tail.load(std::memory_order_acquire);
+        for (; current != end; current += 1) {
+            fn(ring[current & Mask]);
+        }
+        head.store(current, std::memory_order_release);
+    }
+};
@@ -522,6 +522,54 @@ Frame limit is ignored.)",
 	R"(Chapters)",
 	R"(Create bookmark)",
 	R"(Create chapter)",
+	R"(Line mode)",
+	R"(Square)",
+	R"(Linear)",
+	R"(Frame buffer (MB))",
+	R"(Memory used to keep recently shown frames.
+Stepping between these frames doesn't need to decode anything.
+0 disables the frame buffer.)",
+	R"(Event statistics)",
+	R"(Queue depth)",
+	R"(Max)",
+	R"(Events)",
+	R"(Event)",
+	R"(Enqueued)",
+	R"(Per second)",
+	R"(Coalesced)",
+	R"(Listeners)",
+	R"(Location)",
+	R"(Calls)",
+	R"(Total ms)",
+	R"(Max us)",
+	R"(Address)",
+	R"(Protocol)",
+	R"(Queued)",
+	R"(Lag (ms))",
+	R"(Sent)",
+	R"(Combined)",
+	R"(Disconnect clients lagging behind (ms))",
+	R"(Disconnecting)",
+	R"(Websocket edit)",
+	R"(Avg ms)",
+	R"(Max ms)",
+	R"(Suspended)",
+	R"(Resume)",
+	R"(Instruction budget (millions))",
+	R"(Extensions running more instructions than this in a single call get suspended.
+0 disables the limit.)",
+	R"(Update budget (ms))",
+	R"(Extensions taking longer than this to update get updated less often.
+0 disables throttling.)",
+	R"(Load closed extensions on first use)",
+	R"(Enabled extensions with a closed window are loaded once their window gets opened or one of their bindings is used. Until then they don't update.)",
+	R"(Not loaded yet)",
+	R"(Tolerance)",
+	R"(Removes recorded actions which are within the tolerance of the line between their neighbours before they get added to the script.)",
+	R"(Sample rate)",
+	R"(While recording the controller gets sampled at this rate on its own thread, independent of the frame rate.)",
+	R"(p50 us)",
+	R"(p99 us)",
 	
 };
 
@@ -1033,5 +1081,49 @@ std::unordered_map<std::string, Tr> OFS_DefaultStrings::KeyMapping =
 	{"CHAPTER_BINDING_GROUP", Tr::CHAPTER_BINDING_GROUP},
 	{"ACTION_CREATE_BOOKMARK", Tr::ACTION_CREATE_BOOKMARK},
 	{"ACTION_CREATE_CHAPTER", Tr::ACTION_CREATE_CHAPTER},
+	{"LINE_MODE", Tr::LINE_MODE},
+	{"LINE_MODE_SQUARE", Tr::LINE_MODE_SQUARE},
+	{"LINE_MODE_LINEAR", Tr::LINE_MODE_LINEAR},
+	{"FRAME_BUFFER_MEMORY", Tr::FRAME_BUFFER_MEMORY},
+	{"FRAME_BUFFER_MEMORY_TOOLTIP", Tr::FRAME_BUFFER_MEMORY_TOOLTIP},
+	{"EVENT_STATISTICS", Tr::EVENT_STATISTICS},
+	{"QUEUE_DEPTH", Tr::QUEUE_DEPTH},
+	{"MAXIMUM", Tr::MAXIMUM},
+	{"EVENTS", Tr::EVENTS},
+	{"EVENT", Tr::EVENT},
+	{"ENQUEUED", Tr::ENQUEUED},
+	{"PER_SECOND", Tr::PER_SECOND},
+	{"COALESCED", Tr::COALESCED},
+	{"LISTENERS", Tr::LISTENERS},
+	{"LOCATION", Tr::LOCATION},
+	{"CALLS", Tr::CALLS},
+	{"TOTAL_MS", Tr::TOTAL_MS},
+	{"MAX_US", Tr::MAX_US},
+	{"ADDRESS", Tr::ADDRESS},
+	{"PROTOCOL", Tr::PROTOCOL},
+	{"QUEUED", Tr::QUEUED},
+	{"LAG_MS", Tr::LAG_MS},
+	{"SENT", Tr::SENT},
+	{"COMBINED", Tr::COMBINED},
+	{"MAX_CLIENT_LAG", Tr::MAX_CLIENT_LAG},
+	{"DISCONNECTING", Tr::DISCONNECTING},
+	{"WEBSOCKET_EDIT", Tr::WEBSOCKET_EDIT},
+	{"AVG_MS", Tr::AVG_MS},
+	{"MAX_MS", Tr::MAX_MS},
+	{"SUSPENDED", Tr::SUSPENDED},
+	{"RESUME", Tr::RESUME},
+	{"INSTRUCTION_BUDGET", Tr::INSTRUCTION_BUDGET},
+	{"INSTRUCTION_BUDGET_TOOLTIP", Tr::INSTRUCTION_BUDGET_TOOLTIP},
+	{"UPDATE_BUDGET", Tr::UPDATE_BUDGET},
+	{"UPDATE_BUDGET_TOOLTIP", Tr::UPDATE_BUDGET_TOOLTIP},
+	{"LAZY_LOADING", Tr::LAZY_LOADING},
+	{"LAZY_LOADING_TOOLTIP", Tr::LAZY_LOADING_TOOLTIP},
+	{"NOT_LOADED_YET", Tr::NOT_LOADED_YET},
+	{"TOLERANCE", Tr::TOLERANCE},
+	{"RECORDING_SIMPLIFY_TOOLTIP", Tr::RECORDING_SIMPLIFY_TOOLTIP},
+	{"SAMPLE_RATE", Tr::SAMPLE_RATE},
+	{"SAMPLE_RATE_TOOLTIP", Tr::SAMPLE_RATE_TOOLTIP},
+	{"P50_US", Tr::P50_US},
+	{"P99_US", Tr::P99_US},
 
 };
@@ -512,6 +512,50 @@ enum class Tr : uint32_t
 	CHAPTER_BINDING_GROUP,
 	ACTION_CREATE_BOOKMARK,
 	ACTION_CREATE_CHAPTER,
+	LINE_MODE,
+	LINE_MODE_SQUARE,
+	LINE_MODE_LINEAR,
+	FRAME_BUFFER_MEMORY,
+	FRAME_BUFFER_MEMORY_TOOLTIP,
+	EVENT_STATISTICS,
+	QUEUE_DEPTH,
+	MAXIMUM,
+	EVENTS,
+	EVENT,
+	ENQUEUED,
+	PER_SECOND,
+	COALESCED,
+	LISTENERS,
+	LOCATION,
+	CALLS,
+	TOTAL_MS,
+	MAX_US,
+	ADDRESS,
+	PROTOCOL,
+	QUEUED,
+	LAG_MS,
+	SENT,
+	COMBINED,
+	MAX_CLIENT_LAG,
+	DISCONNECTING,
+	WEBSOCKET_EDIT,
+	AVG_MS,
+	MAX_MS,
+	SUSPENDED,
+	RESUME,
+	INSTRUCTION_BUDGET,
+	INSTRUCTION_BUDGET_TOOLTIP,
+	UPDATE_BUDGET,
+	UPDATE_BUDGET_TOOLTIP,
+	LAZY_LOADING,
+	LAZY_LOADING_TOOLTIP,
+	NOT_LOADED_YET,
+	TOLERANCE,
+	RECORDING_SIMPLIFY_TOOLTIP,
+	SAMPLE_RATE,
+	SAMPLE_RATE_TOOLTIP,
+	P50_US,
+	P99_US,
 	MAX_STRING_COUNT
 };
 
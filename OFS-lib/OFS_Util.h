@@ -206,7 +206,8 @@ public:
     inline static nlohmann::json ParseCBOR(const std::vector<uint8_t>& data, bool* success) noexcept
     {
         try {
-            auto json = nlohmann::json::from_cbor(data);
+            // tags are kept so typed arrays can be told apart
+            auto json = nlohmann::json::from_cbor(data, true, true, nlohmann::json::cbor_tag_handler_t::store);
             *success = !json.is_discarded();
             return json;
         }
@@ -67,10 +67,20 @@ void ScriptTimeline::Init()
 		WaveformProcessingFinishedEvent::HandleEvent(EVENT_SYSTEM_BIND(this, &ScriptTimeline::FfmpegAudioProcessingFinished)));
 	EV::Queue().appendListener(VideoLoadedEvent::EventType,
 		VideoLoadedEvent::HandleEvent(EVENT_SYSTEM_BIND(this, &ScriptTimeline::videoLoaded)));
+	EV::Queue().appendListener(FunscriptActionsChangedEvent::EventType,
+		FunscriptActionsChangedEvent::HandleEvent(EVENT_SYSTEM_BIND(this, &ScriptTimeline::funscriptActionsChanged)));
 
 	Wave.Init();
 }
 
+void ScriptTimeline::funscriptActionsChanged(const FunscriptActionsChangedEvent* ev) noexcept
+{
+	auto& overlayState = BaseOverlayState::State(overlayStateHandle);
+	if (!overlayState.SplineMode() || !ev->Script->Enabled) return;
+	// rebuild the spline tessellation in the background
+	ev->Script->LineCache->Request(ev->Script->Actions(), ev->Script->ActionsVersion());
+}
+
 void ScriptTimeline::mouseScroll(const OFS_SDL_Event* ev) noexcept
 {
 	OFS_PROFILE(__FUNCTION__);
@@ -453,7 +463,15 @@ void ScriptTimeline::ShowScriptPositions(
 				auto& overlayState = BaseOverlayState::State(overlayStateHandle);
 				ImGui::MenuItem(TR(SHOW_ACTION_LINES), 0, &BaseOverlay::ShowLines);
 				ImGui::MenuItem(TR(SHOW_ACTION_POINTS), 0, &BaseOverlay::ShowPoints);
-				//ImGui::MenuItem(TR(SPLINE_MODE), 0, &overlayState.SplineMode);
+				if (ImGui::BeginMenu(TR_ID("LINE_MODE", Tr::LINE_MODE))) {
+					if (ImGui::MenuItem(TR(LINE_MODE_SQUARE), 0, overlayState.LineMode == BaseOverlayLineMode::Square))
+						overlayState.LineMode = BaseOverlayLineMode::Square;
+					if (ImGui::MenuItem(TR(LINE_MODE_LINEAR), 0, overlayState.LineMode == BaseOverlayLineMode::Linear))
+						overlayState.LineMode = BaseOverlayLineMode::Linear;
+					if (ImGui::MenuItem(TR(SPLINE), 0, overlayState.LineMode == BaseOverlayLineMode::Spline))
+						overlayState.LineMode = BaseOverlayLineMode::Spline;
+					ImGui::EndMenu();
+				}
 				ImGui::MenuItem(TR(SHOW_VIDEO_POSITION), 0, &overlayState.SyncLineEnable);
 				OFS::Tooltip(TR(SHOW_VIDEO_POSITION_TOOLTIP));
 				ImGui::EndMenu();
@@ -26,6 +26,7 @@ public:
 private:
 	void mouseScroll(const OFS_SDL_Event* ev) noexcept;
 	void videoLoaded(const class VideoLoadedEvent* ev) noexcept;
+	void funscriptActionsChanged(const FunscriptActionsChangedEvent* ev) noexcept;
 
 	void handleSelectionScrolling(const OverlayDrawingCtx& ctx) noexcept;
 	void handleTimelineHover(const OverlayDrawingCtx& ctx) noexcept;
@@ -0,0 +1,363 @@
+#include "OFS_ThumbnailCache.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+#include "OFS_GL.h"
+
+#include "SDL_thread.h"
+#include "SDL_rwops.h"
+
+#include "stb_image.h"
+#include "stb_image_write.h"
+#include "subprocess.h"
+
+#include <atomic>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+constexpr int32_t ThumbChannels = 3;
+constexpr int32_t ThumbFrameSize = OFS_ThumbnailCache::ThumbWidth * OFS_ThumbnailCache::ThumbHeight * ThumbChannels;
+constexpr int32_t AtlasPageSize = OFS_ThumbnailCache::AtlasSize * OFS_ThumbnailCache::AtlasSize * ThumbChannels;
+constexpr int32_t ThumbCacheVersion = 1;
+
+struct OFS_ThumbnailCache::Job
+{
+	std::string videoPath;
+	float interval = 0.f;
+	int32_t count = 0;
+
+	// one AtlasPageSize buffer per page, allocated before the worker starts and never resized
+	std::vector<uint8_t> pixels;
+	std::atomic<int32_t> decodedCount = 0;
+
+	std::atomic<bool> cancel = false;
+	std::atomic<bool> finished = false;
+};
+
+inline static int32_t pageCount(int32_t count) noexcept
+{
+	return (count + OFS_ThumbnailCache::ThumbsPerPage - 1) / OFS_ThumbnailCache::ThumbsPerPage;
+}
+
+inline static uint8_t* thumbPixels(std::vector<uint8_t>& pixels, int32_t idx) noexcept
+{
+	int32_t page = idx / OFS_ThumbnailCache::ThumbsPerPage;
+	int32_t local = idx % OFS_ThumbnailCache::ThumbsPerPage;
+	int32_t x = (local % OFS_ThumbnailCache::ThumbsPerRow) * OFS_ThumbnailCache::ThumbWidth;
+	int32_t y = (local / OFS_ThumbnailCache::ThumbsPerRow) * OFS_ThumbnailCache::ThumbHeight;
+	return pixels.data() + (size_t)page * AtlasPageSize + ((size_t)y * OFS_ThumbnailCache::AtlasSize + x) * ThumbChannels;
+}
+
+static uint64_t mediaHash(const std::string& path) noexcept
+{
+	// hashing the whole file would take too long, the size plus head and tail are good enough
+	auto file = Util::OpenFile(path.c_str(), "rb", path.size());
+	if (!file) return 0;
+
+	uint64_t hash = 14695981039346656037ULL;
+	auto fnv1a = [&hash](const uint8_t* data, size_t size) noexcept {
+		for (size_t i = 0; i < size; i += 1) {
+			hash ^= data[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+
+	int64_t size = SDL_RWsize(file);
+	fnv1a((const uint8_t*)&size, sizeof(size));
+
+	std::vector<uint8_t> chunk(64 * 1024);
+	size_t read = SDL_RWread(file, chunk.data(), 1, chunk.size());
+	fnv1a(chunk.data(), read);
+	if (size > (int64_t)chunk.size() && SDL_RWseek(file, -(int64_t)chunk.size(), RW_SEEK_END) >= 0) {
+		read = SDL_RWread(file, chunk.data(), 1, chunk.size());
+		fnv1a(chunk.data(), read);
+	}
+	SDL_RWclose(file);
+	return hash;
+}
+
+static std::string cacheFilePath(uint64_t hash, const char* suffix) noexcept
+{
+	char name[64];
+	stbsp_snprintf(name, sizeof(name), "thumbnails/%016llx%s", (unsigned long long)hash, suffix);
+	return Util::Prefpath(name);
+}
+
+static bool loadCache(OFS_ThumbnailCache::Job& job, uint64_t hash) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto metaPath = cacheFilePath(hash, ".json");
+	if (!Util::FileExists(metaPath)) return false;
+
+	bool succ;
+	auto meta = Util::ParseJson(Util::ReadFileString(metaPath.c_str()), &succ);
+	if (!succ || !meta.is_object()) return false;
+	if (meta.value("version", 0) != ThumbCacheVersion
+		|| meta.value("width", 0) != OFS_ThumbnailCache::ThumbWidth
+		|| meta.value("height", 0) != OFS_ThumbnailCache::ThumbHeight
+		|| meta.value("count", 0) != job.count) {
+		return false;
+	}
+
+	std::vector<uint8_t> buffer;
+	for (int32_t page = 0, pages = pageCount(job.count); page < pages; page += 1) {
+		char suffix[16];
+		stbsp_snprintf(suffix, sizeof(suffix), "_%d.png", page);
+		auto pagePath = cacheFilePath(hash, suffix);
+		if (Util::ReadFile(pagePath.c_str(), buffer) == 0) return false;
+
+		int w, h, channels;
+		auto img = stbi_load_from_memory(buffer.data(), buffer.size(), &w, &h, &channels, ThumbChannels);
+		if (!img) return false;
+		bool valid = w == OFS_ThumbnailCache::AtlasSize && h == OFS_ThumbnailCache::AtlasSize;
+		if (valid) {
+			memcpy(job.pixels.data() + (size_t)page * AtlasPageSize, img, AtlasPageSize);
+		}
+		stbi_image_free(img);
+		if (!valid) return false;
+	}
+	return true;
+}
+
+static void saveCache(OFS_ThumbnailCache::Job& job, uint64_t hash) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	if (!Util::CreateDirectories(Util::PathFromString(Util::Prefpath("thumbnails")))) return;
+
+	stbi_flip_vertically_on_write(false);
+	std::vector<uint8_t> png;
+	for (int32_t page = 0, pages = pageCount(job.count); page < pages; page += 1) {
+		png.clear();
+		bool succ = stbi_write_png_to_func([](void* ctx, void* data, int size) {
+			auto& out = *(std::vector<uint8_t>*)ctx;
+			out.insert(out.end(), (uint8_t*)data, (uint8_t*)data + size);
+		}, &png, OFS_ThumbnailCache::AtlasSize, OFS_ThumbnailCache::AtlasSize, ThumbChannels,
+			job.pixels.data() + (size_t)page * AtlasPageSize, 0);
+
+		char suffix[16];
+		stbsp_snprintf(suffix, sizeof(suffix), "_%d.png", page);
+		auto pagePath = cacheFilePath(hash, suffix);
+		if (!succ || Util::WriteFile(pagePath.c_str(), png.data(), png.size()) != png.size()) {
+			LOGF_WARN("Failed to write thumbnail cache \"%s\"", pagePath.c_str());
+			return;
+		}
+	}
+
+	// the meta file is written last so a partially written cache is never picked up
+	nlohmann::json meta;
+	meta["version"] = ThumbCacheVersion;
+	meta["width"] = OFS_ThumbnailCache::ThumbWidth;
+	meta["height"] = OFS_ThumbnailCache::ThumbHeight;
+	meta["count"] = job.count;
+	meta["interval"] = job.interval;
+	auto metaJson = Util::SerializeJson(meta);
+	auto metaPath = cacheFilePath(hash, ".json");
+	Util::WriteFile(metaPath.c_str(), metaJson.data(), metaJson.size());
+}
+
+static bool decodeThumbnails(OFS_ThumbnailCache::Job& job) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto ffmpegPath = Util::FfmpegPath().u8string();
+
+	char filter[256];
+	stbsp_snprintf(filter, sizeof(filter),
+		"fps=fps=%.6f,scale=%d:%d:force_original_aspect_ratio=decrease,pad=%d:%d:(ow-iw)/2:(oh-ih)/2",
+		1.f / job.interval,
+		OFS_ThumbnailCache::ThumbWidth, OFS_ThumbnailCache::ThumbHeight,
+		OFS_ThumbnailCache::ThumbWidth, OFS_ThumbnailCache::ThumbHeight);
+
+	// only keyframes get decoded, the fps filter repeats the last keyframe for every thumbnail
+	std::array<const char*, 19> args =
+	{
+		ffmpegPath.c_str(),
+		"-loglevel", "quiet",
+		"-nostdin",
+		"-skip_frame", "nokey",
+		"-i", job.videoPath.c_str(),
+		"-an", "-sn", "-dn",
+		"-vf", filter,
+		"-pix_fmt", "rgb24",
+		"-f", "rawvideo",
+		"-",
+		nullptr
+	};
+
+	struct subprocess_s proc;
+	if (subprocess_create(args.data(), subprocess_option_no_window | subprocess_option_enable_async, &proc) != 0) {
+		LOG_WARN("Failed to start ffmpeg for thumbnail generation.");
+		return false;
+	}
+
+	std::vector<uint8_t> frame(ThumbFrameSize);
+	int32_t filled = 0;
+	int32_t decoded = 0;
+	while (!job.cancel && decoded < job.count) {
+		uint32_t read = subprocess_read_stdout(&proc, (char*)frame.data() + filled, ThumbFrameSize - filled);
+		if (read == 0) break;
+		filled += read;
+		if (filled < ThumbFrameSize) continue;
+
+		auto dst = thumbPixels(job.pixels, decoded);
+		for (int32_t y = 0; y < OFS_ThumbnailCache::ThumbHeight; y += 1) {
+			memcpy(dst + (size_t)y * OFS_ThumbnailCache::AtlasSize * ThumbChannels,
+				frame.data() + (size_t)y * OFS_ThumbnailCache::ThumbWidth * ThumbChannels,
+				OFS_ThumbnailCache::ThumbWidth * ThumbChannels);
+		}
+		decoded += 1;
+		filled = 0;
+		job.decodedCount.store(decoded, std::memory_order_release);
+	}
+
+	if (subprocess_alive(&proc)) {
+		subprocess_terminate(&proc);
+	}
+	int returnCode;
+	subprocess_join(&proc, &returnCode);
+	subprocess_destroy(&proc);
+
+	// the fps filter may round away the last thumbnail, that's still a complete set
+	return !job.cancel && decoded >= job.count - 1;
+}
+
+static int ThumbnailThread(void* data) noexcept
+{
+	auto jobPtr = (std::shared_ptr<OFS_ThumbnailCache::Job>*)data;
+	auto job = std::move(*jobPtr);
+	delete jobPtr;
+
+	uint64_t hash = mediaHash(job->videoPath);
+	if (hash != 0 && loadCache(*job, hash)) {
+		job->decodedCount.store(job->count, std::memory_order_release);
+	}
+	else if (decodeThumbnails(*job)) {
+		// the missing tail thumbnail is just a copy of the one before it
+		int32_t decoded = job->decodedCount.load(std::memory_order_acquire);
+		if (decoded > 0 && decoded < job->count) {
+			auto src = thumbPixels(job->pixels, decoded - 1);
+			auto dst = thumbPixels(job->pixels, decoded);
+			for (int32_t y = 0; y < OFS_ThumbnailCache::ThumbHeight; y += 1) {
+				size_t offset = (size_t)y * OFS_ThumbnailCache::AtlasSize * ThumbChannels;
+				memcpy(dst + offset, src + offset, OFS_ThumbnailCache::ThumbWidth * ThumbChannels);
+			}
+			job->decodedCount.store(job->count, std::memory_order_release);
+		}
+		if (hash != 0) saveCache(*job, hash);
+	}
+
+	job->finished = true;
+	return 0;
+}
+
+OFS_ThumbnailCache::~OFS_ThumbnailCache() noexcept
+{
+	// has to be destroyed before the gl context
+	Close();
+}
+
+void OFS_ThumbnailCache::Open(const std::string& path, float duration) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	if (path.empty() || duration <= 0.f) {
+		Close();
+		return;
+	}
+
+	int32_t newCount = Util::Clamp((int32_t)std::ceil(duration / MinInterval), 1, MaxThumbnails);
+	if (path == videoPath && newCount == count) return;
+
+	Close();
+	videoPath = path;
+	count = newCount;
+	interval = duration / count;
+
+	job = std::make_shared<Job>();
+	job->videoPath = videoPath;
+	job->interval = interval;
+	job->count = count;
+	job->pixels.resize((size_t)pageCount(count) * AtlasPageSize, 0);
+
+	auto threadData = new std::shared_ptr<Job>(job);
+	auto handle = SDL_CreateThread(ThumbnailThread, "OFS_Thumbnails", threadData);
+	if (!handle) {
+		delete threadData;
+		job->finished = true;
+		return;
+	}
+	SDL_DetachThread(handle);
+}
+
+void OFS_ThumbnailCache::Close() noexcept
+{
+	if (job) {
+		job->cancel = true;
+		job.reset();
+	}
+	if (!pages.empty()) {
+		glDeleteTextures(pages.size(), pages.data());
+		pages.clear();
+	}
+	videoPath.clear();
+	interval = 0.f;
+	count = 0;
+	uploadedCount = 0;
+}
+
+void OFS_ThumbnailCache::Update() noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	if (!job) return;
+
+	if (pages.empty()) {
+		pages.resize(pageCount(count));
+		glGenTextures(pages.size(), pages.data());
+		for (auto tex : pages) {
+			glBindTexture(GL_TEXTURE_2D, tex);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, AtlasSize, AtlasSize, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+		}
+	}
+
+	bool finished = job->finished;
+	int32_t decoded = job->decodedCount.load(std::memory_order_acquire);
+	int32_t uploadEnd = std::min(decoded, uploadedCount + MaxUploadsPerFrame);
+	if (uploadedCount < uploadEnd) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, AtlasSize);
+		for (int32_t i = uploadedCount; i < uploadEnd; i += 1) {
+			int32_t local = i % ThumbsPerPage;
+			glBindTexture(GL_TEXTURE_2D, pages[i / ThumbsPerPage]);
+			glTexSubImage2D(GL_TEXTURE_2D, 0,
+				(local % ThumbsPerRow) * ThumbWidth, (local / ThumbsPerRow) * ThumbHeight,
+				ThumbWidth, ThumbHeight, GL_RGB, GL_UNSIGNED_BYTE, thumbPixels(job->pixels, i));
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		uploadedCount = uploadEnd;
+	}
+
+	if (finished && uploadedCount == decoded) {
+		// everything is on the gpu, the cpu copy isn't needed anymore
+		count = uploadedCount > 0 ? count : 0;
+		job.reset();
+	}
+}
+
+bool OFS_ThumbnailCache::Lookup(float time, uint32_t* texture, ImVec2* uv0, ImVec2* uv1) const noexcept
+{
+	if (count == 0 || uploadedCount == 0) return false;
+
+	int32_t idx = Util::Clamp((int32_t)std::round(time / interval), 0, count - 1);
+	if (idx >= uploadedCount) return false;
+
+	int32_t local = idx % ThumbsPerPage;
+	float x = (float)((local % ThumbsPerRow) * ThumbWidth);
+	float y = (float)((local / ThumbsPerRow) * ThumbHeight);
+	*texture = pages[idx / ThumbsPerPage];
+	*uv0 = ImVec2(x / AtlasSize, y / AtlasSize);
+	*uv1 = ImVec2((x + ThumbWidth) / AtlasSize, (y + ThumbHeight) / AtlasSize);
+	return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "imgui.h"
+
+// Low resolution thumbnails covering the whole video for the seek bar preview.
+// Keyframes get decoded by ffmpeg on a worker thread, packed into texture atlases
+// and persisted in the prefpath so that reopening a video doesn't decode anything.
+class OFS_ThumbnailCache
+{
+public:
+	static constexpr int32_t ThumbWidth = 128;
+	static constexpr int32_t ThumbHeight = 72;
+	static constexpr int32_t AtlasSize = 1024;
+	static constexpr int32_t ThumbsPerRow = AtlasSize / ThumbWidth;
+	static constexpr int32_t ThumbsPerPage = ThumbsPerRow * (AtlasSize / ThumbHeight);
+	static constexpr int32_t MaxThumbnails = 600;
+	static constexpr float MinInterval = 1.f;
+	// limits the amount of texture uploads per frame
+	static constexpr int32_t MaxUploadsPerFrame = 64;
+
+	struct Job;
+
+private:
+	std::shared_ptr<Job> job;
+	std::vector<uint32_t> pages;
+	std::string videoPath;
+	float interval = 0.f;
+	int32_t count = 0;
+	int32_t uploadedCount = 0;
+
+public:
+	OFS_ThumbnailCache() noexcept = default;
+	~OFS_ThumbnailCache() noexcept;
+
+	// Starts loading or generating thumbnails. Does nothing if they are already loaded for this video.
+	void Open(const std::string& videoPath, float duration) noexcept;
+	void Close() noexcept;
+
+	// Main thread only. Uploads decoded thumbnails to the atlas.
+	void Update() noexcept;
+
+	// Returns false if the thumbnail for this time isn't available (yet).
+	bool Lookup(float time, uint32_t* texture, ImVec2* uv0, ImVec2* uv1) const noexcept;
+
+	inline bool Busy() const noexcept { return job != nullptr; }
+	inline float Progress() const noexcept { return count > 0 ? (float)uploadedCount / count : 0.f; }
+};
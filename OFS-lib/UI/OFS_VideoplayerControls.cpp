@@ -21,6 +21,14 @@ void OFS_VideoplayerControls::VideoLoaded(const VideoLoadedEvent* ev) noexcept
     OFS_PROFILE(__FUNCTION__);
     if(ev->playerType != VideoplayerType::Main) return;
     videoPreview->PreviewVideo(ev->videoPath, 0.f);
+    Thumbnails->Open(ev->videoPath, player->Duration());
+}
+
+void OFS_VideoplayerControls::DurationChanged(const DurationChangeEvent* ev) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    if(ev->playerType != VideoplayerType::Main) return;
+    Thumbnails->Open(player->VideoPath(), ev->duration);
 }
 
 void OFS_VideoplayerControls::Init(OFS_Videoplayer* player, bool hwAccel) noexcept
@@ -31,9 +39,12 @@ void OFS_VideoplayerControls::Init(OFS_Videoplayer* player, bool hwAccel) noexce
     Heatmap = std::make_unique<FunscriptHeatmap>();
     videoPreview = std::make_unique<VideoPreview>(hwAccel);
     videoPreview->Init();
+    Thumbnails = std::make_unique<OFS_ThumbnailCache>();
 
     EV::Queue().appendListener(VideoLoadedEvent::EventType,
         VideoLoadedEvent::HandleEvent(EVENT_SYSTEM_BIND(this, &OFS_VideoplayerControls::VideoLoaded)));
+    EV::Queue().appendListener(DurationChangeEvent::EventType,
+        DurationChangeEvent::HandleEvent(EVENT_SYSTEM_BIND(this, &OFS_VideoplayerControls::DurationChanged)));
 }
 
 inline static ImRect GetWidgetBB(float heightMulti) noexcept
@@ -114,7 +125,15 @@ bool OFS_VideoplayerControls::DrawTimelineWidget(const char* label, float* posit
 
         if(ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal))
         {
-            if (SDL_GetTicks() - lastPreviewUpdate >= PreviewUpdateMs) {
+            float timeSeconds = player->Duration() * relTimelinePos;
+            uint32_t thumbTex = 0;
+            ImVec2 thumbUv0, thumbUv1;
+            // the live preview is only used for thumbnails which aren't cached yet
+            bool hasThumb = Thumbnails->Lookup(timeSeconds, &thumbTex, &thumbUv0, &thumbUv1);
+            if (hasThumb) {
+                videoPreview->Pause();
+            }
+            else if (SDL_GetTicks() - lastPreviewUpdate >= PreviewUpdateMs) {
                 videoPreview->Play();
                 videoPreview->SetPosition(relTimelinePos);
                 lastPreviewUpdate = SDL_GetTicks();
@@ -122,8 +141,12 @@ bool OFS_VideoplayerControls::DrawTimelineWidget(const char* label, float* posit
             ImGui::BeginTooltipEx(ImGuiWindowFlags_None, ImGuiTooltipFlags_None);
             {
                 const ImVec2 ImageDim = ImVec2(ImGui::GetFontSize()*7.f * (16.f / 9.f), ImGui::GetFontSize() * 7.f);
-                ImGui::Image((void*)(intptr_t)videoPreview->FrameTex(), ImageDim);
-                float timeSeconds = player->Duration() * relTimelinePos;
+                if (hasThumb) {
+                    ImGui::Image((void*)(intptr_t)thumbTex, ImageDim, thumbUv0, thumbUv1);
+                }
+                else {
+                    ImGui::Image((void*)(intptr_t)videoPreview->FrameTex(), ImageDim);
+                }
                 float timeDelta = timeSeconds - player->CurrentTime();
 
                 char timeBuf1[16];
@@ -508,6 +531,7 @@ void OFS_VideoplayerControls::DrawTimeline() noexcept
 {
     OFS_PROFILE(__FUNCTION__);
     FUN_ASSERT(player != nullptr, "nullptr");
+    Thumbnails->Update();
     ImGui::Begin(TR_ID(TimeId, Tr::TIME));
 
     {
@@ -2,6 +2,7 @@
 
 #include "GradientBar.h"
 #include "OFS_Videopreview.h"
+#include "OFS_ThumbnailCache.h"
 #include "FunscriptHeatmap.h"
 
 class OFS_VideoplayerControls
@@ -26,12 +27,14 @@ private:
 	void DrawChapterWidget(ImDrawList* drawList, float currentTime) noexcept;
 
 	void VideoLoaded(const class VideoLoadedEvent* ev) noexcept;
+	void DurationChanged(const class DurationChangeEvent* ev) noexcept;
 	bool DrawTimelineWidget(const char* label, float* position) noexcept;
 public:
 	static constexpr const char* ControlId = "###CONTROLS";
 	static constexpr const char* TimeId = "###TIME";
 
 	std::unique_ptr<VideoPreview> videoPreview;
+	std::unique_ptr<OFS_ThumbnailCache> Thumbnails;
 	std::unique_ptr<FunscriptHeatmap> Heatmap;
 
 	void Init(class OFS_Videoplayer* player, bool hwAccel) noexcept;
@@ -41,6 +44,11 @@ public:
 		Heatmap->Update(totalDuration, actions);
 	}
 
+	inline void UpdateHeatmap(float totalDuration, const FunscriptArray& actions, float dirtyStart, float dirtyEnd) noexcept
+	{
+		Heatmap->Update(totalDuration, actions, dirtyStart, dirtyEnd);
+	}
+
 	void DrawTimeline() noexcept;
 	void DrawControls() noexcept;
 
@@ -15,6 +15,8 @@ VideoPreview::~VideoPreview() noexcept
 void VideoPreview::Init() noexcept
 {
 	player->SetVolume(0.f);
+	// previews don't need to be frame accurate
+	player->SetSeekMode(VideoplayerSeekMode::Keyframe);
 }
 
 void VideoPreview::Update(float delta) noexcept
@@ -6,9 +6,11 @@
 
 #include "state/states/BaseOverlayState.h"
 
+#include <algorithm>
 #include <cmath>
 
 std::vector<BaseOverlay::ColoredLine> BaseOverlay::ColoredLines;
+std::vector<BaseOverlay::PendingSamples> BaseOverlay::Pending;
 
 constexpr float MaxPointSize = 8.f;
 float BaseOverlay::PointSize = MaxPointSize;
@@ -47,6 +49,7 @@ void EmptyOverlay::DrawScriptPositionContent(const OverlayDrawingCtx& ctx) noexc
     timeline->DrawAudioWaveform(ctx);
     BaseOverlay::DrawActionLines(ctx);
     BaseOverlay::DrawActionPoints(ctx);
+    BaseOverlay::DrawPendingSamples(ctx);
 }
 
 float EmptyOverlay::steppingIntervalForward(float realFrameTime, float fromTime) noexcept
@@ -88,100 +91,54 @@ ImVec2 BaseOverlay::GetPointForAction(const OverlayDrawingCtx& ctx, FunscriptAct
 
 void BaseOverlay::drawActionLinesSpline(const OverlayDrawingCtx& ctx, const BaseOverlayState& state) noexcept
 {
-    auto drawSpline = [](const OverlayDrawingCtx& ctx, FunscriptAction startAction, FunscriptAction endAction, uint32_t color, float width, bool background = true) noexcept {
-        constexpr float SamplesPerTwothousandPixels = 150.f;
-        const float MaximumSamples = SamplesPerTwothousandPixels * (ctx.canvasSize.x / 2000.f);
-
-        auto getPointForTimePos = [](const OverlayDrawingCtx& ctx, float time, float pos) noexcept {
-            float relative_x = (float)(time - ctx.offsetTime) / ctx.visibleTime;
-            float x = (ctx.canvasSize.x) * relative_x;
-            float y = (ctx.canvasSize.y) * (1 - (pos / 100.f));
-            x += ctx.canvasPos.x;
-            y += ctx.canvasPos.y;
-            return ImVec2(x, y);
-        };
-        auto putPoint = [getPointForTimePos](auto& ctx, float time) noexcept {
-            float pos = Util::Clamp<float>(ctx.DrawingScript()->Spline(time) * 100.f, 0.f, 100.f);
-            ctx.drawList->PathLineTo(getPointForTimePos(ctx, time, pos));
-        };
-
-        ctx.drawList->PathClear();
-        float visibleDuration;
-        float currentTime;
-        float endTime;
-        if (startAction.atS >= ctx.offsetTime && endAction.atS <= (ctx.offsetTime + ctx.visibleTime)) {
-            currentTime = startAction.atS;
-            endTime = endAction.atS;
-            visibleDuration = endTime - currentTime;
-        }
-        else if (startAction.atS < ctx.offsetTime && endAction.atS > (ctx.offsetTime + ctx.visibleTime)) {
-            // clip at the invisible area in both direction
-            currentTime = ctx.offsetTime;
-            endTime = (ctx.offsetTime + ctx.visibleTime);
-            visibleDuration = ctx.visibleTime;
-        }
-        else if (startAction.atS < ctx.offsetTime) {
-            // clip invisible area on the left
-            currentTime = ctx.offsetTime;
-            endTime = endAction.atS;
-            visibleDuration = endAction.atS - ctx.offsetTime;
-        }
-        else if (endAction.atS > (ctx.offsetTime + ctx.visibleTime)) {
-            // clip invisble area on the right
-            currentTime = startAction.atS;
-            endTime = (ctx.offsetTime + ctx.visibleTime) + 0.001f;
-            visibleDuration = endTime - startAction.atS;
-        }
-
-        // detail gets dynamically reduced by increasing the timeStep,
-        // at which is being sampled from the spline
-        const float ratio = visibleDuration / ctx.visibleTime;
-        const float SampleCount = MaximumSamples * ratio;
+    auto& drawingScript = ctx.DrawingScript();
+    auto& lineCache = drawingScript->LineCache;
+    lineCache->Request(drawingScript->Actions(), drawingScript->ActionsVersion());
+    auto tess = lineCache->Get(drawingScript->ActionsVersion());
+    if (!tess) {
+        // the cache hasn't caught up with the latest edit yet
+        drawActionLinesLinear(ctx, state);
+        return;
+    }
 
-        const float timeStep = visibleDuration / SampleCount;
+    auto getPointForSample = [](const OverlayDrawingCtx& ctx, FunscriptLineCache::Point sample) noexcept {
+        float relative_x = (float)(sample.atS - ctx.offsetTime) / ctx.visibleTime;
+        float x = (ctx.canvasSize.x) * relative_x;
+        float y = (ctx.canvasSize.y) * (1 - (sample.pos / 100.f));
+        x += ctx.canvasPos.x;
+        y += ctx.canvasPos.y;
+        return ImVec2(x, y);
+    };
 
-        if (SampleCount < 3.f) {
-            auto p1 = BaseOverlay::GetPointForAction(ctx, startAction);
-            auto p2 = BaseOverlay::GetPointForAction(ctx, endAction);
-            if (background) {
-                ctx.drawList->PathLineTo(p1);
-                ctx.drawList->PathLineTo(p2);
-                ctx.drawList->PathStroke(IM_COL32_BLACK, false, 7.f);
-            }
-            ColoredLines.emplace_back(std::move(BaseOverlay::ColoredLine{ p1, p2, color }));
-        }
-        else {
-            putPoint(ctx, currentTime);
-            currentTime += timeStep;
-            while (currentTime < endTime) {
-                putPoint(ctx, currentTime);
-                currentTime += timeStep;
-            }
-            putPoint(ctx, endAction.atS);
-            auto tmpSize = ctx.drawList->_Path.Size;
-            ctx.drawList->PathStroke(IM_COL32_BLACK, false, 7.f);
-            ctx.drawList->_Path.Size = tmpSize;
-            ctx.drawList->PathStroke(color, false, width);
+    // samples closer than a couple pixels get skipped
+    // segments shorter than that collapse into a straight line
+    const float timePerPixel = ctx.visibleTime / ctx.canvasSize.x;
+    const uint32_t stride = Util::Max<uint32_t>(1, (uint32_t)((2.f * timePerPixel) / FunscriptLineCache::SampleInterval));
+
+    auto drawSegment = [&](uint32_t segment, uint32_t color, bool background) noexcept {
+        uint32_t first = tess->segmentOffsets[segment];
+        uint32_t last = tess->segmentOffsets[segment + 1];
+        ImVec2 prev = getPointForSample(ctx, tess->points[first]);
+        if (background && ctx.drawList->_Path.Size == 0) ctx.drawList->PathLineTo(prev);
+        for (uint32_t i = first + stride;; i += stride) {
+            if (i > last) i = last;
+            auto p = getPointForSample(ctx, tess->points[i]);
+            if (background) ctx.drawList->PathLineTo(p);
+            ColoredLines.emplace_back(std::move(BaseOverlay::ColoredLine{ prev, p, color }));
+            prev = p;
+            if (i == last) break;
         }
     };
 
-    auto& drawingScript = ctx.DrawingScript();
     {
-        auto startIt = drawingScript->Actions().begin() + ctx.actionFromIdx;
-        auto endIt = drawingScript->Actions().begin() + ctx.actionToIdx;
-
-        const FunscriptAction* prevAction = nullptr;
-        for (; startIt != endIt; ++startIt) {
-            auto& action = *startIt;
-            auto p1 = BaseOverlay::GetPointForAction(ctx, action);
-
-            if (prevAction != nullptr) {
-                ImColor speedColor;
-                getActionLineColor(&speedColor, FunscriptHeatmap::LineColors, action, *prevAction, state);
-                drawSpline(ctx, *prevAction, action, ImGui::ColorConvertFloat4ToU32(speedColor), 3.f);
-            }
-            prevAction = &action;
+        ctx.drawList->PathClear();
+        int32_t segmentEnd = Util::Min<int32_t>(ctx.actionToIdx, tess->actions.size()) - 1;
+        for (int32_t i = ctx.actionFromIdx; i < segmentEnd; i += 1) {
+            ImColor speedColor;
+            getActionLineColor(&speedColor, FunscriptHeatmap::LineColors, tess->actions[i + 1], tess->actions[i], state);
+            drawSegment(i, ImGui::ColorConvertFloat4ToU32(speedColor), true);
         }
+        ctx.drawList->PathStroke(IM_COL32_BLACK, false, 7.f);
     }
 
     if (drawingScript->HasSelection()) {
@@ -193,7 +150,13 @@ void BaseOverlay::drawActionLinesSpline(const OverlayDrawingCtx& ctx, const Base
 
             if (prevAction != nullptr) {
                 // draw highlight line
-                drawSpline(ctx, *prevAction, action, SelectedLineColor, 3.f, false);
+                auto fromIt = tess->actions.find(*prevAction);
+                auto toIt = tess->actions.find(action);
+                if (fromIt != tess->actions.end() && toIt != tess->actions.end()) {
+                    for (; fromIt != toIt; ++fromIt) {
+                        drawSegment(std::distance(tess->actions.begin(), fromIt), SelectedLineColor, false);
+                    }
+                }
             }
 
             prevAction = &action;
@@ -330,16 +293,17 @@ void BaseOverlay::DrawActionLines(const OverlayDrawingCtx& ctx) noexcept
     auto endIt = drawingScript->Actions().begin() + ctx.actionToIdx;
     ColoredLines.clear();
 
-    drawActionLinesSquare(ctx, state);
-    /*if(state.SplineMode)
-    {
-        drawActionLinesSpline(ctx, state);
+    switch (state.LineMode) {
+        case BaseOverlayLineMode::Linear:
+            drawActionLinesLinear(ctx, state);
+            break;
+        case BaseOverlayLineMode::Spline:
+            drawActionLinesSpline(ctx, state);
+            break;
+        default:
+            drawActionLinesSquare(ctx, state);
+            break;
     }
-    else
-    {
-        drawActionLinesLinear(ctx, state);
-    }
-    */
 
 
     // this is so that the black background line gets rendered first
@@ -348,6 +312,32 @@ void BaseOverlay::DrawActionLines(const OverlayDrawingCtx& ctx) noexcept
     }
 }
 
+void BaseOverlay::DrawPendingSamples(const OverlayDrawingCtx& ctx) noexcept
+{
+    if (Pending.empty()) return;
+    OFS_PROFILE(__FUNCTION__);
+    static std::vector<ImVec2> points;
+    auto drawingScript = ctx.DrawingScript().get();
+    for (auto& pending : Pending) {
+        if (pending.script != drawingScript || pending.samples->empty()) continue;
+        auto& samples = *pending.samples;
+        auto compare = [](FunscriptAction a, FunscriptAction b) noexcept { return a.atS < b.atS; };
+        // one sample on each side so the line reaches the border
+        auto startIt = std::lower_bound(samples.begin(), samples.end(), FunscriptAction(ctx.offsetTime, 0), compare);
+        auto endIt = std::upper_bound(startIt, samples.end(), FunscriptAction(ctx.offsetTime + ctx.visibleTime, 0), compare);
+        if (startIt != samples.begin()) --startIt;
+        if (endIt != samples.end()) ++endIt;
+
+        points.clear();
+        for (; startIt != endIt; ++startIt) {
+            points.emplace_back(BaseOverlay::GetPointForAction(ctx, *startIt));
+        }
+        if (points.size() < 2) continue;
+        ctx.drawList->AddPolyline(points.data(), points.size(), IM_COL32(0, 0, 0, 255), ImDrawFlags_None, 5.f);
+        ctx.drawList->AddPolyline(points.data(), points.size(), IM_COL32(0, 255, 0, 255), ImDrawFlags_None, 2.f);
+    }
+}
+
 void BaseOverlay::DrawActionPoints(const OverlayDrawingCtx& ctx) noexcept
 {
     if (!BaseOverlay::ShowPoints) return;
@@ -61,6 +61,13 @@ public:
 		uint32_t color;
 	};
 	static std::vector<ColoredLine> ColoredLines;
+
+	// recorded samples which aren't committed to the script yet, sorted by time
+	struct PendingSamples {
+		const Funscript* script;
+		const std::vector<FunscriptAction>* samples;
+	};
+	static std::vector<PendingSamples> Pending;
 	static float PointSize;
 	
 	static bool ShowLines;
@@ -81,6 +88,7 @@ public:
 
 	static void DrawActionLines(const OverlayDrawingCtx& ctx) noexcept;
 	static void DrawActionPoints(const OverlayDrawingCtx& ctx) noexcept;
+	static void DrawPendingSamples(const OverlayDrawingCtx& ctx) noexcept;
 	static void DrawSecondsLabel(const OverlayDrawingCtx& ctx) noexcept;
 	static void DrawHeightLines(const OverlayDrawingCtx& ctx) noexcept;
 	static void DrawScriptLabel(const OverlayDrawingCtx& ctx) noexcept;
@@ -1,7 +1,7 @@
 #include "OFS_Event.h"
 #include "OFS_EventSystem.h"
 
-OFS_EventType BaseEvent::RegisterNewEvent() noexcept
+OFS_EventType BaseEvent::RegisterNewEvent(OFS_EventCoalescing coalescing, const char* typeName) noexcept
 {
-    return EV::RegisterEvent();
+    return EV::RegisterEvent(coalescing, typeName);
 }
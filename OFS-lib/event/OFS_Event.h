@@ -4,18 +4,34 @@
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <typeinfo>
 
 using OFS_EventType = uint32_t;
 
 using UnsubscribeFn = std::function<void()>;
 
+// How queued events of the same type are collapsed before they get dispatched.
+// Events are only collapsed if their CoalesceKey matches.
+enum class OFS_EventCoalescing : uint8_t
+{
+    // every instance gets dispatched
+    AlwaysDeliver,
+    // only the last instance gets dispatched
+    LatestWins,
+    // like LatestWins but older instances get folded into the last one using Merge
+    Merge
+};
+
 class BaseEvent 
 {
     public:
     static constexpr OFS_EventType InvalidType = 0;
+    static constexpr OFS_EventCoalescing Coalescing = OFS_EventCoalescing::AlwaysDeliver;
     virtual ~BaseEvent() noexcept {}
     virtual OFS_EventType Type() const noexcept = 0;
-    static OFS_EventType RegisterNewEvent() noexcept;
+    virtual uint64_t CoalesceKey() const noexcept { return 0; }
+    virtual void Merge(const BaseEvent& older) noexcept {}
+    static OFS_EventType RegisterNewEvent(OFS_EventCoalescing coalescing, const char* typeName) noexcept;
 };
 
 using EventPointer = std::shared_ptr<BaseEvent>;
@@ -38,7 +54,7 @@ class OFS_Event : public BaseEvent
 };
 
 template<typename Event>
-OFS_EventType OFS_Event<Event>::EventType = BaseEvent::RegisterNewEvent();
+OFS_EventType OFS_Event<Event>::EventType = BaseEvent::RegisterNewEvent(Event::Coalescing, typeid(Event).name());
 
 class OFS_SDL_Event : public OFS_Event<OFS_SDL_Event>
 {
@@ -0,0 +1,47 @@
+#include "OFS_EventQueue.h"
+
+OFS_EventRing::OFS_EventRing() noexcept
+{
+    slots = std::make_unique<Slot[]>(Capacity);
+    for (uint32_t i = 0; i < Capacity; i += 1) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+void OFS_EventRing::pushOverflow(EventPointer&& ev) noexcept
+{
+    SDL_AtomicLock(&overflowLock);
+    overflowing.store(true, std::memory_order_release);
+    overflow.emplace_back(std::move(ev));
+    SDL_AtomicUnlock(&overflowLock);
+}
+
+void OFS_EventRing::Push(EventPointer&& ev) noexcept
+{
+    if (overflowing.load(std::memory_order_acquire)) {
+        pushOverflow(std::move(ev));
+        return;
+    }
+
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots[pos & Mask];
+        uint32_t seq = slot.sequence.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.event = std::move(ev);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return;
+            }
+        }
+        else if (diff < 0) {
+            // full
+            break;
+        }
+        else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+    pushOverflow(std::move(ev));
+}
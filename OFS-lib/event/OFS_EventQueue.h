@@ -0,0 +1,161 @@
+#pragma once
+
+#include "OFS_Event.h"
+
+#include "SDL_atomic.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Fixed size blocks which get recycled instead of returned to the heap.
+// There's one pool per block size so every event type ends up with its own pool.
+// Pools are never destroyed because events may outlive static destruction.
+template<size_t Size, size_t Align>
+class OFS_EventPool
+{
+    private:
+    union Block
+    {
+        Block* next;
+        alignas(Align) unsigned char storage[Size];
+    };
+    static constexpr size_t BlocksPerChunk = 64;
+
+    SDL_SpinLock lock = {0};
+    Block* freeList = nullptr;
+
+    void grow() noexcept
+    {
+        auto chunk = new Block[BlocksPerChunk];
+        for (size_t i = 0; i < BlocksPerChunk - 1; i += 1) {
+            chunk[i].next = &chunk[i + 1];
+        }
+        chunk[BlocksPerChunk - 1].next = freeList;
+        freeList = chunk;
+    }
+
+    public:
+    static OFS_EventPool& Get() noexcept
+    {
+        static OFS_EventPool* pool = new OFS_EventPool();
+        return *pool;
+    }
+
+    void* Alloc() noexcept
+    {
+        SDL_AtomicLock(&lock);
+        if (!freeList) grow();
+        Block* block = freeList;
+        freeList = block->next;
+        SDL_AtomicUnlock(&lock);
+        return block->storage;
+    }
+
+    void Free(void* ptr) noexcept
+    {
+        auto block = reinterpret_cast<Block*>(ptr);
+        SDL_AtomicLock(&lock);
+        block->next = freeList;
+        freeList = block;
+        SDL_AtomicUnlock(&lock);
+    }
+};
+
+// Used with std::allocate_shared so the control block and the event share one pooled block.
+template<typename T>
+struct OFS_EventAllocator
+{
+    using value_type = T;
+
+    OFS_EventAllocator() noexcept = default;
+    template<typename U>
+    OFS_EventAllocator(const OFS_EventAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) noexcept
+    {
+        if (n != 1) return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(OFS_EventPool<sizeof(T), alignof(T)>::Get().Alloc());
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept
+    {
+        if (n != 1) { ::operator delete(ptr); return; }
+        OFS_EventPool<sizeof(T), alignof(T)>::Get().Free(ptr);
+    }
+
+    template<typename U>
+    bool operator==(const OFS_EventAllocator<U>&) const noexcept { return true; }
+    template<typename U>
+    bool operator!=(const OFS_EventAllocator<U>&) const noexcept { return false; }
+};
+
+// Bounded multi producer single consumer queue.
+// Any thread may push, only the main thread drains.
+// When the ring is full events spill into a locked vector,
+// producers keep using it until it got drained so the order per producer is preserved.
+class OFS_EventRing
+{
+    public:
+    static constexpr uint32_t Capacity = 4096;
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+    private:
+    static constexpr uint32_t Mask = Capacity - 1;
+
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;
+        EventPointer event;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<uint32_t> tail = 0;
+    alignas(64) uint32_t head = 0;
+
+    SDL_SpinLock overflowLock = {0};
+    std::atomic<bool> overflowing = false;
+    std::vector<EventPointer> overflow;
+    std::vector<EventPointer> overflowDrain;
+
+    void pushOverflow(EventPointer&& ev) noexcept;
+
+    public:
+    OFS_EventRing() noexcept;
+
+    void Push(EventPointer&& ev) noexcept;
+
+    // Only dispatches what was pushed before the call.
+    // Events pushed by handlers are left for the next drain.
+    template<typename DispatchFn>
+    void Drain(DispatchFn&& dispatch) noexcept
+    {
+        const uint32_t end = tail.load(std::memory_order_acquire);
+        while (head != end) {
+            Slot& slot = slots[head & Mask];
+            // a producer claimed the slot but isn't done writing yet
+            if (slot.sequence.load(std::memory_order_acquire) != head + 1) break;
+            EventPointer ev = std::move(slot.event);
+            slot.sequence.store(head + Capacity, std::memory_order_release);
+            head += 1;
+            dispatch(ev);
+        }
+
+        if (!overflowing.load(std::memory_order_acquire)) return;
+        // everything in the overflow was pushed after the ring entries of the same producer,
+        // it has to wait while any of them are still pending. once overflowing is set
+        // the ring doesn't get new entries so this can't be postponed forever.
+        if (head != tail.load(std::memory_order_acquire)) return;
+        SDL_AtomicLock(&overflowLock);
+        overflowDrain.swap(overflow);
+        overflowing.store(false, std::memory_order_release);
+        SDL_AtomicUnlock(&overflowLock);
+        for (auto& ev : overflowDrain) {
+            dispatch(ev);
+        }
+        overflowDrain.clear();
+    }
+};
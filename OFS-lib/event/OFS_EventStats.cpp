@@ -0,0 +1,329 @@
+#include "OFS_EventStats.h"
+#include "OFS_Util.h"
+#include "OFS_Localization.h"
+
+#include "SDL_events.h"
+#include "SDL_timer.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <vector>
+#include <cctype>
+#include <cfloat>
+#include <cstring>
+
+static float TicksToUs(uint64_t ticks) noexcept
+{
+    static const double UsPerTick = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+    return (float)(ticks * UsPerTick);
+}
+
+void OFS_ListenerStats::Record(uint64_t ticks) noexcept
+{
+    calls.fetch_add(1, std::memory_order_relaxed);
+    totalTicks.fetch_add(ticks, std::memory_order_relaxed);
+    uint64_t max = maxTicks.load(std::memory_order_relaxed);
+    while (ticks > max && !maxTicks.compare_exchange_weak(max, ticks, std::memory_order_relaxed)) {}
+
+    uint32_t us = (uint32_t)TicksToUs(ticks);
+    int32_t bucket = 0;
+    while (us != 0 && bucket < HistogramBuckets - 1) {
+        us >>= 1;
+        bucket += 1;
+    }
+    histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+float OFS_ListenerStats::PercentileUs(float percentile) const noexcept
+{
+    uint64_t total = calls.load(std::memory_order_relaxed);
+    if (total == 0) return 0.f;
+    uint64_t target = (uint64_t)(total * percentile);
+    uint64_t count = 0;
+    for (int32_t i = 0; i < HistogramBuckets; i += 1) {
+        count += histogram[i].load(std::memory_order_relaxed);
+        if (count > target) return (float)(1u << i);
+    }
+    return (float)(1u << (HistogramBuckets - 1));
+}
+
+OFS_EventStats& OFS_EventStats::Get() noexcept
+{
+    // used during static initialization and must outlive every event
+    static OFS_EventStats* stats = new OFS_EventStats();
+    return *stats;
+}
+
+void OFS_EventStats::RegisterType(const char* typeName, OFS_EventCoalescing coalescing) noexcept
+{
+    // strip what the compiler adds to the name "15TimeChangeEvent" or "class TimeChangeEvent"
+    while (std::isdigit((unsigned char)*typeName)) typeName += 1;
+    if (strncmp(typeName, "class ", 6) == 0) typeName += 6;
+    else if (strncmp(typeName, "struct ", 7) == 0) typeName += 7;
+
+    auto& stats = types.emplace_back();
+    stats.name = typeName;
+    stats.coalescing = coalescing;
+}
+
+OFS_EventTypeStats* OFS_EventStats::Type(OFS_EventType type) noexcept
+{
+    uint32_t index = type - SDL_USEREVENT - 1;
+    return index < types.size() ? &types[index] : nullptr;
+}
+
+OFS_ListenerStats* OFS_EventStats::AddListener(OFS_EventType type, const char* file, int line) noexcept
+{
+    const char* fileName = file;
+    for (const char* c = file; *c; c += 1) {
+        if (*c == '/' || *c == '\\') fileName = c + 1;
+    }
+    char location[128];
+    stbsp_snprintf(location, sizeof(location), "%s:%d", fileName, line);
+
+    SDL_AtomicLock(&listenersLock);
+    auto it = std::find_if(listeners.begin(), listeners.end(),
+        [type, &location](auto& stats) noexcept { return stats.type == type && stats.location == location; });
+    OFS_ListenerStats* result;
+    if (it != listeners.end()) {
+        result = &*it;
+    }
+    else {
+        result = &listeners.emplace_back();
+        result->type = type;
+        result->location = location;
+    }
+    SDL_AtomicUnlock(&listenersLock);
+    return result;
+}
+
+void OFS_EventStats::Drained(uint32_t depth) noexcept
+{
+    lastDepth = depth;
+    maxDepth = std::max(maxDepth, depth);
+    for (auto& stats : types) {
+        stats.lastDepth = stats.drained;
+        stats.maxDepth = std::max(stats.maxDepth, stats.drained);
+        stats.drained = 0;
+    }
+
+    const uint64_t now = SDL_GetPerformanceCounter();
+    const uint64_t freq = SDL_GetPerformanceFrequency();
+    if (rateTimer == 0) {
+        rateTimer = now;
+    }
+    else if (now - rateTimer >= freq) {
+        float elapsed = (float)((double)(now - rateTimer) / (double)freq);
+        for (auto& stats : types) {
+            uint64_t enqueued = stats.enqueued.load(std::memory_order_relaxed);
+            stats.enqueueRate = (enqueued - stats.rateEnqueued) / elapsed;
+            stats.rateEnqueued = enqueued;
+        }
+        rateTimer = now;
+    }
+}
+
+void OFS_EventStats::Reset() noexcept
+{
+    lastDepth = 0;
+    maxDepth = 0;
+    rateTimer = 0;
+    for (auto& stats : types) {
+        stats.enqueued = 0;
+        stats.dispatched = 0;
+        stats.coalesced = 0;
+        stats.lastDepth = 0;
+        stats.maxDepth = 0;
+        stats.enqueueRate = 0.f;
+        stats.rateEnqueued = 0;
+    }
+    SDL_AtomicLock(&listenersLock);
+    for (auto& stats : listeners) {
+        stats.calls = 0;
+        stats.totalTicks = 0;
+        stats.maxTicks = 0;
+        for (auto& bucket : stats.histogram) bucket = 0;
+    }
+    SDL_AtomicUnlock(&listenersLock);
+}
+
+static const char* CoalescingName(OFS_EventCoalescing coalescing) noexcept
+{
+    switch (coalescing) {
+        case OFS_EventCoalescing::LatestWins: return "latest_wins";
+        case OFS_EventCoalescing::Merge: return "merge";
+        default: return "always_deliver";
+    }
+}
+
+std::string OFS_EventStats::Dump() noexcept
+{
+    nlohmann::json json;
+    json["queueDepth"] = lastDepth;
+    json["maxQueueDepth"] = maxDepth;
+
+    auto& typesJson = json["types"] = nlohmann::json::array();
+    for (auto& stats : types) {
+        if (stats.enqueued == 0 && stats.dispatched == 0) continue;
+        typesJson.push_back({
+            { "name", stats.name },
+            { "coalescing", CoalescingName(stats.coalescing) },
+            { "enqueued", stats.enqueued.load(std::memory_order_relaxed) },
+            { "enqueueRate", stats.enqueueRate },
+            { "dispatched", stats.dispatched },
+            { "coalesced", stats.coalesced },
+            { "queueDepth", stats.lastDepth },
+            { "maxQueueDepth", stats.maxDepth }
+        });
+    }
+
+    auto& listenersJson = json["listeners"] = nlohmann::json::array();
+    SDL_AtomicLock(&listenersLock);
+    for (auto& stats : listeners) {
+        uint64_t calls = stats.calls.load(std::memory_order_relaxed);
+        if (calls == 0) continue;
+        auto typeStats = Type(stats.type);
+        auto histogram = nlohmann::json::array();
+        for (auto& bucket : stats.histogram) histogram.push_back(bucket.load(std::memory_order_relaxed));
+        listenersJson.push_back({
+            { "event", typeStats ? typeStats->name : std::string("SDL_Event") },
+            { "location", stats.location },
+            { "calls", calls },
+            { "totalUs", TicksToUs(stats.totalTicks.load(std::memory_order_relaxed)) },
+            { "maxUs", TicksToUs(stats.maxTicks.load(std::memory_order_relaxed)) },
+            { "p50Us", stats.PercentileUs(0.5f) },
+            { "p99Us", stats.PercentileUs(0.99f) },
+            { "histogramLog2Us", std::move(histogram) }
+        });
+    }
+    SDL_AtomicUnlock(&listenersLock);
+    return Util::SerializeJson(json, true);
+}
+
+void OFS_EventStats::ShowWindow(bool* open) noexcept
+{
+    if (!*open) return;
+    ImGui::Begin(TR_ID("EventStatistics", Tr::EVENT_STATISTICS), open);
+
+    ImGui::Text("%s: %u (%s %u)", TR(QUEUE_DEPTH), lastDepth, TR(MAXIMUM), maxDepth);
+    if (ImGui::Button(TR(RESET))) {
+        Reset();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button(TR(SAVE))) {
+        auto path = Util::Prefpath("event_statistics.json");
+        auto json = Dump();
+        if (Util::WriteFile(path.c_str(), json.data(), json.size()) == json.size()) {
+            LOGF_INFO("Wrote event statistics to \"%s\"", path.c_str());
+        }
+    }
+
+    if (ImGui::CollapsingHeader(TR(EVENTS), ImGuiTreeNodeFlags_DefaultOpen)
+        && ImGui::BeginTable("##eventTypes", 6, ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | ImGuiTableFlags_Sortable)) {
+        ImGui::TableSetupColumn(TR(EVENT));
+        ImGui::TableSetupColumn(TR(ENQUEUED));
+        ImGui::TableSetupColumn(TR(PER_SECOND), ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+        ImGui::TableSetupColumn(TR(COALESCED));
+        ImGui::TableSetupColumn(TR(QUEUE_DEPTH));
+        ImGui::TableSetupColumn(TR(MAXIMUM));
+        ImGui::TableHeadersRow();
+
+        std::vector<OFS_EventTypeStats*> sorted;
+        for (auto& stats : types) {
+            if (stats.enqueued > 0) sorted.emplace_back(&stats);
+        }
+        auto sortSpecs = ImGui::TableGetSortSpecs();
+        if (sortSpecs && sortSpecs->SpecsCount > 0) {
+            auto& spec = sortSpecs->Specs[0];
+            auto key = [column = spec.ColumnIndex](const OFS_EventTypeStats* s) noexcept -> double {
+                switch (column) {
+                    case 1: return (double)s->enqueued.load(std::memory_order_relaxed);
+                    case 2: return s->enqueueRate;
+                    case 3: return (double)s->coalesced;
+                    case 4: return s->lastDepth;
+                    case 5: return s->maxDepth;
+                    default: return 0.0;
+                }
+            };
+            std::sort(sorted.begin(), sorted.end(), [&](auto a, auto b) noexcept {
+                if (spec.ColumnIndex == 0) {
+                    return spec.SortDirection == ImGuiSortDirection_Ascending ? a->name < b->name : a->name > b->name;
+                }
+                return spec.SortDirection == ImGuiSortDirection_Ascending ? key(a) < key(b) : key(a) > key(b);
+            });
+        }
+
+        for (auto stats : sorted) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stats->name.c_str());
+            if (ImGui::IsItemHovered()) ImGui::SetTooltip("%s", CoalescingName(stats->coalescing));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)stats->enqueued.load(std::memory_order_relaxed));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", stats->enqueueRate);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)stats->coalesced);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", stats->lastDepth);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", stats->maxDepth);
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::CollapsingHeader(TR(LISTENERS), ImGuiTreeNodeFlags_DefaultOpen)
+        && ImGui::BeginTable("##eventListeners", 7, ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn(TR(EVENT));
+        ImGui::TableSetupColumn(TR(LOCATION));
+        ImGui::TableSetupColumn(TR(CALLS));
+        ImGui::TableSetupColumn(TR(TOTAL_MS));
+        ImGui::TableSetupColumn(TR(P50_US));
+        ImGui::TableSetupColumn(TR(P99_US));
+        ImGui::TableSetupColumn(TR(MAX_US));
+        ImGui::TableHeadersRow();
+
+        // slowest listeners first
+        std::vector<OFS_ListenerStats*> sorted;
+        SDL_AtomicLock(&listenersLock);
+        for (auto& stats : listeners) {
+            if (stats.calls > 0) sorted.emplace_back(&stats);
+        }
+        SDL_AtomicUnlock(&listenersLock);
+        std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) noexcept { return a->totalTicks > b->totalTicks; });
+
+        for (auto stats : sorted) {
+            auto typeStats = Type(stats->type);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (typeStats) ImGui::TextUnformatted(typeStats->name.c_str());
+            else ImGui::Text("SDL_Event 0x%x", stats->type);
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stats->location.c_str());
+            if (ImGui::IsItemHovered()) {
+                ImGui::BeginTooltip();
+                float values[OFS_ListenerStats::HistogramBuckets];
+                for (int32_t i = 0; i < OFS_ListenerStats::HistogramBuckets; i += 1) {
+                    values[i] = (float)stats->histogram[i].load(std::memory_order_relaxed);
+                }
+                ImGui::PlotHistogram("##histogram", values, OFS_ListenerStats::HistogramBuckets, 0,
+                    "log2(us)", 0.f, FLT_MAX, ImVec2(300.f, 80.f));
+                ImGui::EndTooltip();
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", (unsigned long long)stats->calls.load(std::memory_order_relaxed));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", TicksToUs(stats->totalTicks.load(std::memory_order_relaxed)) / 1000.f);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f", stats->PercentileUs(0.5f));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f", stats->PercentileUs(0.99f));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", TicksToUs(stats->maxTicks.load(std::memory_order_relaxed)));
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "OFS_Event.h"
+
+#include "SDL_atomic.h"
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// Dispatch timings of a single listener.
+// Listeners appended from the same source line share their statistics.
+struct OFS_ListenerStats
+{
+    // bucket i counts dispatches which took less than 2^i microseconds
+    static constexpr int32_t HistogramBuckets = 20;
+
+    OFS_EventType type = BaseEvent::InvalidType;
+    std::string location;
+
+    // listeners may be dispatched on other threads through directDispatch
+    std::atomic<uint64_t> calls = 0;
+    std::atomic<uint64_t> totalTicks = 0;
+    std::atomic<uint64_t> maxTicks = 0;
+    std::array<std::atomic<uint32_t>, HistogramBuckets> histogram = {};
+
+    void Record(uint64_t ticks) noexcept;
+    // upper bound of the histogram bucket containing the percentile
+    float PercentileUs(float percentile) const noexcept;
+};
+
+struct OFS_EventTypeStats
+{
+    std::string name;
+    OFS_EventCoalescing coalescing = OFS_EventCoalescing::AlwaysDeliver;
+
+    std::atomic<uint64_t> enqueued = 0;
+    // main thread only
+    uint64_t dispatched = 0;
+    uint64_t coalesced = 0;
+    // counted while draining the queue
+    uint32_t drained = 0;
+    uint32_t lastDepth = 0;
+    uint32_t maxDepth = 0;
+    float enqueueRate = 0.f;
+    uint64_t rateEnqueued = 0;
+};
+
+// Counters for every event type and listener so slow listeners can be found without a profiler.
+class OFS_EventStats
+{
+    private:
+    // indexed by event type, see EV::RegisterEvent
+    std::deque<OFS_EventTypeStats> types;
+    std::deque<OFS_ListenerStats> listeners;
+    SDL_SpinLock listenersLock = {0};
+
+    uint32_t lastDepth = 0;
+    uint32_t maxDepth = 0;
+    uint64_t rateTimer = 0;
+
+    public:
+    static OFS_EventStats& Get() noexcept;
+
+    // called during static initialization
+    void RegisterType(const char* typeName, OFS_EventCoalescing coalescing) noexcept;
+    OFS_ListenerStats* AddListener(OFS_EventType type, const char* file, int line) noexcept;
+
+    OFS_EventTypeStats* Type(OFS_EventType type) noexcept;
+    inline void CountEnqueue(OFS_EventType type) noexcept
+    {
+        if (auto stats = Type(type)) stats->enqueued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Main thread only. Called once per EV::Process with the number of queued events.
+    void Drained(uint32_t depth) noexcept;
+    void Reset() noexcept;
+
+    void ShowWindow(bool* open) noexcept;
+    std::string Dump() noexcept;
+};
@@ -1,7 +1,11 @@
 #include "OFS_EventSystem.h"
 
+#include "OFS_Profiling.h"
+
 #include "SDL_events.h"
 
+#include <algorithm>
+
 EV* EV::instance = nullptr;
 
 // In order to not collide with SDL_Event types the counter starts at SDL_USEREVENT
@@ -12,6 +16,67 @@ static void deferHandler(const OFS_DeferEvent* ev) noexcept
     ev->Function();
 }
 
+OFS_EventType EV::RegisterEvent(OFS_EventCoalescing coalescing, const char* typeName) noexcept
+{
+    // the statistics double as the registry of event types
+    OFS_EventStats::Get().RegisterType(typeName, coalescing);
+    return ++eventCounter;
+}
+
+OFS_EventCoalescing EV::CoalescingOf(OFS_EventType type) noexcept
+{
+    auto stats = OFS_EventStats::Get().Type(type);
+    return stats ? stats->coalescing : OFS_EventCoalescing::AlwaysDeliver;
+}
+
+void EV::coalesce() noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    // walk backwards so the last instance of each type and key is the one retained
+    coalesceEntries.clear();
+    for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+        auto& ev = *it;
+        auto type = ev->Type();
+        auto policy = CoalescingOf(type);
+        if (policy == OFS_EventCoalescing::AlwaysDeliver) continue;
+
+        uint64_t key = ev->CoalesceKey();
+        auto entry = std::find_if(coalesceEntries.begin(), coalesceEntries.end(),
+            [type, key](auto& e) noexcept { return e.type == type && e.key == key; });
+        if (entry == coalesceEntries.end()) {
+            coalesceEntries.emplace_back(CoalesceEntry{ type, key, ev.get() });
+            continue;
+        }
+        if (policy == OFS_EventCoalescing::Merge) {
+            entry->retained->Merge(*ev);
+        }
+        OFS_EventStats::Get().Type(type)->coalesced += 1;
+        ev.reset();
+    }
+}
+
+void EV::process() noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    auto& stats = OFS_EventStats::Get();
+    ring.Drain([this, &stats](EventPointer& ev) noexcept
+    {
+        if (auto typeStats = stats.Type(ev->Type())) typeStats->drained += 1;
+        batch.emplace_back(std::move(ev));
+    });
+    stats.Drained(batch.size());
+    if (batch.empty()) return;
+
+    coalesce();
+    for (auto& ev : batch) {
+        if (!ev) continue;
+        auto typeStats = stats.Type(ev->Type());
+        if (typeStats) typeStats->dispatched += 1;
+        queue.dispatch(ev);
+    }
+    batch.clear();
+}
+
 bool EV::Init() noexcept
 {
     if(!EV::instance)
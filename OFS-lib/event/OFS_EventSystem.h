@@ -1,7 +1,12 @@
 #pragma once
 
 #include "OFS_Event.h"
+#include "OFS_EventQueue.h"
+#include "OFS_EventStats.h"
 #include "eventpp/eventqueue.h"
+
+#include "SDL_timer.h"
+
 #include <vector>
 
 struct OFS_EventPolicy
@@ -12,18 +17,77 @@ struct OFS_EventPolicy
     }
 };
 
+// Listener registry which records the dispatch time of every listener.
+// Only the listener registry and dispatching of eventpp is used, queued events go through the ring.
+class OFS_EventListeners
+{
+    public:
+    using Dispatcher = eventpp::EventQueue<OFS_EventType, void(const EventPointer&), OFS_EventPolicy>;
+    using Handle = Dispatcher::Handle;
+
+    private:
+    Dispatcher dispatcher;
+
+    public:
+    // file and line identify the listener in the event statistics
+    template<typename Callback>
+    Handle appendListener(OFS_EventType type, Callback&& callback,
+        const char* file = __builtin_FILE(), int line = __builtin_LINE()) noexcept
+    {
+        auto stats = OFS_EventStats::Get().AddListener(type, file, line);
+        return dispatcher.appendListener(type,
+            [callback = std::forward<Callback>(callback), stats](const EventPointer& ev) noexcept
+            {
+                uint64_t start = SDL_GetPerformanceCounter();
+                callback(ev);
+                stats->Record(SDL_GetPerformanceCounter() - start);
+            });
+    }
+
+    inline bool removeListener(OFS_EventType type, const Handle& handle) noexcept
+    {
+        return dispatcher.removeListener(type, handle);
+    }
+
+    inline void directDispatch(OFS_EventType type, const EventPointer& ev) noexcept
+    {
+        dispatcher.directDispatch(type, ev);
+    }
+
+    inline void dispatch(const EventPointer& ev) noexcept
+    {
+        dispatcher.dispatch(ev);
+    }
+};
+
 class EV
 {
     private:
     static EV* instance;
     static uint32_t eventCounter;
-    eventpp::EventQueue<OFS_EventType, void(const EventPointer&), OFS_EventPolicy> queue;
-    inline bool process() noexcept { return queue.process(); }
+    OFS_EventListeners queue;
+    OFS_EventRing ring;
+
+    struct CoalesceEntry
+    {
+        OFS_EventType type;
+        uint64_t key;
+        BaseEvent* retained;
+    };
+    std::vector<EventPointer> batch;
+    std::vector<CoalesceEntry> coalesceEntries;
+
+    void coalesce() noexcept;
+    void process() noexcept;
     public:
 
     static bool Init() noexcept;
     inline static void Process() noexcept { Get()->process(); }
-    inline static OFS_EventType RegisterEvent() noexcept { return ++eventCounter; }
+    static OFS_EventType RegisterEvent(OFS_EventCoalescing coalescing, const char* typeName) noexcept;
+    static OFS_EventCoalescing CoalescingOf(OFS_EventType type) noexcept;
+
+    inline static void ShowStatsWindow(bool* open) noexcept { OFS_EventStats::Get().ShowWindow(open); }
+    inline static std::string DumpStats() noexcept { return OFS_EventStats::Get().Dump(); }
 
     inline static EV* Get() noexcept { return instance; }
    
@@ -42,24 +106,26 @@ class EV
     inline static EventPointer Make(Args&&... args) noexcept
     {
         return std::static_pointer_cast<BaseEvent>(
-            std::make_shared<Event>(std::forward<Args>(args)...)
+            MakeTyped<Event>(std::forward<Args>(args)...)
         );
     }
 
     template<typename Event, typename... Args>
     inline static auto MakeTyped(Args&&... args) noexcept
     {
-        return std::make_shared<Event>(std::forward<Args>(args)...);
+        return std::allocate_shared<Event>(OFS_EventAllocator<Event>(), std::forward<Args>(args)...);
     }
 
     template<typename Event, typename... Args>
     inline static void Enqueue(Args&&... args) noexcept
     {
-        Queue().enqueue(Make<Event>(std::forward<Args>(args)...));
+        OFS_EventStats::Get().CountEnqueue(Event::EventType);
+        Get()->ring.Push(Make<Event>(std::forward<Args>(args)...));
     }
     inline static void Enqueue(EventPointer ev) noexcept
     {
-        Queue().enqueue(ev);
+        OFS_EventStats::Get().CountEnqueue(ev->Type());
+        Get()->ring.Push(std::move(ev));
     }
 };
 
@@ -2,6 +2,14 @@
 
 #include "OFS_StateHandle.h"
 
+// ATTENTION: no reordering
+enum class BaseOverlayLineMode : int32_t
+{
+    Square,
+    Linear,
+    Spline
+};
+
 struct BaseOverlayState
 {
     static constexpr auto StateName = "BaseOverlayState";
@@ -10,7 +18,9 @@ struct BaseOverlayState
     float MaxSpeedPerSecond = 400.f;
     bool ShowMaxSpeedHighlight = false;
     bool SyncLineEnable = false;
-    bool SplineMode = false;
+    BaseOverlayLineMode LineMode = BaseOverlayLineMode::Square;
+
+    inline bool SplineMode() const noexcept { return LineMode == BaseOverlayLineMode::Spline; }
 
     inline static uint32_t RegisterStatic() noexcept
     {
@@ -28,5 +38,5 @@ REFL_TYPE(BaseOverlayState)
     REFL_FIELD(MaxSpeedPerSecond)
     REFL_FIELD(ShowMaxSpeedHighlight)
     REFL_FIELD(SyncLineEnable)
-    REFL_FIELD(SplineMode)
+    REFL_FIELD(LineMode, serializeEnum{})
 REFL_END
\ No newline at end of file
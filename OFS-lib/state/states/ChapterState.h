@@ -68,6 +68,7 @@ REFL_END
 class ChapterStateChanged : public OFS_Event<ChapterStateChanged>
 {
     public:
+    static constexpr OFS_EventCoalescing Coalescing = OFS_EventCoalescing::LatestWins;
     ChapterStateChanged() noexcept {}
 };
 
@@ -0,0 +1,208 @@
+#include "OFS_VideoIndex.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+
+#include "SDL_thread.h"
+
+#include "subprocess.h"
+
+#include <atomic>
+#include <array>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+struct OFS_VideoIndex::Job
+{
+    std::string videoPath;
+    // immutable once ready is set
+    std::vector<float> frames;
+    std::vector<float> keyframes;
+
+    std::atomic<bool> cancel = false;
+    std::atomic<bool> ready = false;
+};
+
+// times slightly before a timestamp already count as that frame,
+// this absorbs rounding in the times reported by the player
+constexpr float FrameTolerance = 0.0005f;
+
+static void parseFramecrcLine(const char* line, int64_t& tbNum, int64_t& tbDen,
+    std::vector<int64_t>& pts, std::vector<int64_t>& keyPts) noexcept
+{
+    // header: "#tb 0: 1/90000"
+    // packet: "0,  -2002,  0,  1001,  41234, 0x12345678" non-keyframes end with ", F=0x0"
+    if (line[0] == '#') {
+        int64_t num, den;
+        if (sscanf(line, "#tb 0: %" SCNd64 "/%" SCNd64, &num, &den) == 2 && num > 0 && den > 0) {
+            tbNum = num;
+            tbDen = den;
+        }
+        return;
+    }
+
+    int stream;
+    int64_t dts, ptsValue;
+    if (sscanf(line, "%d, %" SCNd64 ", %" SCNd64, &stream, &dts, &ptsValue) != 3 || stream != 0) return;
+    if (ptsValue == INT64_MIN) return;
+
+    pts.emplace_back(ptsValue);
+    const char* flags = strstr(line, "F=0x");
+    bool keyframe = flags ? (strtol(flags + 4, nullptr, 16) & 1) != 0 : true;
+    if (keyframe) keyPts.emplace_back(ptsValue);
+}
+
+static int IndexThread(void* data) noexcept
+{
+    auto jobPtr = (std::shared_ptr<OFS_VideoIndex::Job>*)data;
+    auto job = std::move(*jobPtr);
+    delete jobPtr;
+
+    OFS_PROFILE(__FUNCTION__);
+    auto ffmpegPath = Util::FfmpegPath().u8string();
+    // framecrc only demuxes and prints one line per packet
+    std::array<const char*, 14> args =
+    {
+        ffmpegPath.c_str(),
+        "-loglevel", "quiet",
+        "-nostdin",
+        "-i", job->videoPath.c_str(),
+        "-map", "0:v:0",
+        "-c", "copy",
+        "-f", "framecrc",
+        "-",
+        nullptr
+    };
+
+    struct subprocess_s proc;
+    if (subprocess_create(args.data(), subprocess_option_no_window | subprocess_option_enable_async, &proc) != 0) {
+        LOG_WARN("Failed to start ffmpeg for building the video index.");
+        return 0;
+    }
+
+    int64_t tbNum = 1, tbDen = 1;
+    std::vector<int64_t> pts, keyPts;
+    std::string line;
+    std::array<char, 4096> buffer;
+    while (!job->cancel) {
+        uint32_t read = subprocess_read_stdout(&proc, buffer.data(), buffer.size());
+        if (read == 0) break;
+        for (uint32_t i = 0; i < read; i += 1) {
+            char c = buffer[i];
+            if (c == '\n') {
+                parseFramecrcLine(line.c_str(), tbNum, tbDen, pts, keyPts);
+                line.clear();
+            }
+            else if (c != '\r') {
+                line.push_back(c);
+            }
+        }
+    }
+
+    if (subprocess_alive(&proc)) {
+        subprocess_terminate(&proc);
+    }
+    int returnCode = 0;
+    subprocess_join(&proc, &returnCode);
+    subprocess_destroy(&proc);
+
+    if (job->cancel || returnCode != 0 || pts.empty()) {
+        return 0;
+    }
+
+    // packets are in decoding order
+    std::sort(pts.begin(), pts.end());
+    std::sort(keyPts.begin(), keyPts.end());
+
+    // the player reports times relative to the first frame
+    const int64_t startPts = pts.front();
+    const double timebase = (double)tbNum / (double)tbDen;
+    auto toSeconds = [startPts, timebase](int64_t value) noexcept { return (float)((value - startPts) * timebase); };
+
+    job->frames.reserve(pts.size());
+    for (auto value : pts) job->frames.emplace_back(toSeconds(value));
+    job->keyframes.reserve(keyPts.size());
+    for (auto value : keyPts) job->keyframes.emplace_back(toSeconds(value));
+
+    LOGF_INFO("Video index: %d frames, %d keyframes", (int)job->frames.size(), (int)job->keyframes.size());
+    job->ready = true;
+    return 0;
+}
+
+OFS_VideoIndex::~OFS_VideoIndex() noexcept
+{
+    Clear();
+}
+
+void OFS_VideoIndex::Build(const std::string& videoPath) noexcept
+{
+    if (job && job->videoPath == videoPath) return;
+    Clear();
+    if (videoPath.empty()) return;
+
+    job = std::make_shared<Job>();
+    job->videoPath = videoPath;
+    auto threadData = new std::shared_ptr<Job>(job);
+    auto handle = SDL_CreateThread(IndexThread, "OFS_VideoIndex", threadData);
+    if (!handle) {
+        delete threadData;
+        return;
+    }
+    SDL_DetachThread(handle);
+}
+
+void OFS_VideoIndex::Clear() noexcept
+{
+    if (job) {
+        job->cancel = true;
+        job.reset();
+    }
+}
+
+bool OFS_VideoIndex::Ready() const noexcept
+{
+    return job && job->ready;
+}
+
+int64_t OFS_VideoIndex::FrameCount() const noexcept
+{
+    return Ready() ? (int64_t)job->frames.size() : -1;
+}
+
+float OFS_VideoIndex::FrameTimeAt(int64_t frameIndex) const noexcept
+{
+    if (!Ready() || frameIndex < 0 || frameIndex >= (int64_t)job->frames.size()) return -1.f;
+    return job->frames[frameIndex];
+}
+
+int64_t OFS_VideoIndex::FrameIndex(float time) const noexcept
+{
+    if (!Ready()) return -1;
+    auto& frames = job->frames;
+    auto it = std::upper_bound(frames.begin(), frames.end(), time + FrameTolerance);
+    if (it == frames.begin()) return 0;
+    return std::distance(frames.begin(), it) - 1;
+}
+
+float OFS_VideoIndex::NextFrameTime(float time) const noexcept
+{
+    int64_t idx = FrameIndex(time);
+    return idx < 0 ? -1.f : FrameTimeAt(idx + 1);
+}
+
+float OFS_VideoIndex::PreviousFrameTime(float time) const noexcept
+{
+    int64_t idx = FrameIndex(time);
+    return idx < 0 ? -1.f : FrameTimeAt(idx - 1);
+}
+
+float OFS_VideoIndex::ClosestKeyframe(float time) const noexcept
+{
+    if (!Ready() || job->keyframes.empty()) return -1.f;
+    auto& keyframes = job->keyframes;
+    auto it = std::lower_bound(keyframes.begin(), keyframes.end(), time);
+    if (it == keyframes.end()) return keyframes.back();
+    if (it == keyframes.begin()) return *it;
+    auto prev = it - 1;
+    return (time - *prev) <= (*it - time) ? *prev : *it;
+}
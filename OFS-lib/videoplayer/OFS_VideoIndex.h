@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+// Presentation timestamps of every video frame and the keyframes among them.
+// The index gets built in the background by demuxing the file with ffmpeg,
+// nothing is decoded so even long videos only take a few seconds.
+class OFS_VideoIndex
+{
+    public:
+    struct Job;
+
+    private:
+    std::shared_ptr<Job> job;
+
+    public:
+    ~OFS_VideoIndex() noexcept;
+
+    void Build(const std::string& videoPath) noexcept;
+    void Clear() noexcept;
+
+    // All queries return a negative value when the index isn't ready or there's no result.
+    bool Ready() const noexcept;
+    float FrameTimeAt(int64_t frameIndex) const noexcept;
+    // The frame which is displayed at this time
+    int64_t FrameIndex(float time) const noexcept;
+    float NextFrameTime(float time) const noexcept;
+    float PreviousFrameTime(float time) const noexcept;
+    float ClosestKeyframe(float time) const noexcept;
+    int64_t FrameCount() const noexcept;
+};
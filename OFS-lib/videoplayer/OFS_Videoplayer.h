@@ -5,6 +5,14 @@
 
 #include "OFS_VideoplayerEvents.h"
 
+enum class VideoplayerSeekMode : uint8_t
+{
+    // decode up to the requested time
+    Exact,
+    // land on the closest keyframe which is much cheaper to decode
+    Keyframe
+};
+
 class OFS_Videoplayer
 {
     private:
@@ -12,11 +20,16 @@ class OFS_Videoplayer
     void* ctx = nullptr;
     // A OpenGL 2D_TEXTURE expected to contain the current video frame.
     uint32_t frameTexture = 0;
+    // Set while a frame from the frame buffer is shown instead of the decoder output.
+    uint32_t bufferedFrameTexture = 0;
     // The position which was last requested via any of the seeking functions.
     float logicalPosition = 0.f;
     // Helper for Mute/Unmute
     float lastVolume = 0.f;
     VideoplayerType playerType;
+    VideoplayerSeekMode seekMode = VideoplayerSeekMode::Exact;
+
+    void seekToTime(double timeSeconds, bool exact) noexcept;
     
     public:
     OFS_Videoplayer(VideoplayerType playerType) noexcept;
@@ -30,12 +43,17 @@ class OFS_Videoplayer
     void SetSpeed(float speed) noexcept;
 	void AddSpeed(float speed) noexcept;
     void SetVolume(float volume) noexcept;
+    // Memory used for recently rendered frames which makes frame stepping within them instant.
+    void SetFrameBufferMemory(uint32_t megabytes) noexcept;
     
     // All seeking functions must update logicalPosition
     void SetPositionExact(float timeSeconds, bool pausesVideo = false) noexcept;
     void SetPositionPercent(float percentPos, bool pausesVideo = false) noexcept;
     void SeekRelative(float timeSeconds) noexcept;
     void SeekFrames(int32_t offset) noexcept;
+    // Used by SetPositionPercent and SeekRelative. SetPositionExact and frame stepping are always exact.
+    inline void SetSeekMode(VideoplayerSeekMode mode) noexcept { seekMode = mode; }
+    inline VideoplayerSeekMode SeekMode() const noexcept { return seekMode; }
 
     void SetPaused(bool paused) noexcept;
     void TogglePlay() noexcept { SetPaused(!IsPaused()); }
@@ -76,5 +94,5 @@ class OFS_Videoplayer
     double CurrentPlayerTime() const noexcept { return CurrentPlayerPosition() * Duration(); }
 
     const char* VideoPath() const noexcept;
-    inline uint32_t FrameTexture() const noexcept { return frameTexture; }
+    inline uint32_t FrameTexture() const noexcept { return bufferedFrameTexture ? bufferedFrameTexture : frameTexture; }
 };
\ No newline at end of file
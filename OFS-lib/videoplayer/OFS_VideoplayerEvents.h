@@ -34,10 +34,13 @@ class PlayPauseChangeEvent : public OFS_Event<PlayPauseChangeEvent>
 class TimeChangeEvent : public OFS_Event<TimeChangeEvent>
 {
 	public:
+	static constexpr OFS_EventCoalescing Coalescing = OFS_EventCoalescing::LatestWins;
 	float time;
 	VideoplayerType playerType;
 	TimeChangeEvent(float time, VideoplayerType type) noexcept
 		: playerType(type), time(time) {} 
+
+	uint64_t CoalesceKey() const noexcept override { return (uint64_t)playerType; }
 };
 
 class DurationChangeEvent : public OFS_Event<DurationChangeEvent>
@@ -52,9 +55,12 @@ class DurationChangeEvent : public OFS_Event<DurationChangeEvent>
 class PlaybackSpeedChangeEvent : public OFS_Event<PlaybackSpeedChangeEvent>
 {
 	public:
+	static constexpr OFS_EventCoalescing Coalescing = OFS_EventCoalescing::LatestWins;
 	float playbackSpeed;
 	VideoplayerType playerType;
 	PlaybackSpeedChangeEvent(float speed, VideoplayerType type) noexcept
 		: playerType(type), playbackSpeed(speed) {}
 
+	uint64_t CoalesceKey() const noexcept override { return (uint64_t)playerType; }
+
 };
\ No newline at end of file
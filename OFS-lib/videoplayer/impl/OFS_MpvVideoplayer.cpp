@@ -1,4 +1,5 @@
 #include "OFS_Videoplayer.h"
+#include "OFS_VideoIndex.h"
 #include "OFS_Util.h"
 
 #include "OFS_EventSystem.h"
@@ -26,6 +27,7 @@ enum MpvPropertyGet : uint64_t {
     MpvFilePath,
     MpvHwDecoder,
     MpvFramesPerSecond,
+    MpvTimePos,
 };
 
 struct MpvDataCache {
@@ -49,6 +51,88 @@ struct MpvDataCache {
     std::string filePath = "";
 };
 
+// Recently rendered frames, keyed by their index in OFS_VideoIndex.
+// Frames get captured while playing as well, so after pausing the frames
+// right before the pause position are already buffered.
+// Stepping to any of these frames just displays the stored texture.
+struct FrameRingBuffer
+{
+    static constexpr int32_t MaxFrames = 120;
+
+    struct Entry
+    {
+        int64_t frame = -1;
+        uint32_t texture = 0;
+    };
+    std::vector<Entry> entries;
+    uint32_t next = 0;
+    uint64_t memoryLimit = 256ull * 1024ull * 1024ull;
+    int32_t width = 0;
+    int32_t height = 0;
+
+    // the frame mpv currently displays or -1 if unknown
+    int64_t decoderFrame = -1;
+    // the frame shown from the buffer or -1 while the decoder output is shown
+    int64_t shownFrame = -1;
+
+    // the observed time-pos and the rendered frame arrive independently,
+    // a frame gets captured once both are there. only while paused, that
+    // includes frame-steps, the two are known to belong to the same frame
+    double timePos = -1.0;
+    bool timePosChanged = false;
+    bool frameRendered = false;
+
+    inline int32_t Capacity(int32_t w, int32_t h) const noexcept
+    {
+        uint64_t frameBytes = (uint64_t)w * (uint64_t)h * 4;
+        if (frameBytes == 0) return 0;
+        return (int32_t)std::min<uint64_t>(MaxFrames, memoryLimit / frameBytes);
+    }
+
+    inline Entry* Find(int64_t frame) noexcept
+    {
+        if (frame < 0) return nullptr;
+        for (auto& entry : entries) {
+            if (entry.frame == frame) return &entry;
+        }
+        return nullptr;
+    }
+
+    inline bool InWindow(int64_t frame) const noexcept
+    {
+        int64_t minFrame = INT64_MAX, maxFrame = -1;
+        for (auto& entry : entries) {
+            if (entry.frame < 0) continue;
+            minFrame = std::min(minFrame, entry.frame);
+            maxFrame = std::max(maxFrame, entry.frame);
+        }
+        return maxFrame >= 0 && frame >= minFrame - 1 && frame <= maxFrame + 1;
+    }
+
+    inline void Invalidate() noexcept
+    {
+        for (auto& entry : entries) entry.frame = -1;
+        next = 0;
+        decoderFrame = -1;
+        shownFrame = -1;
+        timePosChanged = false;
+        frameRendered = false;
+    }
+
+    inline void Release() noexcept
+    {
+        for (auto& entry : entries) {
+            if (entry.texture) glDeleteTextures(1, &entry.texture);
+        }
+        entries.clear();
+        next = 0;
+        width = 0;
+        height = 0;
+        decoderFrame = -1;
+        shownFrame = -1;
+    }
+};
+
 struct MpvPlayerContext
 {
     mpv_handle* mpv = nullptr;
@@ -61,10 +145,16 @@ struct MpvPlayerContext
     SDL_atomic_t hasEvents = {0};
 
     uint32_t* frameTexture = nullptr;
+    uint32_t* bufferedFrameTexture = nullptr;
     float* logicalPosition = nullptr;
 
     uint64_t smoothTimer = 0;
     VideoplayerType playerType;
+
+    OFS_VideoIndex index;
+    // set while a frame-step command is running
+    bool frameStepping = false;
+    FrameRingBuffer frames;
 };
 
 #define CTX static_cast<MpvPlayerContext*>(ctx)
@@ -134,6 +224,8 @@ inline static void updateRenderTexture(MpvPlayerContext* ctx) noexcept
 		}
 	}
 	else if(ctx->data.videoHeight > 0 && ctx->data.videoWidth > 0) {
+		*ctx->bufferedFrameTexture = 0;
+		ctx->frames.Release();
 		// update size of render texture based on video resolution
 		glBindTexture(GL_TEXTURE_2D, *ctx->frameTexture);
 		glTexImage2D(GL_TEXTURE_2D, 0, OFS_InternalTexFormat, ctx->data.videoWidth, ctx->data.videoHeight, 0, OFS_TexFormat, GL_UNSIGNED_BYTE, 0);
@@ -160,6 +252,7 @@ OFS_Videoplayer::OFS_Videoplayer(VideoplayerType playerType) noexcept
     ctx = new MpvPlayerContext();
     CTX->playerType = playerType;
     CTX->frameTexture = &this->frameTexture;
+    CTX->bufferedFrameTexture = &this->bufferedFrameTexture;
     CTX->logicalPosition = &this->logicalPosition;
 }
 
@@ -245,6 +338,7 @@ bool OFS_Videoplayer::Init(bool hwAccel) noexcept
 	mpv_observe_property(CTX->mpv, MpvFilePath, "path", MPV_FORMAT_STRING);
 	mpv_observe_property(CTX->mpv, MpvHwDecoder, "hwdec-current", MPV_FORMAT_STRING);
 	mpv_observe_property(CTX->mpv, MpvFramesPerSecond, "estimated-vf-fps", MPV_FORMAT_DOUBLE);
+	mpv_observe_property(CTX->mpv, MpvTimePos, "time-pos", MPV_FORMAT_DOUBLE);
 
     return true;
 }
@@ -277,6 +371,12 @@ inline static void ProcessEvents(MpvPlayerContext* ctx) noexcept
                 ctx->data.videoLoaded = true; 	
                 continue;
             }
+            case MPV_EVENT_PLAYBACK_RESTART:
+            {
+                // the stepped frame is there even if the pause toggle got coalesced
+                ctx->frameStepping = false;
+                continue;
+            }
             case MPV_EVENT_PROPERTY_CHANGE:
             {
                 mpv_event_property* prop = (mpv_event_property*)mp_event->data;
@@ -327,6 +427,12 @@ inline static void ProcessEvents(MpvPlayerContext* ctx) noexcept
                         notifyTime(ctx);
                         break;
                     }
+                    case MpvTimePos:
+                        ctx->frames.timePos = *(double*)prop->data;
+                        ctx->frames.timePosChanged = true;
+                        // time-pos of the stepped frame, the step is done
+                        ctx->frameStepping = false;
+                        break;
                     case MpvSpeed:
                         ctx->data.currentSpeed = *(double*)prop->data;
                         notifyPlaybackSpeed(ctx);
@@ -334,6 +440,14 @@ inline static void ProcessEvents(MpvPlayerContext* ctx) noexcept
                     case MpvPauseState:
                     {
                         bool paused = *(int64_t*)prop->data;
+                        if (ctx->frameStepping) {
+                            // frame-step unpauses the player for a single frame
+                            // that isn't a state change as far as we're concerned
+                            if (paused) ctx->frameStepping = false;
+                            break;
+                        }
+                        // the pause toggle of a finished frame-step can arrive late
+                        if (paused == (bool)ctx->data.paused) break;
                         if (paused) {
                             float timeSinceLastUpdate = (SDL_GetTicks64() - CTX->smoothTimer) / 1000.f;
                             float positionOffset = (timeSinceLastUpdate * CTX->data.currentSpeed) / CTX->data.duration;
@@ -341,11 +455,17 @@ inline static void ProcessEvents(MpvPlayerContext* ctx) noexcept
                         }
                         ctx->smoothTimer = SDL_GetTicks64();
                         ctx->data.paused = paused;
+                        // a frame from before the pause could be paired with the new time-pos
+                        ctx->frames.timePosChanged = false;
+                        ctx->frames.frameRendered = false;
                         notifyPaused(ctx);
                         break;
                     }
                     case MpvFilePath:
                         ctx->data.filePath = *((const char**)(prop->data));
+                        if (ctx->playerType == VideoplayerType::Main) {
+                            ctx->index.Build(ctx->data.filePath);
+                        }
                         notifyVideoLoaded(ctx);
                         break;
                 }
@@ -372,6 +492,87 @@ inline static void RenderFrameToTexture(MpvPlayerContext* ctx) noexcept
 	mpv_render_context_render(ctx->mpvGL, params);
 }
 
+inline static void captureFrame(MpvPlayerContext* ctx) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    auto& frames = ctx->frames;
+    if (!ctx->data.paused) {
+        // while playing time-pos and the rendered frame don't belong together
+        frames.decoderFrame = -1;
+        frames.frameRendered = false;
+        frames.timePosChanged = false;
+        return;
+    }
+    if (!frames.frameRendered || !frames.timePosChanged) return;
+    frames.frameRendered = false;
+    frames.timePosChanged = false;
+    if (!ctx->index.Ready() || frames.timePos < 0.0) {
+        frames.decoderFrame = -1;
+        return;
+    }
+
+    int64_t frame = ctx->index.FrameIndex((float)frames.timePos);
+    frames.decoderFrame = frame;
+    if (frame < 0 || frames.Find(frame)) return;
+
+    const int32_t w = ctx->data.videoWidth;
+    const int32_t h = ctx->data.videoHeight;
+    const int32_t capacity = frames.Capacity(w, h);
+    if (capacity <= 0) return;
+    if (frames.width != w || frames.height != h || frames.entries.size() != (size_t)capacity) {
+        *ctx->bufferedFrameTexture = 0;
+        frames.Release();
+        frames.width = w;
+        frames.height = h;
+        frames.entries.resize(capacity);
+        frames.decoderFrame = frame;
+    }
+
+    auto& entry = frames.entries[frames.next];
+    frames.next = (frames.next + 1) % frames.entries.size();
+    if (!entry.texture) {
+        glGenTextures(1, &entry.texture);
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, OFS_InternalTexFormat, w, h, 0, OFS_TexFormat, GL_UNSIGNED_BYTE, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    entry.frame = frame;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, ctx->framebuffer);
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, w, h);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Shows a frame without touching the decoder if it's either buffered or the one mpv displays.
+inline static bool showBufferedFrame(MpvPlayerContext* ctx, int64_t frame) noexcept
+{
+    auto& frames = ctx->frames;
+    float frameTime = ctx->index.FrameTimeAt(frame);
+    if (frameTime < 0.f) return false;
+
+    if (frame == frames.decoderFrame) {
+        if (frames.shownFrame < 0) return false;
+        frames.shownFrame = -1;
+        *ctx->bufferedFrameTexture = 0;
+    }
+    else if (auto entry = frames.Find(frame)) {
+        frames.shownFrame = frame;
+        *ctx->bufferedFrameTexture = entry->texture;
+    }
+    else {
+        return false;
+    }
+
+    *ctx->logicalPosition = frameTime / ctx->data.duration;
+    ctx->data.percentPos = *ctx->logicalPosition;
+    notifyTime(ctx);
+    return true;
+}
+
 void OFS_Videoplayer::Update(float delta) noexcept
 {
     while(SDL_AtomicGet(&CTX->hasEvents) > 0) {
@@ -384,9 +585,12 @@ void OFS_Videoplayer::Update(float delta) noexcept
         uint64_t flags = mpv_render_context_update(CTX->mpvGL);
 	    if (flags & MPV_RENDER_UPDATE_FRAME) {
             RenderFrameToTexture(CTX);
+            CTX->frames.frameRendered = true;
         }
         SDL_AtomicDecRef(&CTX->renderUpdate);
     }
+    // the framebuffer keeps the last frame until its time-pos arrives
+    captureFrame(CTX);
 }
 
 void OFS_Videoplayer::SetVolume(float volume) noexcept
@@ -399,24 +603,46 @@ void OFS_Videoplayer::SetVolume(float volume) noexcept
 
 void OFS_Videoplayer::NextFrame() noexcept
 {
-    if (IsPaused()) {
+    if (!IsPaused()) return;
+    int64_t currentFrame = CTX->index.FrameIndex(CurrentTime());
+    if (currentFrame >= 0 && showBufferedFrame(CTX, currentFrame + 1)) return;
+
+    float nextFrame = CTX->index.NextFrameTime(CurrentTime());
+    if (nextFrame >= 0.f && CTX->frames.shownFrame >= 0) {
+        // mpv isn't at the frame which is shown, frame-step would skip ahead
+        seekToTime(nextFrame, true);
+    }
+    else if (nextFrame >= 0.f) {
+        // the index knows the exact time of the next frame
+        // so instead of seeking mpv only has to decode a single frame
+        logicalPosition = nextFrame / CTX->data.duration;
+        CTX->data.percentPos = logicalPosition;
+        CTX->frameStepping = true;
+        CTX->frames.timePosChanged = false;
+        CTX->frames.frameRendered = false;
+        const char* cmd[]{ "frame-step", NULL };
+        mpv_command_async(CTX->mpv, 0, cmd);
+    }
+    else {
         // use same method as previousFrame for consistency
-        double relSeek = FrameTime() * 1.000001;
-        CTX->data.percentPos += (relSeek / CTX->data.duration);
-        CTX->data.percentPos = Util::Clamp(CTX->data.percentPos, 0.0, 1.0);
-        SetPositionPercent(CTX->data.percentPos, false);
+        seekToTime(CurrentTime() + FrameTime() * 1.000001, true);
     }
 }
 
 void OFS_Videoplayer::PreviousFrame() noexcept
 {
-    if (IsPaused()) {
+    if (!IsPaused()) return;
+    int64_t currentFrame = CTX->index.FrameIndex(CurrentTime());
+    if (currentFrame >= 0 && showBufferedFrame(CTX, currentFrame - 1)) return;
+
+    float previousFrame = CTX->index.PreviousFrameTime(CurrentTime());
+    if (previousFrame >= 0.f) {
+        seekToTime(previousFrame, true);
+    }
+    else {
         // this seeks much faster
         // https://github.com/mpv-player/mpv/issues/4019#issuecomment-358641908
-        double relSeek = FrameTime() * 1.000001;
-        CTX->data.percentPos -= (relSeek / CTX->data.duration);
-        CTX->data.percentPos = Util::Clamp(CTX->data.percentPos, 0.0, 1.0);
-        SetPositionPercent(CTX->data.percentPos, false);
+        seekToTime(CurrentTime() - FrameTime() * 1.000001, true);
     }
 }
 
@@ -438,6 +664,20 @@ void OFS_Videoplayer::OpenVideo(const std::string& path) noexcept
     SetSpeed(CTX->data.currentSpeed);
 }
 
+void OFS_Videoplayer::SetFrameBufferMemory(uint32_t megabytes) noexcept
+{
+    auto& frames = CTX->frames;
+    uint64_t limit = (uint64_t)megabytes * 1024ull * 1024ull;
+    if (frames.memoryLimit == limit) return;
+    frames.memoryLimit = limit;
+    // gets reallocated with the new capacity on the next capture
+    if (frames.shownFrame >= 0) {
+        seekToTime(CurrentTime(), true);
+    }
+    bufferedFrameTexture = 0;
+    frames.Release();
+}
+
 void OFS_Videoplayer::SetSpeed(float speed) noexcept
 {
     speed = Util::Clamp<float>(speed, MinPlaybackSpeed, MaxPlaybackSpeed);
@@ -455,48 +695,90 @@ void OFS_Videoplayer::AddSpeed(float speed) noexcept
     SetSpeed(speed);
 }
 
+void OFS_Videoplayer::seekToTime(double timeSeconds, bool exact) noexcept
+{
+    // all seeks end up here, this updates logicalPosition
+    timeSeconds = Util::Clamp(timeSeconds, 0.0, CTX->data.duration);
+    logicalPosition = timeSeconds / CTX->data.duration;
+    CTX->data.percentPos = logicalPosition;
+    CTX->frameStepping = false;
+
+    auto& frames = CTX->frames;
+    frames.shownFrame = -1;
+    frames.decoderFrame = -1;
+    // don't pair a frame from before the seek with the new time-pos
+    frames.timePosChanged = false;
+    frames.frameRendered = false;
+    bufferedFrameTexture = 0;
+    if (!frames.InWindow(CTX->index.FrameIndex(timeSeconds))) {
+        frames.Invalidate();
+    }
+
+    stbsp_snprintf(CTX->tmpBuf.data(), CTX->tmpBuf.size(), "%.06f", timeSeconds);
+    const char* cmd[]{ "seek", CTX->tmpBuf.data(), exact ? "absolute+exact" : "absolute+keyframes", NULL };
+    mpv_command_async(CTX->mpv, 0, cmd);
+}
+
 void OFS_Videoplayer::SetPositionPercent(float percentPos, bool pausesVideo) noexcept
 {
-    logicalPosition = percentPos;
-    CTX->data.percentPos = percentPos;
-    stbsp_snprintf(CTX->tmpBuf.data(), CTX->tmpBuf.size(), "%.08f", (float)(percentPos * 100.0f));
-    const char* cmd[]{ "seek", CTX->tmpBuf.data(), "absolute-percent+exact", NULL };
+    double timeSeconds = (double)percentPos * CTX->data.duration;
+    bool exact = true;
+    if (seekMode == VideoplayerSeekMode::Keyframe) {
+        float keyframe = CTX->index.ClosestKeyframe(timeSeconds);
+        if (keyframe >= 0.f) {
+            // an exact seek onto a keyframe is as cheap as a keyframe seek
+            // and the logical position matches the displayed frame
+            timeSeconds = keyframe;
+        }
+        else {
+            // without the index the logical position only gets corrected while playing
+            exact = pausesVideo || IsPaused();
+        }
+    }
     if (pausesVideo) {
         SetPaused(true);
     }
-    mpv_command_async(CTX->mpv, 0, cmd);
+    seekToTime(timeSeconds, exact);
 }
 
 void OFS_Videoplayer::SetPositionExact(float timeSeconds, bool pausesVideo) noexcept
 {
-    // this updates logicalPosition in SetPositionPercent
-    timeSeconds = Util::Clamp<float>(timeSeconds, 0.f, Duration());
-    float relPos = ((float)timeSeconds) / Duration();
-    SetPositionPercent(relPos, pausesVideo);
+    if (pausesVideo) {
+        SetPaused(true);
+    }
+    seekToTime(timeSeconds, true);
 }
 
 void OFS_Videoplayer::SeekRelative(float timeSeconds) noexcept
 {
-    // this updates logicalPosition in SetPositionPercent
     auto seekTo = CurrentTime() + timeSeconds;
     seekTo = std::max(seekTo, 0.0);
+    // snapping to the closest keyframe would swallow short seeks
     SetPositionExact(seekTo);
 }
 
 void OFS_Videoplayer::SeekFrames(int32_t offset) noexcept
 {
-    // this updates logicalPosition in SetPositionPercent
-    if (IsPaused()) {
-        float relSeek = (FrameTime() * 1.000001f) * offset;
-        CTX->data.percentPos += (relSeek / CTX->data.duration);
-        CTX->data.percentPos = Util::Clamp(CTX->data.percentPos, 0.0, 1.0);
-        SetPositionPercent(CTX->data.percentPos, false);
+    if (!IsPaused()) return;
+    int64_t frameIndex = CTX->index.FrameIndex(CurrentTime());
+    if (frameIndex >= 0) {
+        frameIndex = Util::Clamp<int64_t>(frameIndex + offset, 0, CTX->index.FrameCount() - 1);
+        if (showBufferedFrame(CTX, frameIndex)) return;
+        seekToTime(CTX->index.FrameTimeAt(frameIndex), true);
+    }
+    else {
+        seekToTime(CurrentTime() + (FrameTime() * 1.000001f) * offset, true);
     }
 }
 
 void OFS_Videoplayer::SetPaused(bool paused) noexcept
 {
     if ((bool)CTX->data.paused == paused) return;
+    CTX->frameStepping = false;
+    if (!paused && CTX->frames.shownFrame >= 0) {
+        // mpv is still parked at a later frame
+        seekToTime(CurrentTime(), true);
+    }
     int64_t setPaused = paused;
     mpv_set_property_async(CTX->mpv, 0, "pause", MPV_FORMAT_FLAG, &setPaused);
 }
@@ -510,6 +792,9 @@ void OFS_Videoplayer::CycleSubtitles() noexcept
 void OFS_Videoplayer::CloseVideo() noexcept
 {
     CTX->data.videoLoaded = false;
+    CTX->index.Clear();
+    CTX->frames.Invalidate();
+    bufferedFrameTexture = 0;
     const char* cmd[] = { "stop", NULL };
     mpv_command_async(CTX->mpv, 0, cmd);
     SetPaused(true);
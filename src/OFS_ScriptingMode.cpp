@@ -127,6 +127,10 @@ void ScriptingMode::SetMode(ScriptingModeEnum mode) noexcept
     else {
         activeMode = ScriptingModeEnum::DEFAULT_MODE;
     }
+    // while recording seeking fast matters more than landing on the exact frame
+    OpenFunscripter::ptr->player->SetSeekMode(activeMode == ScriptingModeEnum::RECORDING
+        ? VideoplayerSeekMode::Keyframe
+        : VideoplayerSeekMode::Exact);
 }
 
 void ScriptingMode::SetOverlay(ScriptingOverlayModes mode) noexcept
@@ -344,7 +348,7 @@ inline void RecordingMode::singleAxisRecording() noexcept
 {
     OFS_PROFILE(__FUNCTION__);
     auto app = OpenFunscripter::ptr;
-    recordingAxisX->AddAction(FunscriptAction(app->player->CurrentTime(), currentPosY));
+    addSample(app->player->CurrentTime(), currentPosY, 0);
     app->simulator.positionOverride = currentPosY;
 }
 
@@ -352,10 +356,131 @@ inline void RecordingMode::twoAxisRecording() noexcept
 {
     OFS_PROFILE(__FUNCTION__);
     auto app = OpenFunscripter::ptr;
+    addSample(app->player->CurrentTime(), currentPosX, currentPosY);
+}
+
+inline static float StrongestAxis(float left, float right) noexcept
+{
+    return std::abs(right) > std::abs(left) ? right : left;
+}
+
+void RecordingMode::controllerSampleRecording() noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    auto app = OpenFunscripter::ptr;
+    auto& sampler = ControllerInput::Sampler;
+    sampler.SetClock(app->player->CurrentTime(), app->player->CurrentSpeed(), !app->player->IsPaused());
+
+    int32_t posY = currentPosY;
+    sampler.Drain([this, &posY](const ControllerSampler::Sample& sample) noexcept {
+        float y = -StrongestAxis(normalizeAxis(sample.axes[SDL_CONTROLLER_AXIS_LEFTY]), normalizeAxis(sample.axes[SDL_CONTROLLER_AXIS_RIGHTY]));
+        posY = controllerPosition(y);
+        if (twoAxesMode) {
+            float x = StrongestAxis(normalizeAxis(sample.axes[SDL_CONTROLLER_AXIS_LEFTX]), normalizeAxis(sample.axes[SDL_CONTROLLER_AXIS_RIGHTX]));
+            addSample(sample.time, controllerPosition(x), posY);
+        }
+        else {
+            // like singleAxisRecording the vertical axis goes into the first script
+            addSample(sample.time, posY, 0);
+        }
+    });
+    if (!twoAxesMode) app->simulator.positionOverride = posY;
+
+    if (auto dropped = sampler.TakeDropped()) {
+        LOGF_WARN("Dropped %u controller samples.", dropped);
+    }
+}
+
+void RecordingMode::addSample(float atS, int32_t posX, int32_t posY) noexcept
+{
+    if (!samplesX.empty()) {
+        if (atS == samplesX.back().atS) return;
+        // seeking backwards ends the batch
+        if (atS < samplesX.back().atS) commitSamples(true);
+    }
+    samplesX.emplace_back(atS, posX);
+    if (recordingAxisY) samplesY.emplace_back(atS, posY);
+
+    if (samplesX.back().atS - samplesX.front().atS >= CommitInterval) {
+        commitSamples(false);
+    }
+}
 
-    float atS = app->player->CurrentTime();
-    recordingAxisX->AddAction(FunscriptAction(atS, currentPosX));
-    recordingAxisY->AddAction(FunscriptAction(atS, currentPosY));
+// Error bounded Ramer-Douglas-Peucker. Keeps the samples needed so that
+// no sample is further than tolerance away from the simplified line in position.
+static void SimplifySamples(const std::vector<FunscriptAction>& samples, float tolerance, std::vector<bool>& keep) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    keep.assign(samples.size(), false);
+    keep.front() = true;
+    keep.back() = true;
+
+    std::vector<std::pair<int32_t, int32_t>> stk;
+    stk.emplace_back(0, (int32_t)samples.size() - 1);
+    while (!stk.empty()) {
+        auto [first, last] = stk.back();
+        stk.pop_back();
+
+        auto a = samples[first];
+        auto b = samples[last];
+        float maxError = 0.f;
+        int32_t maxIdx = -1;
+        for (int32_t i = first + 1; i < last; i += 1) {
+            // samples are strictly increasing in time
+            float t = (samples[i].atS - a.atS) / (b.atS - a.atS);
+            float error = std::abs(samples[i].pos - (a.pos + (b.pos - a.pos) * t));
+            if (error > maxError) {
+                maxError = error;
+                maxIdx = i;
+            }
+        }
+
+        if (maxIdx >= 0 && maxError > tolerance) {
+            keep[maxIdx] = true;
+            stk.emplace_back(first, maxIdx);
+            stk.emplace_back(maxIdx, last);
+        }
+    }
+}
+
+static void CommitBatch(Funscript& script, std::vector<FunscriptAction>& samples, bool firstCommitted, bool final, bool simplify, float tolerance) noexcept
+{
+    if (samples.empty()) return;
+    static std::vector<bool> keep;
+    if (simplify) {
+        SimplifySamples(samples, tolerance, keep);
+    }
+    else {
+        keep.assign(samples.size(), true);
+    }
+
+    FunscriptArray batch;
+    batch.reserve(samples.size());
+    for (size_t i = firstCommitted ? 1 : 0, size = samples.size(); i < size; i += 1) {
+        if (keep[i]) batch.emplace_back_unsorted(samples[i]);
+    }
+    // the samples are strictly increasing, recorded actions replace existing ones
+    script.MergeActions(batch);
+
+    auto last = samples.back();
+    samples.clear();
+    if (!final) samples.emplace_back(last);
+}
+
+void RecordingMode::commitSamples(bool final) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    if (recordingAxisX) {
+        CommitBatch(*recordingAxisX, samplesX, firstCommitted, final, simplify, simplifyTolerance);
+    }
+    if (recordingAxisY) {
+        CommitBatch(*recordingAxisY, samplesY, firstCommitted, final, simplify, simplifyTolerance);
+    }
+    if (final) {
+        samplesX.clear();
+        samplesY.clear();
+    }
+    firstCommitted = !samplesX.empty();
 }
 
 // recording
@@ -376,53 +501,56 @@ void RecordingMode::ControllerAxisMotion(const OFS_SDL_Event* ev) noexcept
     OFS_PROFILE(__FUNCTION__);
     if (activeType != RecordingType::Controller) return;
     auto& axis = ev->sdl.caxis;
-    const float range = (float)std::numeric_limits<int16_t>::max() - ControllerDeadzone;
-    int16_t axisValue = axis.value;
-
-    if (axis.value >= 0 && axis.value < ControllerDeadzone)
-        axisValue = 0;
-    else if (axis.value < 0 && axis.value > -ControllerDeadzone)
-        axisValue = 0;
-    else if (axis.value >= ControllerDeadzone)
-        axisValue -= ControllerDeadzone;
-    else if (axis.value <= ControllerDeadzone)
-        axisValue += ControllerDeadzone;
+    float axisValue = normalizeAxis(axis.value);
 
     switch (axis.axis) {
         case SDL_CONTROLLER_AXIS_LEFTX:
-            leftX = Util::Clamp(axisValue / range, -1.f, 1.f);
+            leftX = axisValue;
             break;
         case SDL_CONTROLLER_AXIS_LEFTY:
-            leftY = Util::Clamp(axisValue / range, -1.f, 1.f);
+            leftY = axisValue;
             break;
         case SDL_CONTROLLER_AXIS_RIGHTX:
-            rightX = Util::Clamp(axisValue / range, -1.f, 1.f);
+            rightX = axisValue;
             break;
         case SDL_CONTROLLER_AXIS_RIGHTY:
-            rightY = Util::Clamp(axisValue / range, -1.f, 1.f);
+            rightY = axisValue;
             break;
         case SDL_CONTROLLER_AXIS_TRIGGERLEFT:
-            leftTrigger = Util::Clamp(axisValue / range, -1.f, 1.f);
+            leftTrigger = axisValue;
             break;
         case SDL_CONTROLLER_AXIS_TRIGGERRIGHT:
-            rightTrigger = Util::Clamp(axisValue / range, -1.f, 1.f);
+            rightTrigger = axisValue;
             break;
     }
 
+    valueX = StrongestAxis(leftX, rightX);
+    valueY = -StrongestAxis(leftY, rightY);
+}
 
-    if (std::abs(rightX) > std::abs(leftX)) {
-        valueX = rightX;
-    }
-    else {
-        valueX = leftX;
-    }
+float RecordingMode::normalizeAxis(int16_t value) const noexcept
+{
+    const float range = (float)std::numeric_limits<int16_t>::max() - ControllerDeadzone;
+    int16_t axisValue = value;
 
-    if (std::abs(rightY) > std::abs(leftY)) {
-        valueY = -rightY;
-    }
-    else {
-        valueY = -leftY;
-    }
+    if (value >= 0 && value < ControllerDeadzone)
+        axisValue = 0;
+    else if (value < 0 && value > -ControllerDeadzone)
+        axisValue = 0;
+    else if (value >= ControllerDeadzone)
+        axisValue -= ControllerDeadzone;
+    else if (value <= ControllerDeadzone)
+        axisValue += ControllerDeadzone;
+
+    return Util::Clamp(axisValue / range, -1.f, 1.f);
+}
+
+int32_t RecordingMode::controllerPosition(float value) const noexcept
+{
+    int32_t pos = controllerCenter
+        ? Util::Clamp<int32_t>(50.f + (50.f * value), 0, 100)
+        : Util::Clamp<int32_t>(100.f * std::abs(value), 0, 100);
+    return inverted ? 100 - pos : pos;
 }
 
 inline static const char* RecordingModeToString(RecordingMode::RecordingType mode) noexcept
@@ -434,6 +562,39 @@ inline static const char* RecordingModeToString(RecordingMode::RecordingType mod
     return "";
 }
 
+void RecordingMode::startRecording() noexcept
+{
+    samplesX.clear();
+    samplesY.clear();
+    firstCommitted = false;
+    BaseOverlay::Pending.clear();
+    BaseOverlay::Pending.push_back({ recordingAxisX.get(), &samplesX });
+    if (recordingAxisY) {
+        BaseOverlay::Pending.push_back({ recordingAxisY.get(), &samplesY });
+    }
+    recordingActive = true;
+
+    if (activeType == RecordingType::Controller) {
+        // falls back to sampling once per frame if the thread can't be started
+        auto app = OpenFunscripter::ptr;
+        ControllerInput::Sampler.SetClock(app->player->CurrentTime(), app->player->CurrentSpeed(), !app->player->IsPaused());
+        ControllerInput::Sampler.Start(controllerSampleRate);
+    }
+}
+
+void RecordingMode::stopRecording() noexcept
+{
+    if (ControllerInput::Sampler.Running()) {
+        ControllerInput::Sampler.Stop();
+        controllerSampleRecording();
+    }
+    commitSamples(true);
+    BaseOverlay::Pending.clear();
+    recordingAxisX = nullptr;
+    recordingAxisY = nullptr;
+    recordingActive = false;
+}
+
 void RecordingMode::DrawModeSettings() noexcept
 {
     OFS_PROFILE(__FUNCTION__);
@@ -454,6 +615,12 @@ void RecordingMode::DrawModeSettings() noexcept
             ImGui::TextUnformatted(TR(CONTROLLER_DEADZONE));
             ImGui::SliderInt(TR(DEADZONE), &ControllerDeadzone, 0, std::numeric_limits<int16_t>::max());
             ImGui::Checkbox(TR(CENTER), &controllerCenter);
+            if (ImGui::SliderInt(TR(SAMPLE_RATE), &controllerSampleRate, ControllerSampler::MinRate, ControllerSampler::MaxRate, "%d Hz", ImGuiSliderFlags_AlwaysClamp)) {
+                if (ControllerInput::Sampler.Running()) {
+                    ControllerInput::Sampler.Start(controllerSampleRate);
+                }
+            }
+            OFS::Tooltip(TR(SAMPLE_RATE_TOOLTIP));
             if (controllerCenter) {
                 currentPosX = Util::Clamp<int32_t>(50.f + (50.f * valueX), 0, 100);
                 currentPosY = Util::Clamp<int32_t>(50.f + (50.f * valueY), 0, 100);
@@ -480,6 +647,15 @@ void RecordingMode::DrawModeSettings() noexcept
     ImGui::Checkbox(TR(INVERT), &inverted);
     ImGui::SameLine();
     ImGui::Checkbox(TR(RECORD_ON_PLAY), &automaticRecording);
+    ImGui::Checkbox(TR(SIMPLIFY), &simplify);
+    OFS::Tooltip(TR(RECORDING_SIMPLIFY_TOOLTIP));
+    if (simplify) {
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6.f);
+        if (ImGui::DragFloat(TR(TOLERANCE), &simplifyTolerance, 0.05f, 0.f, 20.f, "%.2f", ImGuiSliderFlags_AlwaysClamp)) {
+            simplifyTolerance = std::max(simplifyTolerance, 0.f);
+        }
+    }
     if (inverted) {
         currentPosX = 100 - currentPosX;
         currentPosY = 100 - currentPosY;
@@ -504,8 +680,9 @@ void RecordingMode::DrawModeSettings() noexcept
     if (automaticRecording && playing && recordingActive != playing) {
         if (!twoAxesMode) {
             recordingAxisX = app->ActiveFunscript();
+            recordingAxisY = nullptr;
             app->undoSystem->Snapshot(StateType::GENERATE_ACTIONS, recordingAxisX);
-            recordingActive = true;
+            startRecording();
         }
         else {
             recordingAxisX = nullptr;
@@ -524,14 +701,12 @@ void RecordingMode::DrawModeSettings() noexcept
             }
             else {
                 app->undoSystem->Snapshot(StateType::GENERATE_ACTIONS, { recordingAxisX, recordingAxisY });
-                recordingActive = true;
+                startRecording();
             }
         }
     }
     else if (!playing && recordingActive) {
-        recordingAxisX = nullptr;
-        recordingAxisY = nullptr;
-        recordingActive = false;
+        stopRecording();
     }
 
     if (recordingActive && playing) {
@@ -551,7 +726,16 @@ void RecordingMode::Update() noexcept
     OFS_PROFILE(__FUNCTION__);
     auto app = OpenFunscripter::ptr;
     if (recordingActive) {
-        if (twoAxesMode) {
+        auto& sampler = ControllerInput::Sampler;
+        if (sampler.Running() && activeType != RecordingType::Controller) {
+            // switched to the mouse while recording
+            sampler.Stop();
+            controllerSampleRecording();
+        }
+        else if (sampler.Running()) {
+            controllerSampleRecording();
+        }
+        else if (twoAxesMode) {
             twoAxisRecording();
         }
         else {
@@ -565,8 +749,6 @@ void RecordingMode::Finish() noexcept
     OFS_PROFILE(__FUNCTION__);
     // this fixes a bug when the mode gets changed during a recording
     if (recordingActive) {
-        recordingAxisX = nullptr;
-        recordingAxisY = nullptr;
-        recordingActive = false;
+        stopRecording();
     }
 }
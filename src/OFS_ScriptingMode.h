@@ -9,6 +9,7 @@
 
 #include <memory>
 #include <array>
+#include <vector>
 
 // ATTENTION: no reordering
 enum ScriptingModeEnum : int32_t {
@@ -79,6 +80,8 @@ private:
     float valueY = 0.f;
 
     int32_t ControllerDeadzone = 1750;
+    // samples per second while recording with a controller
+    int32_t controllerSampleRate = 500;
     int32_t currentPosX = 0;
     int32_t currentPosY = 0;
     bool controllerCenter = true;
@@ -91,10 +94,30 @@ private:
     std::shared_ptr<Funscript> recordingAxisX;
     std::shared_ptr<Funscript> recordingAxisY;
 
+    // raw samples of the running recording, committed to the scripts in batches
+    std::vector<FunscriptAction> samplesX;
+    std::vector<FunscriptAction> samplesY;
+    // the first sample is the end of the previous batch
+    bool firstCommitted = false;
+    bool simplify = false;
+    float simplifyTolerance = 1.f;
+
     UnsubscribeFn eventUnsub;
 
+    // seconds of samples in a batch
+    static constexpr float CommitInterval = 1.f;
+
     void singleAxisRecording() noexcept;
     void twoAxisRecording() noexcept;
+    void addSample(float atS, int32_t posX, int32_t posY) noexcept;
+    // deadzone applied, from -1 to 1
+    float normalizeAxis(int16_t value) const noexcept;
+    int32_t controllerPosition(float value) const noexcept;
+    void controllerSampleRecording() noexcept;
+    // the last sample is kept as the start of the next batch unless it's the final one
+    void commitSamples(bool final) noexcept;
+    void startRecording() noexcept;
+    void stopRecording() noexcept;
 
 public:
     // Attention: don't change order
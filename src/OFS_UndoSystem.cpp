@@ -38,7 +38,8 @@ static std::array<Tr, (int32_t)StateType::TOTAL_UNDOSTATE_TYPES> stateTranslatio
     Tr::MOVE_TO_CURRENT_POSITION,
 
     Tr::SIMPLIFY,
-    Tr::LUA_SCRIPT
+    Tr::LUA_SCRIPT,
+    Tr::WEBSOCKET_EDIT
 };
 
 // FIXME: UndoStack and RedoStack should be filtered when scripts are removed / projects change
@@ -115,6 +116,19 @@ void UndoSystem::Snapshot(StateType type, UndoContextScripts&& scriptsToSnapshot
     }
 }
 
+void UndoSystem::SnapshotRange(StateType type, std::weak_ptr<const class Funscript> scriptToSnapshot, float startTime, float endTime) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    auto script = scriptToSnapshot.lock();
+    if (!script) {
+        FUN_ASSERT(false, "Stale weak_ptr.");
+        return;
+    }
+    UndoStack.emplace_back(UndoContextScripts{ scriptToSnapshot }, type);
+    ClearRedo();
+    script->undoSystem->SnapshotRange(type, startTime, endTime);
+}
+
 bool UndoSystem::Undo() noexcept
 {
     if (UndoStack.empty()) return false;
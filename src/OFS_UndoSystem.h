@@ -37,6 +37,7 @@ enum StateType : int32_t {
 
     SIMPLIFY = 21,
     CUSTOM_LUA = 22,
+    WEBSOCKET_EDIT = 23,
     // add more here & update stateStrings in UndoSystem.cpp
 
 
@@ -74,6 +75,8 @@ public:
     void Snapshot(StateType type,
         UndoContextScripts&& scriptsToSnapshot,
         bool clearRedo = true) noexcept;
+    // only keeps the part of the script between startTime and endTime
+    void SnapshotRange(StateType type, std::weak_ptr<const class Funscript> scriptToSnapshot, float startTime, float endTime) noexcept;
     bool Undo() noexcept;
     bool Redo() noexcept;
 
@@ -213,6 +213,7 @@ bool OpenFunscripter::Init(int argc, char* argv[])
         return false;
     }
     player->SetPaused(true);
+    player->SetFrameBufferMemory(prefState.frameBufferMemoryMb);
 
     playerWindow = std::make_unique<OFS_VideoplayerWindow>();
     if (!playerWindow->Init(player.get())) {
@@ -264,6 +265,7 @@ bool OpenFunscripter::Init(int argc, char* argv[])
     simulator.Init();
 
     FunscriptHeatmap::Init();
+    FunscriptLineCache::Init();
     extensions = std::make_unique<OFS_LuaExtensions>();
     extensions->Init();
     metadataEditor = std::make_unique<OFS_FunscriptMetadataEditor>();
@@ -1373,7 +1375,10 @@ void OpenFunscripter::FunscriptChanged(const FunscriptActionsChangedEvent* ev) n
         }
     }
 
-    Status = Status | OFS_Status::OFS_GradientNeedsUpdate;
+    // a pending full update covers this change as well
+    if (ptr == ActiveFunscript().get() && !(Status & OFS_Status::OFS_GradientNeedsUpdate)) {
+        playerControls.UpdateHeatmap(player->Duration(), ptr->Actions(), ev->DirtyStartTime, ev->DirtyEndTime);
+    }
 }
 
 void OpenFunscripter::ScriptTimelineActionClicked(const FunscriptActionClickedEvent* ev) noexcept
@@ -1587,7 +1592,7 @@ void OpenFunscripter::Step() noexcept
 
             specialFunctions->ShowFunctionsWindow(&ofsState.showSpecialFunctions);
             undoSystem->ShowUndoRedoHistory(&ofsState.showHistory);
-            simulator.ShowSimulator(&ofsState.showSimulator, ActiveFunscript(), player->CurrentTime(), overlayState.SplineMode);
+            simulator.ShowSimulator(&ofsState.showSimulator, ActiveFunscript(), player->CurrentTime(), overlayState.SplineMode());
 
             if (ShowMetadataEditor) {
                 auto& projectState = LoadedProject->State();
@@ -1606,7 +1611,9 @@ void OpenFunscripter::Step() noexcept
             keys->RenderKeybindingWindow();
             chapterMgr->ShowWindow(&ofsState.showChapterManager);
 
-            if (preferences->ShowPreferenceWindow()) {}
+            if (preferences->ShowPreferenceWindow()) {
+                player->SetFrameBufferMemory(PreferenceState::State(preferences->StateHandle()).frameBufferMemoryMb);
+            }
 
             playerControls.DrawControls();
 
@@ -1671,6 +1678,7 @@ void OpenFunscripter::Step() noexcept
             if (DebugMetrics) {
                 ImGui::ShowMetricsWindow(&DebugMetrics);
             }
+            EV::ShowStatsWindow(&DebugEventStats);
 
             playerWindow->DrawVideoPlayer(NULL, &ofsState.showVideo);
         }
@@ -1735,10 +1743,12 @@ void OpenFunscripter::Shutdown() noexcept
     // NOTE: Do not free the GL context before these players
     player.reset();
     playerControls.videoPreview.reset();
+    playerControls.Thumbnails.reset();
     OFS_MpvLoader::Unload();
     OFS_FileLogger::Shutdown();
     webApi->Shutdown();
     controllerInput->Shutdown();
+    FunscriptLineCache::Shutdown();
 
     SDL_GL_DeleteContext(glContext);
     SDL_DestroyWindow(window);
@@ -2569,6 +2579,7 @@ void OpenFunscripter::ShowMainMenuBar() noexcept
             ImGui::Separator();
             if (ImGui::BeginMenu(TR(DEBUG))) {
                 if (ImGui::MenuItem(TR(METRICS), NULL, &DebugMetrics)) {}
+                if (ImGui::MenuItem(TR(EVENT_STATISTICS), NULL, &DebugEventStats)) {}
                 if (ImGui::MenuItem(TR(LOG_OUTPUT), NULL, &ofsState.showDebugLog)) {}
 #ifndef NDEBUG
                 if (ImGui::MenuItem("ImGui Demo", NULL, &DebugDemo)) {}
@@ -2603,9 +2614,22 @@ void OpenFunscripter::ShowMainMenuBar() noexcept
             if (ImGui::MenuItem(TR(DEV_MODE), NULL, &OFS_LuaExtensions::DevMode)) {}
             OFS::Tooltip(TR(DEV_MODE_TOOLTIP));
             if (ImGui::MenuItem(TR(SHOW_LOGS), NULL, &OFS_LuaExtensions::ShowLogs)) {}
+            if (ImGui::MenuItem(TR(LAZY_LOADING), NULL, &OFS_LuaExtensions::LazyLoading)) {}
+            OFS::Tooltip(TR(LAZY_LOADING_TOOLTIP));
             if (ImGui::MenuItem(TR(EXTENSION_DIR))) {
                 Util::OpenFileExplorer(Util::Prefpath(OFS_LuaExtensions::ExtensionDir));
             }
+            ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6.f);
+            int instructionBudget = OFS_LuaExtensions::InstructionBudget;
+            if (ImGui::InputInt(TR(INSTRUCTION_BUDGET), &instructionBudget, 10, 100)) {
+                OFS_LuaExtensions::InstructionBudget = std::max(instructionBudget, 0);
+            }
+            OFS::Tooltip(TR(INSTRUCTION_BUDGET_TOOLTIP));
+            ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6.f);
+            if (ImGui::InputFloat(TR(UPDATE_BUDGET), &OFS_LuaExtensions::UpdateBudgetMs, 1.f, 5.f, "%.1f")) {
+                OFS_LuaExtensions::UpdateBudgetMs = std::max(OFS_LuaExtensions::UpdateBudgetMs, 0.f);
+            }
+            OFS::Tooltip(TR(UPDATE_BUDGET_TOOLTIP));
             ImGui::Separator();
             for (auto& ext : extensions->Extensions) {
                 if (ImGui::BeginMenu(ext.NameId.c_str())) {
@@ -2620,6 +2644,19 @@ void OpenFunscripter::ShowMainMenuBar() noexcept
                     if (ImGui::MenuItem(Util::Format(TR(OPEN_DIRECTORY), ext.NameId.c_str()), NULL)) {
                         Util::OpenFileExplorer(ext.Directory);
                     }
+                    if (ext.Active) {
+                        ImGui::Separator();
+                        if (ext.Deferred()) {
+                            ImGui::TextDisabled("%s", TR(NOT_LOADED_YET));
+                        }
+                        if (ext.Suspended) {
+                            ImGui::TextColored(ImColor(IM_COL32(255, 0, 0, 255)), "%s", TR(SUSPENDED));
+                            if (ImGui::MenuItem(TR(RESUME))) {
+                                ext.Resume();
+                            }
+                        }
+                        ext.ShowTimings();
+                    }
                     ImGui::EndMenu();
                 }
             }
@@ -47,6 +47,7 @@ private:
     bool DebugDemo = false;
 #endif
     bool DebugMetrics = false;
+    bool DebugEventStats = false;
     bool ShowAbout = false;
     bool IdleMode = false;
     uint32_t IdleTimer = 0;
@@ -166,6 +166,11 @@ bool OFS_Preferences::ShowPreferenceWindow() noexcept
 						save = true;
 					}
 					OFS::Tooltip(TR(FORCE_HW_DECODING_TOOLTIP));
+					if (ImGui::InputInt(TR(FRAME_BUFFER_MEMORY), &state.frameBufferMemoryMb, 64, 256)) {
+						save = true;
+						state.frameBufferMemoryMb = Util::Clamp<int32_t>(state.frameBufferMemoryMb, 0, 4096);
+					}
+					OFS::Tooltip(TR(FRAME_BUFFER_MEMORY_TOOLTIP));
 					ImGui::EndTabItem();
 				}
 				if (ImGui::BeginTabItem(TR(SCRIPTING)))
@@ -47,6 +47,7 @@ void FrameOverlay::DrawScriptPositionContent(const OverlayDrawingCtx& ctx) noexc
     timeline->DrawAudioWaveform(ctx);
     BaseOverlay::DrawActionLines(ctx);
     BaseOverlay::DrawActionPoints(ctx);
+    BaseOverlay::DrawPendingSamples(ctx);
     BaseOverlay::DrawSecondsLabel(ctx);
     BaseOverlay::DrawScriptLabel(ctx);
  
@@ -201,6 +202,7 @@ void TempoOverlay::DrawScriptPositionContent(const OverlayDrawingCtx& ctx) noexc
 
     BaseOverlay::DrawActionLines(ctx);
     BaseOverlay::DrawActionPoints(ctx);
+    BaseOverlay::DrawPendingSamples(ctx);
 }
 
 static float GetNextPosition(float beatTime, float currentTime, float beatOffset) noexcept
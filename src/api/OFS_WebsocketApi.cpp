@@ -22,6 +22,7 @@ struct CivetwebContext
     mg_context* web = nullptr;
 	char errtxtbuf[256] = {0};
 	SDL_atomic_t clientsConnected = {0};
+	EventSerializationContext* serialization = nullptr;
 };
 
 #define CTX static_cast<CivetwebContext*>(ctx)
@@ -30,14 +31,14 @@ static const char WS_URL[] = "/ofs";
 
 /* Define websocket sub-protocols. */
 /* This must be static data, available between mg_start and mg_stop. */
-static const char* subprotocols[] = {"ofs-api.json", NULL};
-static struct mg_websocket_subprotocols wsprot = {1, subprotocols};
+static const char* subprotocols[] = {"ofs-api.json", "ofs-api.cbor", NULL};
+static struct mg_websocket_subprotocols wsprot = {2, subprotocols};
 
 /* Handler for new websocket connections. */
 static int ws_connect_handler(const struct mg_connection *conn, void *ctx) noexcept
 {
 	/* Allocate data for websocket client context, and initialize context. */
-    auto clientCtx = new OFS_WebsocketClient();
+    auto clientCtx = new std::shared_ptr<OFS_WebsocketClient>(std::make_shared<OFS_WebsocketClient>());
 	if (!clientCtx) {
 		/* reject client */
 		return 1;
@@ -55,13 +56,12 @@ static int ws_connect_handler(const struct mg_connection *conn, void *ctx) noexc
 }
 
 /* Handler indicating the client is ready to receive data. */
-static void ws_ready_handler(struct mg_connection *conn, void *user_data) noexcept
+static void ws_ready_handler(struct mg_connection *conn, void *ctx) noexcept
 {
-	(void)user_data; /* unused */
-
 	/* Get websocket client context information. */
-	auto clientCtx = (OFS_WebsocketClient*)mg_get_user_connection_data(conn);
-	clientCtx->InitializeConnection(conn);
+	auto clientCtx = (std::shared_ptr<OFS_WebsocketClient>*)mg_get_user_connection_data(conn);
+	(*clientCtx)->InitializeConnection(conn);
+	CTX->serialization->AddClient(*clientCtx);
 
 	// const struct mg_request_info *ri = mg_get_request_info(conn);
 
@@ -80,17 +80,21 @@ static int ws_data_handler(struct mg_connection *conn,
 	(void)user_data; /* unused */
 
 	/* Get websocket client context information. */
-	auto clientCtx = (OFS_WebsocketClient*)mg_get_user_connection_data(conn);
+	auto clientCtx = (std::shared_ptr<OFS_WebsocketClient>*)mg_get_user_connection_data(conn);
 	// const struct mg_request_info *ri = mg_get_request_info(conn);
 
+	// returning 0 makes civetweb close the connection, nothing gets written to a disconnecting client
+	if ((*clientCtx)->Disconnecting()) return 0;
+
 	const char *messageType = "";
 	switch (opcode & 0xf) {
 	case MG_WEBSOCKET_OPCODE_TEXT:
 		messageType = "text";
-		clientCtx->ReceiveText(data, datasize);
+		(*clientCtx)->ReceiveText(data, datasize);
 		break;
 	case MG_WEBSOCKET_OPCODE_BINARY:
 		messageType = "binary";
+		(*clientCtx)->ReceiveBinary(data, datasize);
 		break;
 	case MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE:
 		messageType = "conn_close";
@@ -113,12 +117,16 @@ static int ws_data_handler(struct mg_connection *conn,
 static void ws_close_handler(const struct mg_connection *conn, void *ctx) noexcept
 {
 	/* Get websocket client context information. */
-	auto clientCtx = (OFS_WebsocketClient*)mg_get_user_connection_data(conn);
+	auto clientCtx = (std::shared_ptr<OFS_WebsocketClient>*)mg_get_user_connection_data(conn);
 
 	/* DEBUG: Client has left. */
 	LOG_INFO("Client closing connection\n");
 	SDL_AtomicDecRef(&CTX->clientsConnected);
 
+	// the writer may still be blocked in a write, it checks the connection before the next one
+	(*clientCtx)->Close();
+	CTX->serialization->RemoveClient(*clientCtx);
+
 	/* Free memory allocated for client context in ws_connect_handler() call. */
     delete clientCtx;
 }
@@ -128,22 +136,78 @@ static int EventSerializationThread(void* user) noexcept
 	auto ctx = static_cast<EventSerializationContext*>(user);
 	auto waitMut = SDL_CreateMutex();
 	SDL_LockMutex(waitMut);
+	std::vector<WsOutgoingEvent> events;
+	// time until a held back time update is due, 0 if there is none
+	uint32_t throttleWaitMs = 0;
 	while(!ctx->shouldExit)
 	{
-		if(SDL_CondWait(ctx->processCond, waitMut) == 0)
+		int waitResult = throttleWaitMs > 0
+			? SDL_CondWaitTimeout(ctx->processCond, waitMut, throttleWaitMs)
+			: SDL_CondWait(ctx->processCond, waitMut);
+		if(waitResult >= 0)
 		{
 			SDL_AtomicLock(&ctx->eventLock);
-			for(auto& ev : ctx->events)
+			events.swap(ctx->events);
+			SDL_AtomicUnlock(&ctx->eventLock);
+
+			// every event is serialized once per encoding and shared by all clients
+			auto clients = ctx->Clients();
+			WsClientList receivers;
+			for(auto& outgoing : events)
 			{
-				auto toJson = dynamic_cast<ToJsonInterface*>(ev.get());
-				nlohmann::json json;
-				toJson->Serialize(json);
-				auto jsonText = Util::SerializeJson(json);
-				EV::Queue().directDispatch(WsSerializedEvent::EventType, 
-					std::move(EV::Make<WsSerializedEvent>(std::move(jsonText))));
+				auto toJson = dynamic_cast<ToJsonInterface*>(outgoing.event.get());
+				uint32_t subscription = toJson->Subscription();
+				uint64_t scriptKey = toJson->ScriptKey();
+
+				receivers.clear();
+				bool needsText = false;
+				bool needsBinary = false;
+				bool broadcast = outgoing.targets.empty();
+				for(auto& client : broadcast ? clients : outgoing.targets)
+				{
+					// the client didn't receive the full state yet
+					if(broadcast && outgoing.seq < client->SyncedFromSeq) continue;
+					if(!client->Wants(subscription, scriptKey)) continue;
+					needsBinary |= client->Binary;
+					needsText |= !client->Binary;
+					receivers.emplace_back(client);
+				}
+				// nobody subscribed, skip serializing it
+				if(receivers.empty()) continue;
+
+				auto msg = std::make_shared<WsMessage>();
+				msg->policy = toJson->QueuePolicy();
+				msg->key = toJson->QueueKey();
+				if(needsText)
+				{
+					nlohmann::json json;
+					toJson->Serialize(json);
+					msg->text = Util::SerializeJson(json);
+				}
+				if(needsBinary)
+				{
+					nlohmann::json json;
+					toJson->SerializeBinary(json);
+					msg->binary = Util::SerializeCBOR(json);
+				}
+
+				WsMessagePtr sharedMsg = std::move(msg);
+				uint32_t now = SDL_GetTicks();
+				for(auto& client : receivers)
+				{
+					if(subscription == WsSub_Time) client->SendThrottled(sharedMsg, now);
+					else client->Send(sharedMsg);
+				}
+			}
+			events.clear();
+
+			throttleWaitMs = 0;
+			uint32_t now = SDL_GetTicks();
+			for(auto& client : clients)
+			{
+				uint32_t dueMs = client->FlushThrottled(now);
+				if(dueMs > 0 && (throttleWaitMs == 0 || dueMs < throttleWaitMs)) throttleWaitMs = dueMs;
 			}
-			ctx->events.clear();
-			SDL_AtomicUnlock(&ctx->eventLock);
 		}
 	}
 	SDL_DestroyMutex(waitMut);
@@ -155,6 +219,7 @@ OFS_WebsocketApi::OFS_WebsocketApi() noexcept
 {
 	stateHandle = OFS_AppState<WebsocketApiState>::Register(WebsocketApiState::StateName);
 	eventSerializationCtx = std::make_unique<EventSerializationContext>();
+	positionStream = std::make_unique<OFS_WebsocketPositionStream>(eventSerializationCtx.get());
 
 	auto serializationThread = SDL_CreateThread(
 		EventSerializationThread, "WebsocketEventSerialization", eventSerializationCtx.get());
@@ -186,6 +251,7 @@ OFS_WebsocketApi::OFS_WebsocketApi() noexcept
 			if(ClientsConnected() > 0 && ev->playerType == VideoplayerType::Main)
 			{
 				eventSerializationCtx->Push<WsPlaybackSpeedChange>(ev->playbackSpeed);
+				updateStreamClock();
 			}
 		}
 	));
@@ -196,6 +262,7 @@ OFS_WebsocketApi::OFS_WebsocketApi() noexcept
 			if(ClientsConnected() > 0 && ev->playerType == VideoplayerType::Main)
 			{
 				eventSerializationCtx->Push<WsPlayChange>(!ev->paused);
+				updateStreamClock();
 			}
 		}
 	));
@@ -206,6 +273,7 @@ OFS_WebsocketApi::OFS_WebsocketApi() noexcept
 			if(ClientsConnected() > 0 && ev->playerType == VideoplayerType::Main)
 			{
 				eventSerializationCtx->Push<WsTimeChange>(ev->time);
+				updateStreamClock();
 			}
 		}
 	));
@@ -213,11 +281,12 @@ OFS_WebsocketApi::OFS_WebsocketApi() noexcept
 	EV::Queue().appendListener(ProjectLoadedEvent::EventType, ProjectLoadedEvent::HandleEvent(
 		[this](const ProjectLoadedEvent* ev) noexcept
 		{
+			// the scripts of the previous project are gone
+			mirrors.clear();
+			positionStream->ClearScripts();
 			if(ClientsConnected() > 0) 
 			{
-				// WsProjectChange remains handled by each internal client 
-				// this makes this event really expensive depending on the number of connected clients
-				EV::Queue().directDispatch(WsProjectChange::EventType, EV::Make<WsProjectChange>());
+				pushFullState({});
 			}
 		}
 	));
@@ -228,10 +297,23 @@ OFS_WebsocketApi::OFS_WebsocketApi() noexcept
 			if(ClientsConnected() > 0)
 			{
 				// Funscript name changes are handled as the old name being removed and the new one added
-				auto app = OpenFunscripter::ptr;
-				auto& projectState = app->LoadedProject->State();
 				eventSerializationCtx->Push<WsFunscriptRemove>(ev->oldName);
-				eventSerializationCtx->Push<WsFunscriptChange>(ev->Script->Title(), ev->Script->Data(), projectState.metadata);
+				positionStream->RemoveScript(ev->oldName);
+				auto it = std::find_if(mirrors.begin(), mirrors.end(),
+					[ev](auto& mirror) noexcept { return mirror.script == ev->Script; });
+				if(it != mirrors.end())
+				{
+					// no delta, the clients get the whole script under the new name
+					it->name = ev->Script->Title();
+					it->actions = ev->Script->Data().Actions;
+					it->version += 1;
+					if(positionStream->Active()) positionStream->SetScript(it->name, it->actions);
+					pushFullScript(*it, {});
+				}
+				else
+				{
+					pushFullScript(syncMirror(*ev->Script, false), {});
+				}
 			}
 		}
 	));
@@ -271,6 +353,9 @@ OFS_WebsocketApi::OFS_WebsocketApi() noexcept
 	EV::Queue().appendListener(FunscriptRemovedEvent::EventType, FunscriptRemovedEvent::HandleEvent(
 		[this](const FunscriptRemovedEvent* ev) noexcept
 		{
+			mirrors.erase(std::remove_if(mirrors.begin(), mirrors.end(),
+				[ev](auto& mirror) noexcept { return mirror.name == ev->name; }), mirrors.end());
+			positionStream->RemoveScript(ev->name);
 			if(ClientsConnected() > 0)
 			{
 				eventSerializationCtx->Push<WsFunscriptRemove>(ev->name);
@@ -281,25 +366,157 @@ OFS_WebsocketApi::OFS_WebsocketApi() noexcept
 	EV::Queue().appendListener(FunscriptActionsChangedEvent::EventType, FunscriptActionsChangedEvent::HandleEvent(
 		[this](const FunscriptActionsChangedEvent* ev) noexcept
 		{
+			auto mirror = std::find_if(mirrors.begin(), mirrors.end(),
+				[Script = ev->Script](auto& mirror) noexcept { return mirror.script == Script; });
+			if(mirror != mirrors.end())
+			{
+				mirror->dirtyStart = std::min(mirror->dirtyStart, ev->DirtyStartTime);
+				mirror->dirtyEnd = std::max(mirror->dirtyEnd, ev->DirtyEndTime);
+			}
+
 			if(ClientsConnected() > 0)
 			{
+				// edits are sent right away as deltas, they're already coalesced per frame
 				auto app = OpenFunscripter::ptr;
 				auto it = std::find_if(app->LoadedFunscripts().begin(), app->LoadedFunscripts().end(), 
 					[Script = ev->Script](auto& script) noexcept { return script.get() == Script; });
 
 				if(it != app->LoadedFunscripts().end())
 				{
-					auto scriptIdx = std::distance(app->LoadedFunscripts().begin(), it);
-					if(scriptIdx + 1 > this->scriptUpdateCooldown.size()) {
-						scriptUpdateCooldown.resize(scriptIdx + 1, 0);
-					}
-					scriptUpdateCooldown[scriptIdx] = SDL_GetTicks();
+					syncMirror(**it, true);
 				}
 			}
 		}
 	));
 }
 
+void OFS_WebsocketApi::pushFullState(const WsClientList& targets) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto app = OpenFunscripter::ptr;
+	auto& ctx = *eventSerializationCtx;
+
+	// clients which are already synced need the pending changes
+	for(auto& script : app->LoadedFunscripts())
+	{
+		syncMirror(*script, false);
+	}
+	if(!targets.empty()) ctx.MarkSynced(targets);
+
+	ctx.PushTo<WsProjectChange>(targets);
+	ctx.PushTo<WsMediaChange>(targets, app->player->VideoPath());
+	ctx.PushTo<WsPlaybackSpeedChange>(targets, app->player->CurrentSpeed());
+	ctx.PushTo<WsPlayChange>(targets, !app->player->IsPaused());
+	ctx.PushTo<WsDurationChange>(targets, app->player->Duration());
+	ctx.PushTo<WsTimeChange>(targets, app->player->CurrentPlayerTime());
+
+	for(auto& script : app->LoadedFunscripts())
+	{
+		pushFullScript(syncMirror(*script, false), targets);
+	}
+}
+
+void OFS_WebsocketApi::pushFullScript(const ScriptMirror& mirror, const WsClientList& targets) noexcept
+{
+	auto app = OpenFunscripter::ptr;
+	auto& projectState = app->LoadedProject->State();
+	Funscript::FunscriptData data;
+	data.Actions = mirror.actions;
+	eventSerializationCtx->PushTo<WsFunscriptChange>(targets, mirror.name, std::move(data), projectState.metadata, mirror.version);
+}
+
+OFS_WebsocketApi::ScriptMirror& OFS_WebsocketApi::syncMirror(const Funscript& script, bool announceNew) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto it = std::find_if(mirrors.begin(), mirrors.end(),
+		[&script](auto& mirror) noexcept { return mirror.script == &script; });
+	if(it == mirrors.end())
+	{
+		auto& mirror = mirrors.emplace_back();
+		mirror.script = &script;
+		mirror.name = script.Title();
+		mirror.actions = script.Data().Actions;
+		mirror.version = 1;
+		if(positionStream->Active()) positionStream->SetScript(mirror.name, mirror.actions);
+		if(announceNew) pushFullScript(mirror, {});
+		return mirror;
+	}
+
+	auto& mirror = *it;
+	if(mirror.dirtyStart > mirror.dirtyEnd) return mirror;
+
+	// outside of the dirty range the mirror is up to date
+	auto& actions = script.Data().Actions;
+	const FunscriptAction startAction(mirror.dirtyStart, 0);
+	const FunscriptAction endAction(mirror.dirtyEnd, 0);
+	mirror.dirtyStart = std::numeric_limits<float>::max();
+	mirror.dirtyEnd = std::numeric_limits<float>::lowest();
+	auto oldBegin = mirror.actions.lower_bound(startAction);
+	auto oldEnd = mirror.actions.upper_bound(endAction);
+	auto newBegin = actions.lower_bound(startAction);
+	auto newEnd = actions.upper_bound(endAction);
+	if(std::equal(oldBegin, oldEnd, newBegin, newEnd)) return mirror;
+
+	auto delta = EV::MakeTyped<WsFunscriptDelta>(mirror.name, mirror.version, mirror.version + 1);
+	if(oldBegin != oldEnd)
+	{
+		delta->hasRemoved = true;
+		delta->removeFrom = oldBegin->atS;
+		delta->removeTo = (oldEnd - 1)->atS;
+	}
+	delta->inserted.assign(newBegin, newEnd);
+	auto insertAt = mirror.actions.erase(oldBegin, oldEnd);
+	mirror.actions.insert(insertAt, newBegin, newEnd);
+	mirror.version += 1;
+	if(positionStream->Active()) positionStream->UpdateScript(mirror.name, startAction.atS, endAction.atS, newBegin, newEnd);
+
+	// large changes like loading a script are cheaper to send in full
+	if(delta->inserted.size() > 64 && delta->inserted.size() > actions.size() / 2)
+	{
+		pushFullScript(mirror, {});
+	}
+	else
+	{
+		eventSerializationCtx->Push(std::move(delta));
+	}
+	return mirror;
+}
+
+void OFS_WebsocketApi::updateStreamClock() noexcept
+{
+	if(!positionStream->Active()) return;
+	auto app = OpenFunscripter::ptr;
+	positionStream->SetClock(app->player->CurrentPlayerTime(), app->player->CurrentSpeed(), !app->player->IsPaused());
+}
+
+void OFS_WebsocketApi::StartPositionStream(const std::shared_ptr<OFS_WebsocketClient>& client, std::vector<std::string> scripts, 
+	float rate, OFS_WebsocketPositionStream::Interpolation interpolation) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	positionStream->Start(client, std::move(scripts), rate, interpolation);
+	if(!positionStream->Active()) return;
+
+	// the snapshots are only kept up to date while streaming
+	auto app = OpenFunscripter::ptr;
+	for(auto& script : app->LoadedFunscripts())
+	{
+		auto& mirror = syncMirror(*script, false);
+		positionStream->SetScript(mirror.name, mirror.actions);
+	}
+	updateStreamClock();
+}
+
+void OFS_WebsocketApi::ResyncFunscripts(const std::shared_ptr<OFS_WebsocketClient>& client, const std::string& scriptName) noexcept
+{
+	for(auto& mirror : mirrors)
+	{
+		if(scriptName.empty() || mirror.name == scriptName)
+		{
+			pushFullScript(mirror, { client });
+		}
+	}
+}
+
 int OFS_WebsocketApi::ClientsConnected() const noexcept
 {
 	return SDL_AtomicGet(&CTX->clientsConnected);
@@ -309,10 +526,12 @@ bool OFS_WebsocketApi::Init() noexcept
 {
     if(ctx) return true;
     ctx = new CivetwebContext();
+	CTX->serialization = eventSerializationCtx.get();
     if(mg_init_library(0) != 0)
         return false;
 
 	auto& state = WebsocketApiState::State(stateHandle);
+	OFS_WebsocketClient::MaxLagMs = state.maxClientLagMs;
 	if(state.serverActive) StartServer();
 
     return true;
@@ -337,6 +556,7 @@ bool OFS_WebsocketApi::StartServer() noexcept
 	mg_start_error_data.text = CTX->errtxtbuf;
 	mg_start_error_data.text_buffer_size = sizeof(CTX->errtxtbuf);
 
+	OFS_WebsocketClient::AllowWriters();
 	CTX->web = mg_start2(&mg_start_init_data, &mg_start_error_data);
     if(!CTX->web)
         return false;
@@ -357,6 +577,8 @@ void OFS_WebsocketApi::StopServer() noexcept
 {
 	if(CTX->web)
 	{
+		// the writers lock their connection, civetweb frees it in mg_stop
+		OFS_WebsocketClient::StopWriters(eventSerializationCtx->Clients());
 		mg_stop(CTX->web);
 		CTX->web = nullptr;
 	}
@@ -366,18 +588,27 @@ void OFS_WebsocketApi::Update() noexcept
 {
 	if(ClientsConnected() <= 0) return;
 
+	// new clients get the whole state
+	WsClientList newClients;
+	for(auto& client : eventSerializationCtx->Clients())
+	{
+		client->CheckLag();
+		if(client->NeedsFullState.exchange(false)) newClients.emplace_back(client);
+	}
+	if(!newClients.empty()) pushFullState(newClients);
+
 	for(int i=0, size=scriptUpdateCooldown.size(); i < size; i += 1)
 	{
 		auto& cd = scriptUpdateCooldown[i];
 		if(cd == 0) continue;
 		if(SDL_GetTicks() - cd >= 200)
 		{
+			// metadata and chapters are only part of the full script
 			auto app = OpenFunscripter::ptr;
 			if(i >= 0 && i < app->LoadedFunscripts().size())
 			{
-				auto& projectState = app->LoadedProject->State();
 				auto& script = app->LoadedFunscripts()[i];
-				eventSerializationCtx->Push<WsFunscriptChange>(script->Title(), script->Data(), projectState.metadata);
+				pushFullScript(syncMirror(*script, false), {});
 				LOGF_DEBUG("[WsFunscriptChange]: ScriptIdx: %d", i);
 			}
 			cd = 0;
@@ -394,6 +625,7 @@ void OFS_WebsocketApi::Update() noexcept
 
 void OFS_WebsocketApi::Shutdown() noexcept
 {
+	positionStream->Shutdown();
 	eventSerializationCtx->Shutdown();
 	StopServer();
     mg_exit_library();
@@ -441,5 +673,50 @@ void OFS_WebsocketApi::ShowWindow(bool* open) noexcept
 		}
 	}
 
+	if(ImGui::InputInt(TR(MAX_CLIENT_LAG), &state.maxClientLagMs, 100, 1000))
+	{
+		state.maxClientLagMs = std::max(state.maxClientLagMs, 100);
+		OFS_WebsocketClient::MaxLagMs = state.maxClientLagMs;
+	}
+
+	auto clients = eventSerializationCtx->Clients();
+	if(!clients.empty() && ImGui::BeginTable("##WebsocketClients", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn(TR(ADDRESS));
+		ImGui::TableSetupColumn(TR(PROTOCOL));
+		ImGui::TableSetupColumn(TR(QUEUED));
+		ImGui::TableSetupColumn(TR(MAXIMUM));
+		ImGui::TableSetupColumn(TR(LAG_MS));
+		ImGui::TableSetupColumn(TR(MAXIMUM));
+		ImGui::TableSetupColumn(TR(SENT));
+		ImGui::TableSetupColumn(TR(COMBINED));
+		ImGui::TableHeadersRow();
+		for(auto& client : clients)
+		{
+			auto& stats = client->Stats;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if(client->Disconnecting()) 
+				ImGui::TextColored(ImVec4(1.f, 0.f, 0.f, 1.f), "%s (%s)", client->Address.c_str(), TR(DISCONNECTING));
+			else 
+				ImGui::TextUnformatted(client->Address.c_str());
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(client->Binary ? "cbor" : "json");
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", stats.queued.load());
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", stats.maxQueued.load());
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", stats.lagMs.load());
+			ImGui::TableNextColumn();
+			ImGui::Text("%u", stats.maxLagMs.load());
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu (%s)", (unsigned long long)stats.sent.load(), Util::FormatBytes(stats.sentBytes.load()));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.combined.load());
+		}
+		ImGui::EndTable();
+	}
+
 	ImGui::End();
 }
\ No newline at end of file
@@ -3,14 +3,29 @@
 #include <cstdint>
 #include <vector>
 #include <memory>
-#include <vector>
 #include <atomic>
+#include <algorithm>
+#include <string>
+#include <limits>
 
 #include "SDL_thread.h"
 #include "SDL_atomic.h"
 #include "SDL_timer.h"
 
-#include "OFS_Event.h"
+#include "OFS_EventSystem.h"
+#include "FunscriptAction.h"
+#include "OFS_WebsocketPositionStream.h"
+
+class OFS_WebsocketClient;
+using WsClientList = std::vector<std::shared_ptr<OFS_WebsocketClient>>;
+
+struct WsOutgoingEvent
+{
+    EventPointer event;
+    // empty means every client
+    WsClientList targets;
+    uint64_t seq;
+};
 
 struct EventSerializationContext
 {
@@ -20,21 +35,42 @@ struct EventSerializationContext
     std::atomic<bool> hasExited = false;
 
     SDL_SpinLock eventLock = {0};
-    std::vector<EventPointer> events;
+    std::vector<WsOutgoingEvent> events;
+    uint64_t nextSeq = 0;
+
+    SDL_SpinLock clientsLock = {0};
+    WsClientList clients;
 
     EventSerializationContext() noexcept
     {
         processCond = SDL_CreateCond();
     }
 
-    template<typename T, typename... Args>
-    inline void Push(Args&&... args) noexcept
+    // for events which get filled in after construction
+    inline void PushTo(const WsClientList& targets, EventPointer&& event) noexcept
     {
         SDL_AtomicLock(&eventLock);
-        events.emplace_back(std::move(std::make_shared<T>(std::forward<Args>(args)...)));
+        events.emplace_back(WsOutgoingEvent{ std::move(event), targets, nextSeq++ });
         SDL_AtomicUnlock(&eventLock);
     }
 
+    inline void Push(EventPointer&& event) noexcept
+    {
+        PushTo({}, std::move(event));
+    }
+
+    template<typename T, typename... Args>
+    inline void Push(Args&&... args) noexcept
+    {
+        PushTo({}, EV::Make<T>(std::forward<Args>(args)...));
+    }
+
+    template<typename T, typename... Args>
+    inline void PushTo(const WsClientList& targets, Args&&... args) noexcept
+    {
+        PushTo(targets, EV::Make<T>(std::forward<Args>(args)...));
+    }
+
     inline bool EventsEmpty() noexcept
     {
         SDL_AtomicLock(&eventLock);
@@ -43,6 +79,37 @@ struct EventSerializationContext
         return empty;
     }
 
+    // The clients receive broadcasts pushed from now on.
+    template<typename ClientList>
+    inline void MarkSynced(const ClientList& targets) noexcept
+    {
+        SDL_AtomicLock(&eventLock);
+        for(auto& client : targets) client->SyncedFromSeq = nextSeq;
+        SDL_AtomicUnlock(&eventLock);
+    }
+
+    inline void AddClient(const std::shared_ptr<OFS_WebsocketClient>& client) noexcept
+    {
+        SDL_AtomicLock(&clientsLock);
+        clients.emplace_back(client);
+        SDL_AtomicUnlock(&clientsLock);
+    }
+
+    inline void RemoveClient(const std::shared_ptr<OFS_WebsocketClient>& client) noexcept
+    {
+        SDL_AtomicLock(&clientsLock);
+        clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+        SDL_AtomicUnlock(&clientsLock);
+    }
+
+    inline WsClientList Clients() noexcept
+    {
+        SDL_AtomicLock(&clientsLock);
+        auto copy = clients;
+        SDL_AtomicUnlock(&clientsLock);
+        return copy;
+    }
+
     inline int StartProcessing() noexcept
     {
         return SDL_CondSignal(processCond);
@@ -59,13 +126,37 @@ struct EventSerializationContext
     }
 };
 
+class Funscript;
+
 class OFS_WebsocketApi
 {
     private:
+    // The actions clients were sent last, deltas are computed against these.
+    struct ScriptMirror
+    {
+        const Funscript* script = nullptr;
+        std::string name;
+        FunscriptArray actions;
+        uint32_t version = 0;
+        // time range of the changes since the last sync
+        float dirtyStart = std::numeric_limits<float>::max();
+        float dirtyEnd = std::numeric_limits<float>::lowest();
+    };
+
     void* ctx = nullptr;
     uint32_t stateHandle = 0xFFFF'FFFF;
     std::vector<uint32_t> scriptUpdateCooldown;
+    std::vector<ScriptMirror> mirrors;
     std::unique_ptr<EventSerializationContext> eventSerializationCtx;
+    std::unique_ptr<OFS_WebsocketPositionStream> positionStream;
+
+    // Main thread only. The state gets copied here and serialized on the serialization thread.
+    void pushFullState(const WsClientList& targets) noexcept;
+    void pushFullScript(const ScriptMirror& mirror, const WsClientList& targets) noexcept;
+    // Broadcasts the changes since the last sync as a delta.
+    // New scripts are only broadcast in full when announceNew is set.
+    ScriptMirror& syncMirror(const Funscript& script, bool announceNew) noexcept;
+    void updateStreamClock() noexcept;
 
     public:
     OFS_WebsocketApi() noexcept;
@@ -82,4 +173,8 @@ class OFS_WebsocketApi
     void Shutdown() noexcept;
 
     int ClientsConnected() const noexcept;
+    void ResyncFunscripts(const std::shared_ptr<OFS_WebsocketClient>& client, const std::string& scriptName) noexcept;
+    // Replaces the position stream of the client. No scripts stop it.
+    void StartPositionStream(const std::shared_ptr<OFS_WebsocketClient>& client, std::vector<std::string> scripts, 
+        float rate, OFS_WebsocketPositionStream::Interpolation interpolation) noexcept;
 };
\ No newline at end of file
@@ -1,8 +1,6 @@
 #include "OFS_WebsocketApiClient.h"
 #include "OFS_WebsocketApiEvents.h"
 
-#include "OFS_EventSystem.h"
-
 #include "OFS_Profiling.h"
 #include "OFS_Util.h"
 #include "nlohmann/json.hpp"
@@ -10,113 +8,320 @@
 #include "civetweb.h"
 #include "OpenFunscripter.h"
 
+#include "SDL_thread.h"
+#include "SDL_timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
 WsCommandBuffer OFS_WebsocketClient::CommandBuffer = WsCommandBuffer();
+std::atomic<uint32_t> OFS_WebsocketClient::MaxLagMs = 5000;
+std::atomic<int32_t> OFS_WebsocketClient::runningWriters = 0;
+std::atomic<bool> OFS_WebsocketClient::writersStopped = false;
+
+template<typename T>
+inline static void atomicMax(std::atomic<T>& value, T newValue) noexcept
+{
+    T current = value.load(std::memory_order_relaxed);
+    while(current < newValue && !value.compare_exchange_weak(current, newValue, std::memory_order_relaxed)) {}
+}
 
 OFS_WebsocketClient::OFS_WebsocketClient() noexcept
 {
     LOG_DEBUG("Created new websocket client.");
-    std::vector<UnsubscribeFn> eventUnsubs;
-    eventUnsubs.emplace_back(
-        EV::MakeUnsubscibeFn(WsSerializedEvent::EventType, 
-            EV::Queue().appendListener(WsSerializedEvent::EventType, WsSerializedEvent::HandleEvent(
-                EVENT_SYSTEM_BIND(this, &OFS_WebsocketClient::handleSerializedEvent)
-            ))
-        )
-    );
-
-    eventUnsubs.emplace_back(
-        EV::MakeUnsubscibeFn(WsProjectChange::EventType, 
-            EV::Queue().appendListener(WsProjectChange::EventType, WsProjectChange::HandleEvent(
-                EVENT_SYSTEM_BIND(this, &OFS_WebsocketClient::handleProjectChange)
-            ))
-        )
-    );
-
-    eventUnsub = [eventUnsubs = std::move(eventUnsubs)]()
-    {
-        for(auto& unsub : eventUnsubs) {
-            unsub();
-        }
-    };
+    sendCond = SDL_CreateCond();
 }
 
 OFS_WebsocketClient::~OFS_WebsocketClient() noexcept
 {
     LOG_DEBUG("Destroying websocket client.");
-    eventUnsub();   
+    Close();
+    SDL_DestroyCond(sendCond);
 }
 
-void OFS_WebsocketClient::sendMessage(const std::string& msg) noexcept
+void OFS_WebsocketClient::sendMessage(const WsMessage& msg) noexcept
 {
     OFS_PROFILE(__FUNCTION__);
-    if(conn == nullptr) return;
-    if(mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, msg.data(), msg.size()) < 0)
+    auto current = conn.load();
+    if(current == nullptr) return;
+    // civetweb locks the connection while closing it. once the close handler
+    // cleared conn the connection may already belong to another client.
+    mg_lock_connection(current);
+    if(conn.load() != current)
+    {
+        mg_unlock_connection(current);
+        return;
+    }
+    int result = Binary
+        ? mg_websocket_write(current, MG_WEBSOCKET_OPCODE_BINARY, (const char*)msg.binary.data(), msg.binary.size())
+        : mg_websocket_write(current, MG_WEBSOCKET_OPCODE_TEXT, msg.text.data(), msg.text.size());
+    mg_unlock_connection(current);
+    if(result > 0)
     {
-        LOG_ERROR("Failed to send websocket message.");
+        Stats.sent.fetch_add(1, std::memory_order_relaxed);
+        Stats.sentBytes.fetch_add(result, std::memory_order_relaxed);
+    }
+    else
+    {
+        disconnectLagging("failed to send a message");
     }
 }
 
-void OFS_WebsocketClient::handleSerializedEvent(const WsSerializedEvent* ev) noexcept
+int OFS_WebsocketClient::writerThread(void* user) noexcept
+{
+    // the writer keeps the client alive, the close handler doesn't wait for it
+    auto self = static_cast<std::shared_ptr<OFS_WebsocketClient>*>(user);
+    auto client = self->get();
+    auto waitMut = SDL_CreateMutex();
+    SDL_LockMutex(waitMut);
+
+    std::vector<WsMessagePtr> sending;
+    // a disconnecting client gets closed by civetweb, see ws_data_handler
+    while(!client->closing && !client->disconnecting && !writersStopped)
+    {
+        SDL_AtomicLock(&client->queueLock);
+        bool noWork = client->sendQueue.empty();
+        SDL_AtomicUnlock(&client->queueLock);
+
+        // the timeout guards against a signal sent before we started waiting
+        if(noWork) SDL_CondWaitTimeout(client->sendCond, waitMut, 100);
+
+        SDL_AtomicLock(&client->queueLock);
+        sending.swap(client->sendQueue);
+        uint32_t queuedAt = client->queueWaitingSince;
+        client->writing = !sending.empty();
+        client->writingSince = queuedAt;
+        client->Stats.queued = 0;
+        SDL_AtomicUnlock(&client->queueLock);
+
+        if(sending.empty()) continue;
+
+        for(auto& msg : sending)
+        {
+            if(client->closing || client->disconnecting || writersStopped) break;
+            client->sendMessage(*msg);
+        }
+        sending.clear();
+        SDL_AtomicLock(&client->queueLock);
+        client->writing = false;
+        SDL_AtomicUnlock(&client->queueLock);
+
+        // how long the oldest message of the batch took to be written
+        uint32_t lag = SDL_GetTicks() - queuedAt;
+        client->Stats.lagMs = lag;
+        atomicMax(client->Stats.maxLagMs, lag);
+    }
+
+    SDL_UnlockMutex(waitMut);
+    SDL_DestroyMutex(waitMut);
+    delete self;
+    runningWriters -= 1;
+    return 0;
+}
+
+void OFS_WebsocketClient::InitializeConnection(mg_connection* conn) noexcept
+{
+    if(this->conn.load()) return;
+    this->conn = conn;
+    auto ri = mg_get_request_info(conn);
+    Binary = ri->acceptedWebSocketSubprotocol && strcmp(ri->acceptedWebSocketSubprotocol, "ofs-api.cbor") == 0;
+    // Util::Format isn't thread safe
+    char address[64];
+    snprintf(address, sizeof(address), "%s:%d", ri->remote_addr, ri->remote_port);
+    Address = address;
+
+    /* Send "hello" message. */
+    nlohmann::json hello = { { "connected", "OFS " OFS_LATEST_GIT_TAG "@" OFS_LATEST_GIT_HASH } };
+    auto msg = std::make_shared<WsMessage>();
+    if(Binary) msg->binary = Util::SerializeCBOR(hello);
+    else msg->text = Util::SerializeJson(hello);
+	Send(msg);
+    // the state gets serialized by the main thread, see OFS_WebsocketApi::Update
+    NeedsFullState = true;
+
+    auto self = new std::shared_ptr<OFS_WebsocketClient>(shared_from_this());
+    runningWriters += 1;
+    auto thread = SDL_CreateThread(writerThread, "WebsocketClientWriter", self);
+    if(!thread)
+    {
+        delete self;
+        runningWriters -= 1;
+    }
+    SDL_DetachThread(thread);
+}
+
+void OFS_WebsocketClient::Close() noexcept
+{
+    closing = true;
+    conn = nullptr;
+    SDL_CondSignal(sendCond);
+}
+
+void OFS_WebsocketClient::StopWriters(const std::vector<std::shared_ptr<OFS_WebsocketClient>>& clients) noexcept
 {
-    // NOTE: this is not called by the main thread
     OFS_PROFILE(__FUNCTION__);
-    sendMessage(ev->serializedEvent);
+    writersStopped = true;
+    for(auto& client : clients)
+    {
+        client->Close();
+    }
+    // a writer blocked in a write exits once the write returned
+    while(runningWriters > 0) {
+        SDL_Delay(1);
+    }
 }
 
-void OFS_WebsocketClient::handleProjectChange(const WsProjectChange* ev) noexcept
+void OFS_WebsocketClient::CheckLag() noexcept
 {
-    // NOTE: this is called by the main thread
-    UpdateAll();
+    if(closing || disconnecting) return;
+    uint32_t queuedAt;
+    SDL_AtomicLock(&queueLock);
+    bool waiting = oldestQueued(&queuedAt);
+    SDL_AtomicUnlock(&queueLock);
+    if(waiting && SDL_GetTicks() - queuedAt > MaxLagMs) disconnectLagging("lagging behind");
 }
 
-void OFS_WebsocketClient::UpdateAll() noexcept
+bool OFS_WebsocketClient::oldestQueued(uint32_t* queuedAt) const noexcept
 {
-    // Update everything
-    auto app = OpenFunscripter::ptr;
+    if(writing) *queuedAt = writingSince;
+    else if(!sendQueue.empty()) *queuedAt = queueWaitingSince;
+    else return false;
+    return true;
+}
 
-    auto serializeSend = [this](auto&& event) noexcept
+void OFS_WebsocketClient::enqueue(const WsMessagePtr& msg) noexcept
+{
+    bool wasEmpty = sendQueue.empty();
+    auto replaced = [&msg](const WsMessagePtr& queued) noexcept
     {
-        nlohmann::json json = event;
-        auto jsonText = Util::SerializeJson(json);
-        sendMessage(jsonText);
+        if(queued->key != msg->key) return false;
+        switch(msg->policy)
+        {
+            case WsQueuePolicy::LatestWins:
+                return queued->policy == WsQueuePolicy::LatestWins;
+            case WsQueuePolicy::ScriptFull:
+                return queued->policy == WsQueuePolicy::ScriptDelta || queued->policy == WsQueuePolicy::ScriptFull;
+            default:
+                return false;
+        }
     };
+    if(msg->policy == WsQueuePolicy::LatestWins || msg->policy == WsQueuePolicy::ScriptFull)
+    {
+        auto it = std::remove_if(sendQueue.begin(), sendQueue.end(), replaced);
+        Stats.combined.fetch_add(std::distance(it, sendQueue.end()), std::memory_order_relaxed);
+        sendQueue.erase(it, sendQueue.end());
+    }
+    // replacing messages doesn't make the queue younger
+    if(wasEmpty) queueWaitingSince = SDL_GetTicks();
+    sendQueue.emplace_back(msg);
+}
+
+void OFS_WebsocketClient::disconnectLagging(const char* reason) noexcept
+{
+    if(disconnecting.exchange(true)) return;
+    LOGF_WARN("Disconnecting websocket client %s: %s", Address.c_str(), reason);
+    SDL_AtomicLock(&queueLock);
+    sendQueue.clear();
+    SDL_AtomicUnlock(&queueLock);
+    Stats.queued = 0;
+}
+
+void OFS_WebsocketClient::Send(const WsMessagePtr& msg) noexcept
+{
+    if(closing || disconnecting) return;
+    SDL_AtomicLock(&queueLock);
+    enqueue(msg);
+    uint32_t queued = sendQueue.size();
+    uint32_t queuedAt = 0;
+    oldestQueued(&queuedAt);
+    uint32_t waiting = SDL_GetTicks() - queuedAt;
+    SDL_AtomicUnlock(&queueLock);
+
+    Stats.queued = queued;
+    atomicMax(Stats.maxQueued, queued);
+    if(queued > MaxQueuedMessages) disconnectLagging("too many queued messages");
+    else if(waiting > MaxLagMs) disconnectLagging("lagging behind");
+    SDL_CondSignal(sendCond);
+}
 
-    serializeSend(std::move(WsProjectChange()));
-    serializeSend(std::move(WsMediaChange(app->player->VideoPath())));
-    serializeSend(std::move(WsPlaybackSpeedChange(app->player->CurrentSpeed())));
-    serializeSend(std::move(WsPlayChange(!app->player->IsPaused())));
-    serializeSend(std::move(WsDurationChange(app->player->Duration())));
-    serializeSend(std::move(WsTimeChange(app->player->CurrentPlayerTime())));
+void OFS_WebsocketClient::Subscribe(WsSubscriptionFilter&& newFilter) noexcept
+{
+    SDL_AtomicLock(&filterLock);
+    filter = std::move(newFilter);
+    SDL_AtomicUnlock(&filterLock);
+}
 
-    auto& projectState = app->LoadedProject->State();
-    for(auto& script : app->LoadedFunscripts())
+bool OFS_WebsocketClient::Wants(uint32_t subscription, uint64_t scriptKey) noexcept
+{
+    SDL_AtomicLock(&filterLock);
+    bool wants = filter.Wants(subscription, scriptKey);
+    SDL_AtomicUnlock(&filterLock);
+    return wants;
+}
+
+void OFS_WebsocketClient::SendThrottled(const WsMessagePtr& msg, uint32_t now) noexcept
+{
+    SDL_AtomicLock(&filterLock);
+    uint32_t interval = filter.timeIntervalMs;
+    SDL_AtomicUnlock(&filterLock);
+
+    if(interval == 0 || now - lastTimeSent >= interval)
     {
-        serializeSend(std::move(WsFunscriptChange(script->Title(), script->Data(), projectState.metadata)));
+        throttledTime.reset();
+        lastTimeSent = now;
+        Send(msg);
+    }
+    else
+    {
+        // only the newest one matters
+        throttledTime = msg;
     }
 }
 
-void OFS_WebsocketClient::InitializeConnection(mg_connection* conn) noexcept
+uint32_t OFS_WebsocketClient::FlushThrottled(uint32_t now) noexcept
 {
-    if(this->conn) return;
-    this->conn = conn;
-    /* Send "hello" message. */
-	const char* hello = "{\"connected\":\"OFS " OFS_LATEST_GIT_TAG "@" OFS_LATEST_GIT_HASH "\"}";
-	mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, hello, strlen(hello));
-    UpdateAll();
+    if(!throttledTime) return 0;
+    SDL_AtomicLock(&filterLock);
+    uint32_t interval = filter.timeIntervalMs;
+    SDL_AtomicUnlock(&filterLock);
+
+    uint32_t elapsed = now - lastTimeSent;
+    if(elapsed < interval) return interval - elapsed;
+    lastTimeSent = now;
+    Send(throttledTime);
+    throttledTime.reset();
+    return 0;
+}
+
+void OFS_WebsocketClient::receiveJson(const nlohmann::json& json) noexcept
+{
+    if(CommandBuffer.AddCmd(json, weak_from_this()))
+    {
+        // Success
+    }
 }
 
 void OFS_WebsocketClient::ReceiveText(char* data, size_t dataLen) noexcept
 {
     // NOTE: Assume this function isn't called on the main thread.
-    bool succ;
     std::string_view dataView(data, dataLen);
     auto json = nlohmann::json::parse(dataView, nullptr, false, true);
     if(!json.is_discarded())
     {
         // Valid json
-        if(CommandBuffer.AddCmd(json))
-        {
-            // Success
-        }
+        receiveJson(json);
+    }
+}
+
+void OFS_WebsocketClient::ReceiveBinary(char* data, size_t dataLen) noexcept
+{
+    // NOTE: Assume this function isn't called on the main thread.
+    bool succ;
+    std::vector<uint8_t> cbor((uint8_t*)data, (uint8_t*)data + dataLen);
+    auto json = Util::ParseCBOR(cbor, &succ);
+    if(succ && json.is_object())
+    {
+        receiveJson(json);
     }
-}
\ No newline at end of file
+}
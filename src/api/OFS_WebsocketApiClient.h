@@ -1,31 +1,87 @@
 #pragma once
-#include "OFS_EventSystem.h"
 #include "OFS_WebsocketApiEvents.h"
 #include "OFS_WebsocketApiCommands.h"
 
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
-// This event is pushed to the internal websocket clients and not part of the API
-class WsSerializedEvent : public OFS_Event<WsSerializedEvent>
+// A serialized event. It's created once and shared by every client it gets sent to.
+// Only the encodings used by the receiving clients are filled in.
+struct WsMessage
 {
-    public:
-    std::string serializedEvent;
-    WsSerializedEvent(std::string&& json) noexcept
-        : serializedEvent(std::move(json)) {}
+    std::string text;
+    std::vector<uint8_t> binary;
+    WsQueuePolicy policy = WsQueuePolicy::Deliver;
+    uint64_t key = 0;
 };
+using WsMessagePtr = std::shared_ptr<const WsMessage>;
 
-class OFS_WebsocketClient
+class OFS_WebsocketClient : public std::enable_shared_from_this<OFS_WebsocketClient>
 {
     private:
-    UnsubscribeFn eventUnsub;
-	struct mg_connection* conn = nullptr;
+	std::atomic<struct mg_connection*> conn = nullptr;
+
+    SDL_SpinLock queueLock = {0};
+    std::vector<WsMessagePtr> sendQueue;
+    // when the queue became non-empty
+    uint32_t queueWaitingSince = 0;
+    // the batch taken by the writer counts as queued until it's written
+    uint32_t writingSince = 0;
+    bool writing = false;
+    SDL_cond* sendCond = nullptr;
+    std::atomic<bool> closing = false;
+    std::atomic<bool> disconnecting = false;
+
+    SDL_SpinLock filterLock = {0};
+    WsSubscriptionFilter filter;
+    // serialization thread only
+    WsMessagePtr throttledTime;
+    uint32_t lastTimeSent = 0;
+
+    // has to be called with the queueLock held
+    void enqueue(const WsMessagePtr& msg) noexcept;
+    // has to be called with the queueLock held, returns false if nothing is waiting
+    bool oldestQueued(uint32_t* queuedAt) const noexcept;
+    void disconnectLagging(const char* reason) noexcept;
+
+    static std::atomic<int32_t> runningWriters;
+    static std::atomic<bool> writersStopped;
+    static int writerThread(void* user) noexcept;
+    void sendMessage(const WsMessage& msg) noexcept;
+    void receiveJson(const nlohmann::json& json) noexcept;
 
-    void handleSerializedEvent(const WsSerializedEvent* ev) noexcept;
-    void handleProjectChange(const WsProjectChange* ev) noexcept;
-    void sendMessage(const std::string& msg) noexcept;
-    
     public:
     static WsCommandBuffer CommandBuffer;
+    // clients which can't keep up for this long get disconnected
+    static std::atomic<uint32_t> MaxLagMs;
+    // more queued messages than this disconnect the client right away
+    static constexpr uint32_t MaxQueuedMessages = 4096;
+
+    // lag metrics shown in the websocket window, written by the client threads
+    struct Metrics
+    {
+        std::atomic<uint32_t> queued = 0;
+        std::atomic<uint32_t> maxQueued = 0;
+        std::atomic<uint32_t> lagMs = 0;
+        std::atomic<uint32_t> maxLagMs = 0;
+        std::atomic<uint64_t> sent = 0;
+        std::atomic<uint64_t> sentBytes = 0;
+        std::atomic<uint64_t> combined = 0;
+    } Stats;
+    std::string Address;
+
+    // set when the client needs to receive the whole state
+    std::atomic<bool> NeedsFullState = false;
+    // broadcasts queued before the full state was queued get skipped
+    std::atomic<uint64_t> SyncedFromSeq = UINT64_MAX;
+    // negotiated the "ofs-api.cbor" subprotocol, set before the client is registered
+    bool Binary = false;
 
     OFS_WebsocketClient() noexcept;
     OFS_WebsocketClient(const OFS_WebsocketClient&) = delete;
@@ -33,6 +89,28 @@ class OFS_WebsocketClient
     ~OFS_WebsocketClient() noexcept;
 
     void InitializeConnection(struct mg_connection* conn) noexcept;
-    void UpdateAll() noexcept;
+    // Stops the writer thread without waiting for it. Nothing gets written to the connection afterwards.
+    void Close() noexcept;
+    // Disconnects the client if the oldest unsent message is older than MaxLagMs.
+    // Catches clients which stopped reading while nothing new gets sent to them.
+    void CheckLag() noexcept;
+
+    // Closes the clients and waits until every writer thread exited.
+    // Writers of connections which are opened afterwards exit right away until AllowWriters gets called.
+    static void StopWriters(const std::vector<std::shared_ptr<OFS_WebsocketClient>>& clients) noexcept;
+    static inline void AllowWriters() noexcept { writersStopped = false; }
+
+    // Can be called from any thread, the message gets written by the clients writer thread.
+    // Queued messages get combined according to their WsQueuePolicy.
+    void Send(const WsMessagePtr& msg) noexcept;
+    inline bool Disconnecting() const noexcept { return disconnecting; }
+
+    void Subscribe(WsSubscriptionFilter&& newFilter) noexcept;
+    bool Wants(uint32_t subscription, uint64_t scriptKey) noexcept;
+    // Serialization thread only. Time updates get held back to respect the subscribed rate.
+    void SendThrottled(const WsMessagePtr& msg, uint32_t now) noexcept;
+    // Sends the held back time update if it's due. Returns the ms until it's due or 0 if there is none.
+    uint32_t FlushThrottled(uint32_t now) noexcept;
     void ReceiveText(char* data, size_t dateLen) noexcept;
-};
\ No newline at end of file
+    void ReceiveBinary(char* data, size_t dataLen) noexcept;
+};
@@ -1,11 +1,82 @@
 #include "OFS_WebsocketApiCommands.h"
 #include <optional>
+#include <algorithm>
+#include <limits>
 
 WsCommandBuffer::WsCommandBuffer() noexcept
 {
 
 }
 
+// Reads { "at": [ms...], "pos": [...] }. Cbor clients can send typed arrays
+// like the ones in funscript_change instead of the number arrays.
+static bool parseActions(const nlohmann::json& json, FunscriptArray& actions) noexcept
+{
+    if(!json.is_object() || !json.contains("at") || !json.contains("pos")) return false;
+    auto& at = json["at"];
+    auto& pos = json["pos"];
+
+    std::vector<int32_t> atMs;
+    if(at.is_array())
+    {
+        atMs.reserve(at.size());
+        for(auto& value : at)
+        {
+            if(!value.is_number()) return false;
+            atMs.emplace_back(value.get<int32_t>());
+        }
+    }
+    else if(at.is_binary())
+    {
+        // little endian int32
+        auto& bytes = at.get_binary();
+        if(!bytes.has_subtype() || bytes.subtype() != CborSint32LittleEndianArray) return false;
+        if(bytes.size() % sizeof(int32_t) != 0) return false;
+        atMs.reserve(bytes.size() / sizeof(int32_t));
+        for(size_t i = 0; i < bytes.size(); i += sizeof(int32_t))
+        {
+            atMs.emplace_back((int32_t)((uint32_t)bytes[i] | ((uint32_t)bytes[i + 1] << 8) 
+                | ((uint32_t)bytes[i + 2] << 16) | ((uint32_t)bytes[i + 3] << 24)));
+        }
+    }
+    else return false;
+
+    std::vector<int32_t> positions;
+    if(pos.is_array())
+    {
+        positions.reserve(pos.size());
+        for(auto& value : pos)
+        {
+            if(!value.is_number()) return false;
+            positions.emplace_back(value.get<int32_t>());
+        }
+    }
+    else if(pos.is_binary())
+    {
+        auto& bytes = pos.get_binary();
+        if(!bytes.has_subtype() || bytes.subtype() != CborUint8Array) return false;
+        positions.assign(bytes.begin(), bytes.end());
+    }
+    else return false;
+
+    if(atMs.size() != positions.size()) return false;
+
+    actions.clear();
+    actions.reserve(atMs.size());
+    for(size_t i = 0; i < atMs.size(); i += 1)
+    {
+        actions.emplace_back_unsorted(FunscriptAction(atMs[i] / 1000.f, Util::Clamp(positions[i], 0, 100)));
+    }
+    // generators usually send sorted actions
+    if(!std::is_sorted(actions.begin(), actions.end(), ActionLess()))
+    {
+        std::stable_sort(actions.begin(), actions.end(), ActionLess());
+    }
+    actions.erase(std::unique(actions.begin(), actions.end(),
+        [](auto a, auto b) noexcept { return a.atS == b.atS; }), actions.end());
+    return true;
+}
+
 inline static std::unique_ptr<WsCmd> CreateCommand(const std::string& name, const nlohmann::json& data) noexcept
 {
     if(name == "change_time" && data["time"].is_number())
@@ -23,10 +94,91 @@ inline static std::unique_ptr<WsCmd> CreateCommand(const std::string& name, cons
         float speed = data["speed"].get<float>();
         return std::make_unique<WsPlaybackSpeedChangeCmd>(speed);
     }
+    else if(name == "funscript_resync")
+    {
+        // without a name every script gets resent
+        bool hasName = data.contains("name") && data["name"].is_string();
+        return std::make_unique<WsFunscriptResyncCmd>(hasName ? data["name"].get<std::string>() : std::string());
+    }
+    else if(name == "subscribe")
+    {
+        // every field is optional, leaving one out subscribes to everything
+        WsSubscriptionFilter filter;
+        if(data.contains("events") && data["events"].is_array())
+        {
+            filter.events = WsSub_None;
+            for(auto& eventName : data["events"])
+            {
+                if(!eventName.is_string()) continue;
+                auto subscription = WsSubscriptionFromName(eventName.get<std::string>());
+                if(subscription == WsSub_None) 
+                    LOGF_WARN("Unknown websocket event \"%s\" in subscribe command.", eventName.get_ref<const std::string&>().c_str());
+                filter.events |= subscription;
+            }
+        }
+        if(data.contains("scripts") && data["scripts"].is_array())
+        {
+            for(auto& scriptName : data["scripts"])
+            {
+                if(!scriptName.is_string()) continue;
+                filter.scripts.emplace_back(std::hash<std::string>()(scriptName.get<std::string>()));
+            }
+        }
+        if(data.contains("maxRate") && data["maxRate"].is_number())
+        {
+            float maxRate = data["maxRate"].get<float>();
+            filter.timeIntervalMs = maxRate > 0.f ? (uint32_t)(1000.f / maxRate) : 0;
+        }
+        return std::make_unique<WsSubscribeCmd>(std::move(filter));
+    }
+    else if(name == "add_actions" || name == "remove_range" || name == "replace_range")
+    {
+        auto operation = name == "add_actions" ? WsScriptEditCmd::Operation::Add
+            : name == "remove_range" ? WsScriptEditCmd::Operation::RemoveRange
+            : WsScriptEditCmd::Operation::ReplaceRange;
+
+        std::string script = data.contains("script") && data["script"].is_string() ? data["script"].get<std::string>() : std::string();
+        float fromTime = 0.f;
+        float toTime = 0.f;
+        if(operation != WsScriptEditCmd::Operation::Add)
+        {
+            if(!data.contains("from") || !data["from"].is_number() || !data.contains("to") || !data["to"].is_number()) return {};
+            fromTime = data["from"].get<int32_t>() / 1000.f;
+            toTime = data["to"].get<int32_t>() / 1000.f;
+        }
+
+        FunscriptArray actions;
+        if(operation != WsScriptEditCmd::Operation::RemoveRange)
+        {
+            if(!data.contains("actions") || !parseActions(data["actions"], actions))
+            {
+                LOGF_WARN("Invalid actions in websocket command \"%s\".", name.c_str());
+                return {};
+            }
+        }
+        return std::make_unique<WsScriptEditCmd>(operation, std::move(script), fromTime, toTime, std::move(actions));
+    }
+    else if(name == "position_stream")
+    {
+        // no scripts or a rate of 0 stop the stream
+        std::vector<std::string> scripts;
+        if(data.contains("scripts") && data["scripts"].is_array())
+        {
+            for(auto& scriptName : data["scripts"])
+            {
+                if(scriptName.is_string()) scripts.emplace_back(scriptName.get<std::string>());
+            }
+        }
+        float rate = data.contains("rate") && data["rate"].is_number() ? data["rate"].get<float>() : 100.f;
+        auto interpolation = data.contains("interpolation") && data["interpolation"] == "spline"
+            ? OFS_WebsocketPositionStream::Interpolation::Spline
+            : OFS_WebsocketPositionStream::Interpolation::Linear;
+        return std::make_unique<WsPositionStreamCmd>(std::move(scripts), rate, interpolation);
+    }
     return {};
 }
 
-bool WsCommandBuffer::AddCmd(const nlohmann::json& jsonCmd) noexcept
+bool WsCommandBuffer::AddCmd(const nlohmann::json& jsonCmd, std::weak_ptr<OFS_WebsocketClient> client) noexcept
 {
     auto& type = jsonCmd["type"];
     if(!type.is_string() || type != "command") return false;
@@ -40,6 +192,7 @@ bool WsCommandBuffer::AddCmd(const nlohmann::json& jsonCmd) noexcept
     auto cmd = CreateCommand(name.get_ref<const std::string&>(), data);
     if(cmd)
     {
+        cmd->Client = std::move(client);
         SDL_AtomicLock(&commandLock);
         commands.emplace_back(std::move(cmd));
         SDL_AtomicUnlock(&commandLock);
@@ -62,6 +215,8 @@ void WsCommandBuffer::ProcessCommands() noexcept
 
 
 #include "OpenFunscripter.h"
+#include "OFS_WebsocketApi.h"
+#include "OFS_WebsocketApiClient.h"
 
 void WsPlayChangeCmd::Run() noexcept
 {
@@ -79,4 +234,87 @@ void WsTimeChangeCmd::Run() noexcept
 {
     auto app = OpenFunscripter::ptr;
     app->player->SetPositionExact(time);
-}
\ No newline at end of file
+}
+
+void WsSubscribeCmd::Run() noexcept
+{
+    auto client = Client.lock();
+    if(!client) return;
+    bool wantsScripts = filter.events & WsSub_Funscript;
+    client->Subscribe(std::move(filter));
+    // scripts which were filtered before are out of date
+    if(wantsScripts)
+    {
+        auto app = OpenFunscripter::ptr;
+        app->webApi->ResyncFunscripts(client, std::string());
+    }
+}
+
+void WsPositionStreamCmd::Run() noexcept
+{
+    auto client = Client.lock();
+    if(!client) return;
+    auto app = OpenFunscripter::ptr;
+    app->webApi->StartPositionStream(client, std::move(scripts), rate, interpolation);
+}
+
+void WsScriptEditCmd::Run() noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    auto app = OpenFunscripter::ptr;
+    std::shared_ptr<Funscript> target;
+    if(script.empty())
+    {
+        target = app->ActiveFunscript();
+    }
+    else
+    {
+        for(auto& loaded : app->LoadedFunscripts())
+        {
+            if(loaded->Title() == script) { target = loaded; break; }
+        }
+    }
+    if(!target)
+    {
+        LOGF_WARN("Websocket edit: script \"%s\" isn't loaded.", script.c_str());
+        return;
+    }
+
+    // the undo entry only holds the range which can change
+    float startTime = std::numeric_limits<float>::max();
+    float endTime = std::numeric_limits<float>::lowest();
+    if(operation != Operation::Add)
+    {
+        startTime = std::min(fromTime, toTime);
+        endTime = std::max(fromTime, toTime);
+    }
+    if(!actions.empty())
+    {
+        startTime = std::min(startTime, actions.front().atS);
+        endTime = std::max(endTime, actions.back().atS);
+    }
+    if(startTime > endTime) return;
+
+    app->undoSystem->SnapshotRange(StateType::WEBSOCKET_EDIT, target, startTime, endTime);
+    switch(operation)
+    {
+        case Operation::Add:
+            target->MergeActions(actions);
+            break;
+        case Operation::RemoveRange:
+            target->RemoveActionsInInterval(fromTime, toTime);
+            break;
+        case Operation::ReplaceRange:
+            target->RemoveActionsInInterval(fromTime, toTime);
+            target->MergeActions(actions);
+            break;
+    }
+}
+
+void WsFunscriptResyncCmd::Run() noexcept
+{
+    auto client = Client.lock();
+    if(!client) return;
+    auto app = OpenFunscripter::ptr;
+    app->webApi->ResyncFunscripts(client, name);
+}
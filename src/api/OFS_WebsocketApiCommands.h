@@ -3,13 +3,20 @@
 #include <vector>
 #include <variant>
 #include <memory>
+#include <string>
 
 #include "SDL_atomic.h"
 #include "OFS_Util.h"
+#include "OFS_WebsocketApiEvents.h"
+#include "OFS_WebsocketPositionStream.h"
+
+class OFS_WebsocketClient;
 
 class WsCmd 
 {
     public:
+    // the client which sent the command
+    std::weak_ptr<OFS_WebsocketClient> Client;
     virtual void Run() noexcept = 0;
 };
 
@@ -43,6 +50,63 @@ class WsTimeChangeCmd : public WsCmd
     void Run() noexcept override;
 };
 
+class WsFunscriptResyncCmd : public WsCmd
+{
+    public:
+    // empty resyncs every script
+    std::string name;
+    WsFunscriptResyncCmd(std::string name) noexcept
+        : name(std::move(name)) {}
+
+    void Run() noexcept override;
+};
+
+class WsSubscribeCmd : public WsCmd
+{
+    public:
+    WsSubscriptionFilter filter;
+    WsSubscribeCmd(WsSubscriptionFilter filter) noexcept
+        : filter(std::move(filter)) {}
+
+    void Run() noexcept override;
+};
+
+class WsPositionStreamCmd : public WsCmd
+{
+    public:
+    std::vector<std::string> scripts;
+    float rate = 0.f;
+    OFS_WebsocketPositionStream::Interpolation interpolation;
+    WsPositionStreamCmd(std::vector<std::string> scripts, float rate, OFS_WebsocketPositionStream::Interpolation interpolation) noexcept
+        : scripts(std::move(scripts)), rate(rate), interpolation(interpolation) {}
+
+    void Run() noexcept override;
+};
+
+// add_actions, remove_range and replace_range.
+// Applied as a single undo step, an empty script name means the active script.
+class WsScriptEditCmd : public WsCmd
+{
+    public:
+    enum class Operation : uint8_t
+    {
+        Add,
+        RemoveRange,
+        ReplaceRange
+    };
+    Operation operation;
+    std::string script;
+    // inclusive, in seconds
+    float fromTime = 0.f;
+    float toTime = 0.f;
+    FunscriptArray actions;
+
+    WsScriptEditCmd(Operation operation, std::string script, float fromTime, float toTime, FunscriptArray&& actions) noexcept
+        : operation(operation), script(std::move(script)), fromTime(fromTime), toTime(toTime), actions(std::move(actions)) {}
+
+    void Run() noexcept override;
+};
+
 class WsCommandBuffer
 {
     private:
@@ -51,6 +115,6 @@ class WsCommandBuffer
     public:
 
     WsCommandBuffer() noexcept;
-    bool AddCmd(const nlohmann::json& jsonCmd) noexcept;
+    bool AddCmd(const nlohmann::json& jsonCmd, std::weak_ptr<OFS_WebsocketClient> client) noexcept;
     void ProcessCommands() noexcept;
 };
@@ -1,5 +1,7 @@
 #include "OFS_WebsocketApiEvents.h"
 
+#include <cmath>
+
 inline static void initializeEvent(nlohmann::json& j, const char* eventName)
 {
     j = { { "type", "event" }, { "name", eventName } };
@@ -17,6 +19,18 @@ void to_json(nlohmann::json& j, const WsTimeChange& p)
     j["data"] = { {"time", p.time } };
 }
 
+void to_json(nlohmann::json& j, const WsPositionChange& p)
+{
+    initializeEvent(j, "position");
+    auto positions = nlohmann::json::array();
+    for(float pos : p.positions)
+    {
+        if(pos < 0.f) positions.emplace_back(nullptr);
+        else positions.emplace_back(pos);
+    }
+    j["data"] = { { "time", p.time }, { "positions", std::move(positions) } };
+}
+
 void to_json(nlohmann::json& j, const WsDurationChange& p)
 {
     initializeEvent(j, "duration_change");
@@ -46,11 +60,94 @@ void to_json(nlohmann::json& j, const WsFunscriptChange& p)
     initializeEvent(j, "funscript_change");
     nlohmann::json funscript;
     Funscript::Serialize(funscript, p.funscriptData, p.funscriptMetadata, true);
-    j["data"] = { { "name", p.name }, { "funscript",  std::move(funscript) } };
+    j["data"] = { { "name", p.name }, { "version", p.version }, { "funscript",  std::move(funscript) } };
 }
 
 void to_json(nlohmann::json& j, const WsFunscriptRemove& p)
 {
     initializeEvent(j, "funscript_remove");
     j["data"] = { {"name", p.name } };
-}
\ No newline at end of file
+}
+
+static void deltaToJson(nlohmann::json& j, const WsFunscriptDelta& p, nlohmann::json&& inserted)
+{
+    initializeEvent(j, "funscript_delta");
+    // the removed range is inclusive and in milliseconds like "at"
+    nlohmann::json removed;
+    if(p.hasRemoved)
+    {
+        removed = { { "from", (int64_t)std::round(p.removeFrom * 1000.0) }, { "to", (int64_t)std::round(p.removeTo * 1000.0) } };
+    }
+    j["data"] = { 
+        { "name", p.name },
+        { "baseVersion", p.baseVersion },
+        { "version", p.version },
+        { "removed", std::move(removed) },
+        { "inserted", std::move(inserted) }
+    };
+}
+
+void to_json(nlohmann::json& j, const WsFunscriptDelta& p)
+{
+    auto inserted = nlohmann::json::array();
+    for(auto action : p.inserted)
+    {
+        inserted.push_back({ { "at", (int64_t)std::round(action.atS * 1000.0) }, { "pos", action.pos } });
+    }
+    deltaToJson(j, p, std::move(inserted));
+}
+
+// Packs actions into { "at": int32[] in milliseconds, "pos": uint8[] } typed arrays.
+template<typename Container>
+static nlohmann::json packActions(const Container& actions) noexcept
+{
+    nlohmann::json::binary_t::container_type at;
+    nlohmann::json::binary_t::container_type pos;
+    at.reserve(actions.size() * sizeof(int32_t));
+    pos.reserve(actions.size());
+    for(auto action : actions)
+    {
+        auto ms = (int32_t)std::round(action.atS * 1000.0);
+        // always little endian regardless of the host
+        at.push_back(ms & 0xFF);
+        at.push_back((ms >> 8) & 0xFF);
+        at.push_back((ms >> 16) & 0xFF);
+        at.push_back((ms >> 24) & 0xFF);
+        pos.push_back((uint8_t)action.pos);
+    }
+    return { 
+        { "at", nlohmann::json::binary(std::move(at), CborSint32LittleEndianArray) },
+        { "pos", nlohmann::json::binary(std::move(pos), CborUint8Array) }
+    };
+}
+
+void to_cbor_json(nlohmann::json& j, const WsFunscriptChange& p)
+{
+    initializeEvent(j, "funscript_change");
+    nlohmann::json funscript;
+    // the actions get packed separately
+    Funscript::FunscriptData withoutActions;
+    Funscript::Serialize(funscript, withoutActions, p.funscriptMetadata, true);
+    funscript["actions"] = packActions(p.funscriptData.Actions);
+    j["data"] = { { "name", p.name }, { "version", p.version }, { "funscript",  std::move(funscript) } };
+}
+
+void to_cbor_json(nlohmann::json& j, const WsFunscriptDelta& p)
+{
+    deltaToJson(j, p, packActions(p.inserted));
+}
+
+uint32_t WsSubscriptionFromName(const std::string& eventName) noexcept
+{
+    if(eventName == "project_change") return WsSub_Project;
+    else if(eventName == "play_change") return WsSub_Play;
+    else if(eventName == "time_change") return WsSub_Time;
+    else if(eventName == "duration_change") return WsSub_Duration;
+    else if(eventName == "media_change") return WsSub_Media;
+    else if(eventName == "playbackspeed_change") return WsSub_PlaybackSpeed;
+    else if(eventName == "funscript_change" 
+        || eventName == "funscript_delta" 
+        || eventName == "funscript_remove") return WsSub_Funscript;
+    else if(eventName == "position") return WsSub_Position;
+    return WsSub_None;
+}
@@ -6,10 +6,74 @@
 
 #include <memory>
 #include <string>
+#include <functional>
+#include <algorithm>
+#include <vector>
+
+// How a message waiting in the send queue of a slow client gets combined with newer messages.
+enum class WsQueuePolicy : uint8_t
+{
+    // state changes, always delivered
+    Deliver,
+    // only the newest message with the same key is kept, e.g. time updates
+    LatestWins,
+    // part of a script, dropped when a complete script with the same key gets queued
+    ScriptDelta,
+    // a complete script or its removal, replaces the queued messages of that script
+    ScriptFull,
+};
+
+// RFC 8746 typed array tags of the packed actions, see to_cbor_json
+static constexpr uint64_t CborUint8Array = 64;
+static constexpr uint64_t CborSint32LittleEndianArray = 78;
+
+// Message groups a client can subscribe to, see the "subscribe" command.
+enum WsSubscription : uint32_t {
+    WsSub_None = 0x0,
+    WsSub_Project = 0x1,
+    WsSub_Play = 0x1 << 1,
+    WsSub_Time = 0x1 << 2,
+    WsSub_Duration = 0x1 << 3,
+    WsSub_Media = 0x1 << 4,
+    WsSub_PlaybackSpeed = 0x1 << 5,
+    // funscript_change, funscript_delta and funscript_remove
+    WsSub_Funscript = 0x1 << 6,
+    // only sent to clients which started a position stream
+    WsSub_Position = 0x1 << 7,
+    WsSub_All = 0xFFFFFFFF
+};
+// Returns WsSub_None for unknown event names.
+uint32_t WsSubscriptionFromName(const std::string& eventName) noexcept;
+
+struct WsSubscriptionFilter
+{
+    uint32_t events = WsSub_All;
+    // hashed script names, empty means every script
+    std::vector<uint64_t> scripts;
+    // minimum time between time updates, 0 is unlimited
+    uint32_t timeIntervalMs = 0;
+
+    inline bool Wants(uint32_t subscription, uint64_t scriptKey) const noexcept
+    {
+        if((events & subscription) == 0) return false;
+        if(scriptKey == 0 || scripts.empty()) return true;
+        return std::find(scripts.begin(), scripts.end(), scriptKey) != scripts.end();
+    }
+};
 
 struct ToJsonInterface
 {
     virtual void Serialize(nlohmann::json& json) noexcept = 0;
+    // Used for the cbor subprotocol. Large arrays may be packed into binary values.
+    virtual void SerializeBinary(nlohmann::json& json) noexcept { Serialize(json); }
+
+    virtual WsQueuePolicy QueuePolicy() const noexcept { return WsQueuePolicy::Deliver; }
+    // messages are only combined when their keys match
+    virtual uint64_t QueueKey() const noexcept { return ScriptKey(); }
+
+    virtual uint32_t Subscription() const noexcept = 0;
+    // hashed script name for messages belonging to a script
+    virtual uint64_t ScriptKey() const noexcept { return 0; }
 };
 
 void to_json(nlohmann::json& j, const class WsProjectChange& p);
@@ -20,6 +84,10 @@ void to_json(nlohmann::json& j, const class WsMediaChange& p);
 void to_json(nlohmann::json& j, const class WsPlaybackSpeedChange& p);
 void to_json(nlohmann::json& j, const class WsFunscriptChange& p);
 void to_json(nlohmann::json& j, const class WsFunscriptRemove& p);
+void to_json(nlohmann::json& j, const class WsFunscriptDelta& p);
+void to_json(nlohmann::json& j, const class WsPositionChange& p);
+void to_cbor_json(nlohmann::json& j, const class WsFunscriptChange& p);
+void to_cbor_json(nlohmann::json& j, const class WsFunscriptDelta& p);
 
 class WsMediaChange : public OFS_Event<WsMediaChange>, public ToJsonInterface
 {
@@ -30,6 +98,7 @@ class WsMediaChange : public OFS_Event<WsMediaChange>, public ToJsonInterface
         : mediaPath(path) {}
 
     void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_Media; }
 };
 
 class WsPlaybackSpeedChange : public OFS_Event<WsPlaybackSpeedChange>, public ToJsonInterface
@@ -41,6 +110,7 @@ class WsPlaybackSpeedChange : public OFS_Event<WsPlaybackSpeedChange>, public To
         : speed(speed) {}
 
     void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_PlaybackSpeed; }
 };
 
 class WsPlayChange : public OFS_Event<WsPlayChange>, public ToJsonInterface
@@ -51,6 +121,7 @@ class WsPlayChange : public OFS_Event<WsPlayChange>, public ToJsonInterface
         : playing(playing) {}
 
     void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_Play; }
 };
 
 class WsTimeChange : public OFS_Event<WsTimeChange>, public ToJsonInterface
@@ -61,6 +132,24 @@ class WsTimeChange : public OFS_Event<WsTimeChange>, public ToJsonInterface
         : time(time) {}
 
     void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_Time; }
+    WsQueuePolicy QueuePolicy() const noexcept override { return WsQueuePolicy::LatestWins; }
+    uint64_t QueueKey() const noexcept override { return EventType; }
+};
+
+// Sampled positions of the streamed scripts, negative for scripts which don't exist.
+class WsPositionChange : public OFS_Event<WsPositionChange>, public ToJsonInterface
+{
+    public:
+    float time;
+    std::vector<float> positions;
+    WsPositionChange(float time, std::vector<float> positions) noexcept
+        : time(time), positions(std::move(positions)) {}
+
+    void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_Position; }
+    WsQueuePolicy QueuePolicy() const noexcept override { return WsQueuePolicy::LatestWins; }
+    uint64_t QueueKey() const noexcept override { return EventType; }
 };
 
 class WsDurationChange : public OFS_Event<WsDurationChange>, public ToJsonInterface
@@ -71,6 +160,7 @@ class WsDurationChange : public OFS_Event<WsDurationChange>, public ToJsonInterf
         : duration(duration) {}
 
     void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_Duration; }
 };
 
 class WsFunscriptChange : public OFS_Event<WsFunscriptChange>, public ToJsonInterface
@@ -79,11 +169,16 @@ class WsFunscriptChange : public OFS_Event<WsFunscriptChange>, public ToJsonInte
     std::string name;
     Funscript::FunscriptData funscriptData;
     Funscript::Metadata funscriptMetadata;
+    uint32_t version;
 
-    WsFunscriptChange(const std::string& name, Funscript::FunscriptData funscriptData, Funscript::Metadata metadata) noexcept
-        : name(name), funscriptData(std::move(funscriptData)), funscriptMetadata(std::move(metadata)) {}
+    WsFunscriptChange(const std::string& name, Funscript::FunscriptData funscriptData, Funscript::Metadata metadata, uint32_t version) noexcept
+        : name(name), funscriptData(std::move(funscriptData)), funscriptMetadata(std::move(metadata)), version(version) {}
 
     void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    void SerializeBinary(nlohmann::json& json) noexcept override { to_cbor_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_Funscript; }
+    WsQueuePolicy QueuePolicy() const noexcept override { return WsQueuePolicy::ScriptFull; }
+    uint64_t ScriptKey() const noexcept override { return std::hash<std::string>()(name); }
 };
 
 class WsProjectChange : public OFS_Event<WsProjectChange>, public ToJsonInterface
@@ -92,6 +187,7 @@ class WsProjectChange : public OFS_Event<WsProjectChange>, public ToJsonInterfac
     WsProjectChange() noexcept {}
 
     void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_Project; }
 };
 
 class WsFunscriptRemove : public OFS_Event<WsFunscriptRemove>, public ToJsonInterface
@@ -102,5 +198,30 @@ class WsFunscriptRemove : public OFS_Event<WsFunscriptRemove>, public ToJsonInte
         : name(name) {}
 
     void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_Funscript; }
+    WsQueuePolicy QueuePolicy() const noexcept override { return WsQueuePolicy::ScriptFull; }
+    uint64_t ScriptKey() const noexcept override { return std::hash<std::string>()(name); }
 };
 
+// Replaces the actions between removeFrom and removeTo with the inserted actions.
+// Clients have to request a resync if baseVersion doesn't match their version.
+class WsFunscriptDelta : public OFS_Event<WsFunscriptDelta>, public ToJsonInterface
+{
+    public:
+    std::string name;
+    uint32_t baseVersion;
+    uint32_t version;
+    bool hasRemoved = false;
+    float removeFrom = 0.f;
+    float removeTo = 0.f;
+    std::vector<FunscriptAction> inserted;
+
+    WsFunscriptDelta(const std::string& name, uint32_t baseVersion, uint32_t version) noexcept
+        : name(name), baseVersion(baseVersion), version(version) {}
+
+    void Serialize(nlohmann::json& json) noexcept override { to_json(json, *this); }
+    void SerializeBinary(nlohmann::json& json) noexcept override { to_cbor_json(json, *this); }
+    uint32_t Subscription() const noexcept override { return WsSub_Funscript; }
+    WsQueuePolicy QueuePolicy() const noexcept override { return WsQueuePolicy::ScriptDelta; }
+    uint64_t ScriptKey() const noexcept override { return std::hash<std::string>()(name); }
+};
@@ -0,0 +1,274 @@
+#include "OFS_WebsocketPositionStream.h"
+#include "OFS_WebsocketApi.h"
+#include "OFS_WebsocketApiClient.h"
+#include "OFS_WebsocketApiEvents.h"
+
+#include "Funscript.h"
+#include "OFS_Profiling.h"
+#include "OFS_Util.h"
+
+#include "SDL_thread.h"
+#include "SDL_timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// sleeping can overshoot, the rest is spent yielding
+static constexpr uint64_t SpinUs = 200;
+
+OFS_WebsocketPositionStream::OFS_WebsocketPositionStream(EventSerializationContext* serialization) noexcept
+    : serialization(serialization)
+{
+    wakeCond = SDL_CreateCond();
+    auto thread = SDL_CreateThread(timerThread, "WebsocketPositionStream", this);
+    SDL_DetachThread(thread);
+}
+
+OFS_WebsocketPositionStream::~OFS_WebsocketPositionStream() noexcept
+{
+    Shutdown();
+}
+
+void OFS_WebsocketPositionStream::Shutdown() noexcept
+{
+    if(shouldExit.exchange(true)) return;
+    SDL_CondSignal(wakeCond);
+    while(!hasExited) {
+        SDL_Delay(1);
+    }
+    SDL_DestroyCond(wakeCond);
+}
+
+void OFS_WebsocketPositionStream::applyUpdates(std::vector<ScriptUpdate>& updates) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    for(auto& update : updates)
+    {
+        auto it = std::find_if(scripts.begin(), scripts.end(),
+            [&update](auto& script) noexcept { return script.name == update.name; });
+        switch(update.type)
+        {
+            case ScriptUpdate::Type::Clear:
+                scripts.clear();
+                break;
+            case ScriptUpdate::Type::Remove:
+                if(it != scripts.end()) scripts.erase(it);
+                break;
+            case ScriptUpdate::Type::Replace:
+                if(it == scripts.end())
+                {
+                    it = scripts.emplace(scripts.end());
+                    it->name = std::move(update.name);
+                }
+                it->version += 1;
+                it->spline.Replace(update.startTime, update.endTime, update.actions, it->version);
+                break;
+        }
+    }
+    updates.clear();
+}
+
+float OFS_WebsocketPositionStream::sample(const std::string& name, Interpolation interpolation, float time) noexcept
+{
+    auto it = std::find_if(scripts.begin(), scripts.end(),
+        [&name](auto& script) noexcept { return script.name == name; });
+    if(it == scripts.end()) return -1.f;
+
+    if(interpolation == Interpolation::Spline)
+    {
+        return Util::Clamp<float>(it->spline.Sample(time) * 100.f, 0.f, 100.f);
+    }
+    return Funscript::GetPositionAtTime(it->spline.Knots(), time);
+}
+
+int OFS_WebsocketPositionStream::timerThread(void* user) noexcept
+{
+    auto ctx = static_cast<OFS_WebsocketPositionStream*>(user);
+    auto waitMut = SDL_CreateMutex();
+    SDL_LockMutex(waitMut);
+
+    struct DueStream
+    {
+        std::shared_ptr<OFS_WebsocketClient> client;
+        std::shared_ptr<const std::vector<std::string>> scripts;
+        Interpolation interpolation;
+        bool sent;
+    };
+
+    const uint64_t frequency = SDL_GetPerformanceFrequency();
+    std::vector<ScriptUpdate> updates;
+    std::vector<DueStream> due;
+    WsClientList targets;
+    while(!ctx->shouldExit)
+    {
+        if(!ctx->Active())
+        {
+            SDL_CondWaitTimeout(ctx->wakeCond, waitMut, 100);
+            SDL_AtomicLock(&ctx->lock);
+            updates.swap(ctx->pendingUpdates);
+            SDL_AtomicUnlock(&ctx->lock);
+            ctx->applyUpdates(updates);
+            continue;
+        }
+
+        uint64_t now = SDL_GetPerformanceCounter();
+        uint64_t nextWakeup = UINT64_MAX;
+
+        SDL_AtomicLock(&ctx->lock);
+        updates.swap(ctx->pendingUpdates);
+        float time = ctx->clock.time;
+        if(ctx->clock.playing)
+        {
+            time += (float)((double)(now - ctx->clock.counter) / (double)frequency) * ctx->clock.speed;
+        }
+
+        for(auto it = ctx->streams.begin(); it != ctx->streams.end();)
+        {
+            auto client = it->client.lock();
+            if(!client || client->Disconnecting())
+            {
+                it = ctx->streams.erase(it);
+                ctx->streamCount -= 1;
+                continue;
+            }
+
+            auto& stream = *it;
+            if(now >= stream.nextDue)
+            {
+                due.emplace_back(DueStream{ std::move(client), stream.scripts, stream.interpolation, false });
+                stream.nextDue += stream.interval;
+                // don't try to catch up after a stall
+                if(stream.nextDue <= now) stream.nextDue = now + stream.interval;
+            }
+            nextWakeup = std::min(nextWakeup, stream.nextDue);
+            ++it;
+        }
+        SDL_AtomicUnlock(&ctx->lock);
+
+        // the splines get updated and sampled without holding the lock
+        ctx->applyUpdates(updates);
+        for(auto& stream : due)
+        {
+            if(stream.sent) continue;
+            OFS_PROFILE("PositionStreamSample");
+            // streams of the same scripts share the message
+            targets.clear();
+            for(auto& other : due)
+            {
+                if(other.sent || other.interpolation != stream.interpolation) continue;
+                if(other.scripts != stream.scripts && *other.scripts != *stream.scripts) continue;
+                other.sent = true;
+                targets.emplace_back(other.client);
+            }
+
+            std::vector<float> positions;
+            positions.reserve(stream.scripts->size());
+            for(auto& name : *stream.scripts)
+            {
+                positions.emplace_back(ctx->sample(name, stream.interpolation, time));
+            }
+            ctx->serialization->PushTo<WsPositionChange>(targets, time, std::move(positions));
+        }
+        if(!due.empty()) ctx->serialization->StartProcessing();
+        due.clear();
+        targets.clear();
+
+        if(nextWakeup == UINT64_MAX) continue;
+        // short waits sleep at microsecond granularity and only yield for the last bit
+        now = SDL_GetPerformanceCounter();
+        if(nextWakeup > now)
+        {
+            uint64_t remainingUs = (nextWakeup - now) * 1000000 / frequency;
+            if(remainingUs >= 2000) SDL_CondWaitTimeout(ctx->wakeCond, waitMut, remainingUs / 1000 - 1);
+            else if(remainingUs > SpinUs) std::this_thread::sleep_for(std::chrono::microseconds(remainingUs - SpinUs));
+            else SDL_Delay(0);
+        }
+    }
+
+    SDL_UnlockMutex(waitMut);
+    SDL_DestroyMutex(waitMut);
+    ctx->hasExited = true;
+    return 0;
+}
+
+void OFS_WebsocketPositionStream::Start(const std::shared_ptr<OFS_WebsocketClient>& client, std::vector<std::string> scripts, float rate, Interpolation interpolation) noexcept
+{
+    SDL_AtomicLock(&lock);
+    auto it = std::find_if(streams.begin(), streams.end(),
+        [&client](auto& stream) noexcept { return stream.client.lock() == client; });
+    if(it != streams.end())
+    {
+        streams.erase(it);
+        streamCount -= 1;
+    }
+
+    if(!scripts.empty() && rate > 0.f)
+    {
+        rate = Util::Clamp(rate, MinRate, MaxRate);
+        auto& stream = streams.emplace_back();
+        stream.client = client;
+        stream.scripts = std::make_shared<const std::vector<std::string>>(std::move(scripts));
+        stream.interpolation = interpolation;
+        stream.interval = (uint64_t)((double)SDL_GetPerformanceFrequency() / rate);
+        stream.nextDue = SDL_GetPerformanceCounter();
+        streamCount += 1;
+    }
+    SDL_AtomicUnlock(&lock);
+    SDL_CondSignal(wakeCond);
+}
+
+void OFS_WebsocketPositionStream::pushUpdate(ScriptUpdate&& update) noexcept
+{
+    SDL_AtomicLock(&lock);
+    if(update.type == ScriptUpdate::Type::Clear) pendingUpdates.clear();
+    pendingUpdates.emplace_back(std::move(update));
+    SDL_AtomicUnlock(&lock);
+}
+
+void OFS_WebsocketPositionStream::SetScript(const std::string& name, const FunscriptArray& actions) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    // copied outside of the lock
+    ScriptUpdate update;
+    update.name = name;
+    update.actions = actions;
+    pushUpdate(std::move(update));
+}
+
+void OFS_WebsocketPositionStream::UpdateScript(const std::string& name, float startTime, float endTime,
+    FunscriptArray::const_iterator first, FunscriptArray::const_iterator last) noexcept
+{
+    ScriptUpdate update;
+    update.name = name;
+    update.startTime = startTime;
+    update.endTime = endTime;
+    update.actions.assign(first, last);
+    pushUpdate(std::move(update));
+}
+
+void OFS_WebsocketPositionStream::RemoveScript(const std::string& name) noexcept
+{
+    ScriptUpdate update;
+    update.type = ScriptUpdate::Type::Remove;
+    update.name = name;
+    pushUpdate(std::move(update));
+}
+
+void OFS_WebsocketPositionStream::ClearScripts() noexcept
+{
+    ScriptUpdate update;
+    update.type = ScriptUpdate::Type::Clear;
+    pushUpdate(std::move(update));
+}
+
+void OFS_WebsocketPositionStream::SetClock(float time, float speed, bool playing) noexcept
+{
+    uint64_t counter = SDL_GetPerformanceCounter();
+    SDL_AtomicLock(&lock);
+    clock.time = time;
+    clock.speed = speed;
+    clock.playing = playing;
+    clock.counter = counter;
+    SDL_AtomicUnlock(&lock);
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "FunscriptAction.h"
+#include "FunscriptSpline.h"
+
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+class OFS_WebsocketClient;
+struct EventSerializationContext;
+
+// Sends interpolated positions of the requested scripts at a fixed rate.
+// Runs on its own thread so the rate doesn't depend on the frame rate,
+// the messages go through the event serialization like every other event.
+class OFS_WebsocketPositionStream
+{
+    public:
+    enum class Interpolation : uint8_t
+    {
+        Linear,
+        Spline
+    };
+
+    static constexpr float MinRate = 1.f;
+    static constexpr float MaxRate = 1000.f;
+
+    private:
+    // a change to the actions of a script, applied by the timer thread outside of the lock
+    struct ScriptUpdate
+    {
+        enum class Type : uint8_t
+        {
+            Replace,
+            Remove,
+            Clear
+        };
+        Type type = Type::Replace;
+        std::string name;
+        // the actions between startTime and endTime get replaced
+        float startTime = std::numeric_limits<float>::lowest();
+        float endTime = std::numeric_limits<float>::max();
+        FunscriptArray actions;
+    };
+
+    // timer thread only, the knots of the spline are the actions
+    struct ScriptState
+    {
+        std::string name;
+        FunscriptSpline spline;
+        uint32_t version = 0;
+    };
+
+    struct Stream
+    {
+        std::weak_ptr<OFS_WebsocketClient> client;
+        // shared with the timer thread while sampling
+        std::shared_ptr<const std::vector<std::string>> scripts;
+        Interpolation interpolation = Interpolation::Linear;
+        uint64_t interval = 0;
+        uint64_t nextDue = 0;
+    };
+
+    // the last known player time, extrapolated while playing
+    struct PlaybackClock
+    {
+        float time = 0.f;
+        float speed = 1.f;
+        bool playing = false;
+        uint64_t counter = 0;
+    };
+
+    SDL_SpinLock lock = {0};
+    std::vector<ScriptUpdate> pendingUpdates;
+    std::vector<Stream> streams;
+    PlaybackClock clock;
+
+    std::vector<ScriptState> scripts;
+    EventSerializationContext* serialization = nullptr;
+
+    SDL_cond* wakeCond = nullptr;
+    std::atomic<bool> shouldExit = false;
+    std::atomic<bool> hasExited = false;
+    std::atomic<int32_t> streamCount = 0;
+
+    static int timerThread(void* user) noexcept;
+    // timer thread only
+    void applyUpdates(std::vector<ScriptUpdate>& updates) noexcept;
+    float sample(const std::string& name, Interpolation interpolation, float time) noexcept;
+    void pushUpdate(ScriptUpdate&& update) noexcept;
+
+    public:
+    OFS_WebsocketPositionStream(EventSerializationContext* serialization) noexcept;
+    OFS_WebsocketPositionStream(const OFS_WebsocketPositionStream&) = delete;
+    OFS_WebsocketPositionStream(OFS_WebsocketPositionStream&&) = delete;
+    ~OFS_WebsocketPositionStream() noexcept;
+
+    // Replaces the stream of the client. No scripts or a rate of 0 stops it.
+    void Start(const std::shared_ptr<OFS_WebsocketClient>& client, std::vector<std::string> scripts, float rate, Interpolation interpolation) noexcept;
+
+    // Main thread only. The scripts have to be kept up to date while Active.
+    void SetScript(const std::string& name, const FunscriptArray& actions) noexcept;
+    // Main thread only. The actions between startTime and endTime were replaced by [first, last).
+    void UpdateScript(const std::string& name, float startTime, float endTime,
+        FunscriptArray::const_iterator first, FunscriptArray::const_iterator last) noexcept;
+    void RemoveScript(const std::string& name) noexcept;
+    void ClearScripts() noexcept;
+    void SetClock(float time, float speed, bool playing) noexcept;
+
+    inline bool Active() const noexcept { return streamCount > 0; }
+    void Shutdown() noexcept;
+};
@@ -0,0 +1,190 @@
+#include "OFS_LuaBytecodeCache.h"
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+
+#include "SDL_thread.h"
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+static constexpr uint32_t CacheMagic = 0x4C53464F; // "OFSL"
+// bump when the layout of the entries changes
+static constexpr uint32_t CacheVersion = 1;
+
+struct CacheHeader
+{
+	uint32_t magic = CacheMagic;
+	uint32_t version = CacheVersion;
+	uint64_t pathHash = 0;
+	int64_t sourceTime = 0;
+	uint64_t sourceSize = 0;
+	uint64_t sourceHash = 0;
+	uint64_t bytecodeSize = 0;
+	uint64_t bytecodeHash = 0;
+};
+
+// written once by Init before any lua state exists
+static std::string CacheDirectory;
+
+inline static uint64_t fnv1a(const void* data, size_t size) noexcept
+{
+	auto bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i += 1) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static bool readEntry(const std::string& cachePath, uint64_t pathHash, std::vector<uint8_t>& entry, CacheHeader& header) noexcept
+{
+	if (Util::ReadFile(cachePath.c_str(), entry) < sizeof(CacheHeader)) return false;
+	memcpy(&header, entry.data(), sizeof(CacheHeader));
+	// a torn write from another thread or process fails the bytecode hash
+	return header.magic == CacheMagic
+		&& header.version == CacheVersion
+		&& header.pathHash == pathHash
+		&& header.bytecodeSize == entry.size() - sizeof(CacheHeader)
+		&& header.bytecodeHash == fnv1a(entry.data() + sizeof(CacheHeader), header.bytecodeSize);
+}
+
+static void writeEntry(const std::string& cachePath, const CacheHeader& header, std::vector<uint8_t>& entry) noexcept
+{
+	memcpy(entry.data(), &header, sizeof(CacheHeader));
+	// jobs may write the same entry at the same time
+	char suffix[32];
+	stbsp_snprintf(suffix, sizeof(suffix), ".%lu.tmp", (unsigned long)SDL_ThreadID());
+	auto tmpPath = cachePath + suffix;
+	if (Util::WriteFile(tmpPath.c_str(), entry.data(), entry.size()) != entry.size()) {
+		LOGF_WARN("Failed to write lua cache entry \"%s\"", tmpPath.c_str());
+		return;
+	}
+	std::error_code ec;
+	std::filesystem::rename(Util::PathFromString(tmpPath), Util::PathFromString(cachePath), ec);
+	if (ec) {
+		std::filesystem::remove(Util::PathFromString(tmpPath), ec);
+	}
+}
+
+static int dumpWriter(lua_State* L, const void* data, size_t size, void* user) noexcept
+{
+	auto entry = static_cast<std::vector<uint8_t>*>(user);
+	auto bytes = static_cast<const uint8_t*>(data);
+	entry->insert(entry->end(), bytes, bytes + size);
+	return 0;
+}
+
+inline static bool loadBytecode(lua_State* L, const std::vector<uint8_t>& entry, const char* chunkName) noexcept
+{
+	auto status = luaL_loadbufferx(L, (const char*)entry.data() + sizeof(CacheHeader),
+		entry.size() - sizeof(CacheHeader), chunkName, "b");
+	if (status == LUA_OK) return true;
+	// most likely compiled by a different lua version
+	lua_pop(L, 1);
+	return false;
+}
+
+void OFS_LuaBytecodeCache::Init() noexcept
+{
+	CacheDirectory = Util::Prefpath(CacheDir);
+	Util::CreateDirectories(Util::PathFromString(CacheDirectory));
+}
+
+int OFS_LuaBytecodeCache::LoadFile(lua_State* L, const char* path) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto filePath = Util::PathFromString(path);
+	std::string chunkName = std::string("@") + path;
+
+	std::error_code ec;
+	int64_t sourceTime = std::filesystem::last_write_time(filePath, ec).time_since_epoch().count();
+	if (ec) sourceTime = 0;
+	uint64_t sourceSize = std::filesystem::file_size(filePath, ec);
+	if (ec) sourceSize = 0;
+
+	uint64_t pathHash = fnv1a(path, strlen(path));
+	char name[32];
+	stbsp_snprintf(name, sizeof(name), "%016llx.luac", (unsigned long long)pathHash);
+	auto cachePath = (Util::PathFromString(CacheDirectory) / name).u8string();
+
+	std::vector<uint8_t> entry;
+	CacheHeader header;
+	bool hasEntry = !CacheDirectory.empty() && readEntry(cachePath, pathHash, entry, header);
+
+	// unchanged file, the source doesn't have to be read
+	if (hasEntry && sourceTime != 0 && header.sourceTime == sourceTime && header.sourceSize == sourceSize) {
+		if (loadBytecode(L, entry, chunkName.c_str())) return LUA_OK;
+		hasEntry = false;
+	}
+
+	std::vector<uint8_t> source;
+	if (!Util::ReadFile(path, source) && !Util::FileExists(path)) {
+		lua_pushfstring(L, "cannot open %s", path);
+		return LUA_ERRFILE;
+	}
+	uint64_t sourceHash = fnv1a(source.data(), source.size());
+
+	// only touched, remember the new modification time
+	if (hasEntry && header.sourceSize == source.size() && header.sourceHash == sourceHash) {
+		if (loadBytecode(L, entry, chunkName.c_str())) {
+			header.sourceTime = sourceTime;
+			writeEntry(cachePath, header, entry);
+			return LUA_OK;
+		}
+	}
+
+	auto status = luaL_loadbufferx(L, (const char*)source.data(), source.size(), chunkName.c_str(), nullptr);
+	if (status != LUA_OK || CacheDirectory.empty()) return status;
+
+	// debug info is kept for error messages
+	entry.assign(sizeof(CacheHeader), 0);
+	if (lua_dump(L, dumpWriter, &entry, 0) != 0) return LUA_OK;
+
+	header = CacheHeader();
+	header.pathHash = pathHash;
+	header.sourceTime = sourceTime;
+	header.sourceSize = source.size();
+	header.sourceHash = sourceHash;
+	header.bytecodeSize = entry.size() - sizeof(CacheHeader);
+	header.bytecodeHash = fnv1a(entry.data() + sizeof(CacheHeader), header.bytecodeSize);
+	writeEntry(cachePath, header, entry);
+	return LUA_OK;
+}
+
+static int cachedSearcher(lua_State* L) noexcept
+{
+	const char* name = luaL_checkstring(L, 1);
+	// the package table is the upvalue
+	lua_getfield(L, lua_upvalueindex(1), "searchpath");
+	lua_pushvalue(L, 1);
+	lua_getfield(L, lua_upvalueindex(1), "path");
+	lua_call(L, 2, 2);
+	// not found, the default lua searcher reports the paths which were tried
+	if (lua_isnil(L, -2)) return 0;
+
+	const char* filename = lua_tostring(L, -2);
+	if (OFS_LuaBytecodeCache::LoadFile(L, filename) != LUA_OK) {
+		return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+			name, filename, lua_tostring(L, -1));
+	}
+	lua_pushstring(L, filename);
+	return 2;
+}
+
+void OFS_LuaBytecodeCache::InstallSearcher(lua_State* L) noexcept
+{
+	lua_getglobal(L, "package");
+	lua_getfield(L, -1, "searchers");
+	// right after the preload searcher
+	for (lua_Integer i = luaL_len(L, -1); i >= 2; i -= 1) {
+		lua_rawgeti(L, -1, i);
+		lua_rawseti(L, -2, i + 1);
+	}
+	lua_pushvalue(L, -2);
+	lua_pushcclosure(L, cachedSearcher, 1);
+	lua_rawseti(L, -2, 2);
+	lua_pop(L, 2);
+}
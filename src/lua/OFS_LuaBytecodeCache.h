@@ -0,0 +1,21 @@
+#pragma once
+#include "OFS_Lua.h"
+
+// Keeps the compiled bytecode of lua files in the prefpath.
+// An entry is used as is while the modification time and size of the file are unchanged,
+// otherwise the content hash decides if the file has to be compiled again.
+class OFS_LuaBytecodeCache
+{
+	public:
+		static constexpr const char* CacheDir = "lua_cache";
+
+		// main thread only, has to be called before anything gets loaded
+		static void Init() noexcept;
+
+		// Like luaL_loadfile, pushes the chunk or an error message. Thread safe.
+		static int LoadFile(lua_State* L, const char* path) noexcept;
+
+		// Adds a package.searchers entry in front of the default lua searcher
+		// which loads the modules found on package.path through the cache.
+		static void InstallSearcher(lua_State* L) noexcept;
+};
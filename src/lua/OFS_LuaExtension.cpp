@@ -1,10 +1,147 @@
 #include "OFS_LuaExtension.h"
 #include "OFS_LuaExtensions.h"
+#include "OFS_LuaBytecodeCache.h"
 #include "OFS_Util.h"
+#include "OFS_Profiling.h"
 #include "OpenFunscripter.h"
 
+#include "SDL_thread.h"
+#include "SDL_timer.h"
+
+#include <atomic>
 #include <string>
 
+// the extension whose lua code is currently running, main thread only
+static OFS_LuaExtension* RunningExtension = nullptr;
+
+void OFS_LuaExtension::instructionHook(lua_State* L, lua_Debug* ar) noexcept
+{
+	auto ext = RunningExtension;
+	if(!ext) return;
+	ext->instructionsUsed += HookInstructionStep;
+	uint64_t budget = (uint64_t)OFS_LuaExtensions::InstructionBudget * 1000000;
+	// keeps raising the error in case lua code catches it with pcall
+	if(budget > 0 && ext->instructionsUsed > budget) {
+		ext->budgetExceeded = true;
+		luaL_error(L, "Exceeded the instruction budget of %d million instructions.", (int)OFS_LuaExtensions::InstructionBudget);
+	}
+}
+
+template<typename... Args>
+bool OFS_LuaExtension::call(Call type, const sol::protected_function& func, Args&&... args) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto previous = RunningExtension;
+	RunningExtension = this;
+	instructionsUsed = 0;
+	budgetExceeded = false;
+
+	uint64_t start = SDL_GetPerformanceCounter();
+	auto res = func(std::forward<Args>(args)...);
+	uint64_t end = SDL_GetPerformanceCounter();
+	RunningExtension = previous;
+	timings[(size_t)type].Add((float)((double)(end - start) * 1000.0 / (double)SDL_GetPerformanceFrequency()));
+
+	if(res.status() != sol::call_status::ok) {
+		auto err = sol::stack::get_traceback_or_errors(L.lua_state());
+		AddError(err.what());
+		if(budgetExceeded) {
+			// most likely stuck in a loop, calling it again won't help
+			Suspended = true;
+			AddError(Util::Format("%s was suspended while running %s.", Name.c_str(), CallName(type)));
+		}
+		return false;
+	}
+	return true;
+}
+
+const char* OFS_LuaExtension::CallName(Call call) noexcept
+{
+	switch(call) {
+		case Call::Init: return OFS_LuaExtensions::InitFunction;
+		case Call::Update: return OFS_LuaExtensions::UpdateFunction;
+		case Call::Gui: return OFS_LuaExtensions::RenderGui;
+		case Call::ScriptChange: return OFS_LuaExtension::ScriptChangeFunction;
+		case Call::Binding: return OFS_LuaExtension::BindingTable;
+		case Call::Job: return "job";
+		case Call::Process: return "process";
+		default: return "";
+	}
+}
+
+void OFS_LuaExtension::resetTimings() noexcept
+{
+	timings = {};
+	skipUpdates = 0;
+	skippedDelta = 0.f;
+	Suspended = false;
+}
+
+void OFS_LuaExtension::deliverJobs() noexcept
+{
+	if(!api) return;
+	api->jobAPI->TakeFinished(finishedJobs);
+	for(auto& job : finishedJobs) {
+		auto& data = job->Data();
+		if(!data.log.empty()) {
+			std::string log = "[" + Name + " " + data.function + "]:\n" + data.log;
+			OFS_LuaExtensions::ExtensionLogBuffer.AddLog(log.c_str());
+		}
+		auto callback = job->TakeCallback();
+		if(data.error.empty()) {
+			call(Call::Job, callback, data.result.ToLua(L));
+		}
+		else {
+			call(Call::Job, callback, sol::lua_nil, data.error);
+		}
+	}
+	finishedJobs.clear();
+}
+
+void OFS_LuaExtension::deliverProcessOutput() noexcept
+{
+	if(!api) return;
+	api->procAPI->TakeCallbacks(processCallbacks);
+	for(auto& callback : processCallbacks) {
+		if(callback.exit) {
+			call(Call::Process, callback.function, callback.exitCode);
+		}
+		else {
+			call(Call::Process, callback.function, callback.line);
+		}
+	}
+	processCallbacks.clear();
+}
+
+void OFS_LuaExtension::Resume() noexcept
+{
+	Suspended = false;
+	ClearError();
+}
+
+void OFS_LuaExtension::ShowTimings() noexcept
+{
+	if(!ImGui::BeginTable("##extensionTimings", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) return;
+	ImGui::TableSetupColumn("");
+	ImGui::TableSetupColumn(TR(CALLS));
+	ImGui::TableSetupColumn(TR(AVG_MS));
+	ImGui::TableSetupColumn(TR(MAX_MS));
+	ImGui::TableHeadersRow();
+	for(size_t i = 0; i < timings.size(); i += 1) {
+		auto& timing = timings[i];
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(CallName((Call)i));
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", timing.Calls);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", timing.AverageMs);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", timing.MaxMs);
+	}
+	ImGui::EndTable();
+}
+
 void OFS_LuaExtension::Toggle() noexcept
 {
     if (!this->Active) {
@@ -18,6 +155,9 @@ void OFS_LuaExtension::Toggle() noexcept
 void OFS_LuaExtension::ShowWindow() noexcept
 {
 	if(!WindowOpen || !Active) return;
+	// still loading in the background
+	if(pending && !pending->finished) return;
+	ensureLoaded();
 	ImGui::Begin(NameId.c_str(), &WindowOpen, ImGuiWindowFlags_None);
 	if(!Error.empty())
 	{
@@ -39,11 +179,7 @@ void OFS_LuaExtension::ShowWindow() noexcept
 	}
 
 	auto gui = L.get<sol::protected_function>(OFS_LuaExtensions::RenderGui);
-	auto res = gui();
-	if(res.status() != sol::call_status::ok) {
-		auto err = sol::stack::get_traceback_or_errors(L.lua_state());
-		AddError(err.what());
-	}
+	call(Call::Gui, gui);
 	if(!api->guiAPI->Validate()) {
 		AddError(api->guiAPI->Error().c_str());
 	}
@@ -52,41 +188,51 @@ void OFS_LuaExtension::ShowWindow() noexcept
 
 void OFS_LuaExtension::Update() noexcept
 {
-	if(!Active) return;
-	auto update = L.get<sol::protected_function>(OFS_LuaExtensions::UpdateFunction);
-	auto res = update(ImGui::GetIO().DeltaTime);
-	if(res.status() != sol::call_status::ok)
-	{
-		auto err = sol::stack::get_traceback_or_errors(L.lua_state());
-		AddError(err.what());
+	if(!Active || Suspended) return;
+	if(pending) {
+		if(!pending->finished) return;
+		auto load = std::move(pending);
+		finishLoad(*load);
 	}
-}
+	if(deferred) return;
+	// results of jobs and process output don't wait for throttled updates
+	deliverJobs();
+	deliverProcessOutput();
 
-bool OFS_LuaExtension::Load() noexcept
-{
-    auto directory = Util::PathFromString(this->Directory);
-    auto mainFile = directory / OFS_LuaExtension::MainFile;
+	float delta = ImGui::GetIO().DeltaTime;
+	if(skipUpdates > 0) {
+		skipUpdates -= 1;
+		skippedDelta += delta;
+		return;
+	}
 
-	NameId = directory.filename().u8string();
-	NameId = Util::Format("%s##_%s_", Name.c_str(), Name.c_str());
-	ClearError();
+	auto update = L.get<sol::protected_function>(OFS_LuaExtensions::UpdateFunction);
+	call(Call::Update, update, delta + skippedDelta);
+	skippedDelta = 0.f;
 
-	std::string extensionText;
-	{
-		std::vector<uint8_t> dataBuf;
-		if (!Util::ReadFile(mainFile.u8string().c_str(), dataBuf)) {
-			FUN_ASSERT(false, "no file");
-			return false;
-		}
-		extensionText = std::string((char*)dataBuf.data(), dataBuf.size());
+	// slow extensions get updated less often, with the delta of the skipped frames
+	float budget = OFS_LuaExtensions::UpdateBudgetMs;
+	float last = Timing(Call::Update).LastMs;
+	if(budget > 0.f && last > budget) {
+		skipUpdates = std::min((uint32_t)(last / budget), MaxSkippedUpdates);
 	}
+}
 
-	//UpdateTime = 0.f;
-	//MaxUpdateTime = 0.f;
-	//MaxGuiTime = 0.f;
-	//Bindables.clear();
+struct OFS_LuaExtension::LoadState
+{
+	// main has to be released before the state
+	sol::state L;
+	sol::protected_function main;
+	std::string directory;
+	std::string error;
+	std::atomic<bool> finished = false;
+};
 
-	L = sol::state();
+void OFS_LuaExtension::prepare(LoadState& load) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	auto& L = load.L;
+	lua_sethook(L.lua_state(), instructionHook, LUA_MASKCOUNT, HookInstructionStep);
 	L.open_libraries(
 		sol::lib::base,
 		sol::lib::package,
@@ -112,10 +258,46 @@ bool OFS_LuaExtension::Load() noexcept
 			lua_setfield(L, -2, "path"); // set the field "path" in table at -2 with value at top of stack
 			lua_pop(L, 1); // get rid of package table from top of stack
 		};
-		auto dirPath = Util::PathFromString(Directory);
+		auto dirPath = Util::PathFromString(load.directory);
 		addToLuaPath(L.lua_state(), (dirPath / "?.lua").u8string().c_str());
 		addToLuaPath(L.lua_state(), (dirPath / "lib" / "?.lua").u8string().c_str());
 	}
+	OFS_LuaBytecodeCache::InstallSearcher(L.lua_state());
+
+	auto mainFile = Util::PathFromString(load.directory) / OFS_LuaExtension::MainFile;
+	if(OFS_LuaBytecodeCache::LoadFile(L.lua_state(), mainFile.u8string().c_str()) != LUA_OK) {
+		load.error = lua_tostring(L.lua_state(), -1);
+		lua_pop(L.lua_state(), 1);
+		return;
+	}
+	load.main = sol::protected_function(L.lua_state(), -1);
+	lua_pop(L.lua_state(), 1);
+}
+
+int OFS_LuaExtension::loadThread(void* user) noexcept
+{
+	auto data = static_cast<std::shared_ptr<LoadState>*>(user);
+	auto load = std::move(*data);
+	delete data;
+	prepare(*load);
+	load->finished = true;
+	return 0;
+}
+
+bool OFS_LuaExtension::finishLoad(LoadState& load) noexcept
+{
+	OFS_PROFILE(__FUNCTION__);
+	ClearError();
+	resetTimings();
+
+	// releases its references into the old state first
+	api.reset();
+	sol::protected_function main = std::move(load.main);
+	L = std::move(load.L);
+	if(!load.error.empty()) {
+		AddError(load.error.c_str());
+		return false;
+	}
 
 	auto ofs = L.new_usertype<OFS_ExtensionAPI>("ofs");
 	ofs["Version"] = []() noexcept { return OFS_ExtensionAPI::VersionAPI; };
@@ -151,16 +333,11 @@ bool OFS_LuaExtension::Load() noexcept
 
 	try
 	{
-		auto res = L.safe_script(extensionText);
-		FUN_ASSERT(res.valid(), "what");
+		// the main chunk counts towards init
+		if(!call(Call::Init, main)) return false;
 
 		auto init = L.get<sol::protected_function>(OFS_LuaExtensions::InitFunction);
-		res = init();
-		if(res.status() != sol::call_status::ok) {
-			auto err = sol::stack::get_traceback_or_errors(L.lua_state());
-			AddError(err.what());
-			return false;
-		}
+		if(!call(Call::Init, init)) return false;
 	}
 	catch(const std::exception& e)
 	{
@@ -168,6 +345,7 @@ bool OFS_LuaExtension::Load() noexcept
 		return false;
 	}
 
+	BindingNames.clear();
 	sol::table btable = L[OFS_LuaExtension::BindingTable];
 	if(btable.valid()) {
 		auto app = OpenFunscripter::ptr;
@@ -177,42 +355,94 @@ bool OFS_LuaExtension::Load() noexcept
 			std::string name = keyStr;
 			std::string globalName = Util::Format("%s::%s", Name.c_str(), keyStr);
 			app->extensions->AddBinding(NameId, globalName, name);
+			BindingNames.emplace_back(std::move(name));
 		}
 	}
 
 	return true;
 }
 
+bool OFS_LuaExtension::Load() noexcept
+{
+	auto directory = Util::PathFromString(this->Directory);
+	NameId = directory.filename().u8string();
+	NameId = Util::Format("%s##_%s_", Name.c_str(), Name.c_str());
+
+	// a reload replaces whatever was going on
+	pending.reset();
+	deferred = false;
+
+	LoadState load;
+	load.directory = Directory;
+	prepare(load);
+	return finishLoad(load);
+}
+
+void OFS_LuaExtension::LoadAsync() noexcept
+{
+	auto directory = Util::PathFromString(this->Directory);
+	NameId = directory.filename().u8string();
+	NameId = Util::Format("%s##_%s_", Name.c_str(), Name.c_str());
+	deferred = false;
+
+	pending = std::make_shared<LoadState>();
+	pending->directory = Directory;
+	auto data = new std::shared_ptr<LoadState>(pending);
+	auto handle = SDL_CreateThread(loadThread, "OFS_LuaExtensionLoad", data);
+	if(!handle) {
+		delete data;
+		Load();
+		return;
+	}
+	SDL_DetachThread(handle);
+}
+
+void OFS_LuaExtension::Defer() noexcept
+{
+	pending.reset();
+	deferred = true;
+}
+
+bool OFS_LuaExtension::ensureLoaded() noexcept
+{
+	if(deferred) {
+		return Load();
+	}
+	if(pending) {
+		// needed right now
+		while(!pending->finished) {
+			SDL_Delay(1);
+		}
+		auto load = std::move(pending);
+		return finishLoad(*load);
+	}
+	return true;
+}
+
 void OFS_LuaExtension::Execute(const std::string& func) noexcept
 {
+	if(!ensureLoaded()) return;
 	sol::protected_function bind = L[OFS_LuaExtension::BindingTable][func];
-	if(bind.valid()) {
-		auto res = bind();
-		if(res.status() != sol::call_status::ok) {
-			auto err = sol::stack::get_traceback_or_errors(L.lua_state());
-			AddError(err.what());
-		}
+	if(bind.valid() && !Suspended) {
+		call(Call::Binding, bind);
 	}
 }
 
 void OFS_LuaExtension::ScriptChanged(uint32_t scriptIdx) noexcept
 {
+	if(deferred || pending) return;
 	sol::protected_function change = L[OFS_LuaExtension::ScriptChangeFunction];
-	if(change.valid()) {
-		auto res = change(scriptIdx + 1);
-		if(res.status() != sol::call_status::ok) {
-			auto err = sol::stack::get_traceback_or_errors(L.lua_state());
-			AddError(err.what());
-		}
+	if(change.valid() && !Suspended) {
+		call(Call::ScriptChange, change, scriptIdx + 1);
 	}
 }
 
 void OFS_LuaExtension::Shutdown() noexcept
 {
-	// UpdateTime = 0.f;
-	// MaxUpdateTime = 0.f;
-	// MaxGuiTime = 0.f;
-	// Bindables.clear();
+	resetTimings();
+	pending.reset();
+	deferred = false;
+	api.reset();
 	L = sol::state();
 	Active = false;
 }
\ No newline at end of file
@@ -4,14 +4,76 @@
 #include "OFS_LuaExtensionAPI.h"
 #include "OFS_Util.h"
 
+#include <algorithm>
+#include <array>
 #include <memory>
 
+// rolling timing of one kind of call into an extension
+struct OFS_LuaTiming
+{
+	float LastMs = 0.f;
+	float AverageMs = 0.f;
+	float MaxMs = 0.f;
+	uint32_t Calls = 0;
+
+	inline void Add(float ms) noexcept
+	{
+		LastMs = ms;
+		AverageMs = Calls == 0 ? ms : AverageMs + (ms - AverageMs) * 0.05f;
+		MaxMs = std::max(MaxMs, ms);
+		Calls += 1;
+	}
+};
+
 class OFS_LuaExtension
 {
+	public:
+		enum class Call : uint8_t
+		{
+			Init,
+			Update,
+			Gui,
+			ScriptChange,
+			Binding,
+			Job,
+			Process,
+			Count
+		};
 	private:
 		sol::state L;
 		std::unique_ptr<OFS_ExtensionAPI> api = nullptr;
+
+		std::array<OFS_LuaTiming, (size_t)Call::Count> timings;
+		uint64_t instructionsUsed = 0;
+		bool budgetExceeded = false;
+		// throttling of slow update functions
+		uint32_t skipUpdates = 0;
+		float skippedDelta = 0.f;
+		std::vector<std::shared_ptr<OFS_LuaJob>> finishedJobs;
+		std::vector<OFS_LuaProcessCallback> processCallbacks;
+		// state created and main file compiled on a worker thread
+		struct LoadState;
+		std::shared_ptr<LoadState> pending;
+		// active but not loaded until it's opened or a binding is used
+		bool deferred = false;
+
+		static void instructionHook(lua_State* L, lua_Debug* ar) noexcept;
+		// calls into lua with timing and the instruction budget applied
+		template<typename... Args>
+		bool call(Call type, const sol::protected_function& func, Args&&... args) noexcept;
+		void resetTimings() noexcept;
+		void deliverJobs() noexcept;
+		void deliverProcessOutput() noexcept;
+		// the part of loading which doesn't touch the app
+		static void prepare(LoadState& load) noexcept;
+		static int loadThread(void* user) noexcept;
+		bool finishLoad(LoadState& load) noexcept;
+		// loads a deferred extension or waits for a pending load
+		bool ensureLoaded() noexcept;
     public:
+		// the hook checks the budget every this many instructions
+		static constexpr int HookInstructionStep = 10000;
+		static constexpr uint32_t MaxSkippedUpdates = 30;
 		static constexpr const char* MainFile = "main.lua";
 		static constexpr const char* BindingTable = "binding";
 		static constexpr const char* ScriptChangeFunction = "scriptChange";
@@ -22,9 +84,18 @@ class OFS_LuaExtension
 		std::string Error;
 		bool Active = false;
 		bool WindowOpen = false;
+		// set when the instruction budget was exceeded
+		bool Suspended = false;
+		// names of the bindings, known before a deferred extension is loaded
+		std::vector<std::string> BindingNames;
 
 		inline bool HasError() const noexcept { return !Error.empty(); }
 		bool Load() noexcept;
+		// like Load but the state gets prepared on a worker thread, finished by Update
+		void LoadAsync() noexcept;
+		void Defer() noexcept;
+		inline bool Deferred() const noexcept { return deferred; }
+		inline bool Loading() const noexcept { return pending != nullptr; }
 		
 		void AddError(const char* str) noexcept {
 			LOG_ERROR(str);
@@ -38,8 +109,13 @@ class OFS_LuaExtension
 		void Shutdown() noexcept;
 		void Toggle() noexcept;
 		void ScriptChanged(uint32_t scriptIdx) noexcept;
+		void Resume() noexcept;
 
 		void Execute(const std::string& function) noexcept;
+
+		static const char* CallName(Call call) noexcept;
+		inline const OFS_LuaTiming& Timing(Call call) const noexcept { return timings[(size_t)call]; }
+		void ShowTimings() noexcept;
 };
 
 REFL_TYPE(OFS_LuaExtension)
@@ -48,4 +124,5 @@ REFL_TYPE(OFS_LuaExtension)
 	REFL_FIELD(Directory)
 	REFL_FIELD(Active)
 	REFL_FIELD(WindowOpen)
+	REFL_FIELD(BindingNames)
 REFL_END
\ No newline at end of file
@@ -41,6 +41,7 @@ OFS_ExtensionAPI::OFS_ExtensionAPI(sol::usertype<class OFS_ExtensionAPI>& ofs) n
 	procAPI = std::make_unique<OFS_ProcessAPI>(ofs);
     scriptAPI = std::make_unique<OFS_ScriptAPI>(ofs);
     playerAPI = std::make_unique<OFS_PlayerAPI>(L);
+    jobAPI = std::make_unique<OFS_JobAPI>(ofs);
 
 	L.set_function("print", LuaPrint);
 
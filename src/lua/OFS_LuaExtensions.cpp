@@ -3,9 +3,13 @@
 #include "OFS_Util.h"
 #include "OFS_Profiling.h"
 #include "OFS_LuaCoreExtension.h"
+#include "OFS_LuaBytecodeCache.h"
 
 bool OFS_LuaExtensions::DevMode = false;
 bool OFS_LuaExtensions::ShowLogs = false;
+bool OFS_LuaExtensions::LazyLoading = false;
+uint32_t OFS_LuaExtensions::InstructionBudget = 100;
+float OFS_LuaExtensions::UpdateBudgetMs = 0.f;
 
 OFS::AppLog OFS_LuaExtensions::ExtensionLogBuffer;
 
@@ -18,6 +22,7 @@ inline static void ShowExtensionLogWindow(bool* open) noexcept
 OFS_LuaExtensions::OFS_LuaExtensions() noexcept
 {
 	load(Util::Prefpath("extension.json"));
+	OFS_LuaBytecodeCache::Init();
 	Extensions.reserve(100); // NOTE: this is mitigate a relocation bug
 	UpdateExtensionList();
 	
@@ -34,8 +39,20 @@ OFS_LuaExtensions::~OFS_LuaExtensions() noexcept
 
 bool OFS_LuaExtensions::Init() noexcept
 {
+	OFS_PROFILE(__FUNCTION__);
 	for (auto& ext : Extensions) {
-		if (ext.Active) ext.Load();
+		if (!ext.Active) continue;
+		if (LazyLoading && !ext.WindowOpen) {
+			// the bindings have to work before it gets loaded
+			ext.Defer();
+			for (auto& name : ext.BindingNames) {
+				AddBinding(ext.NameId, Util::Format("%s::%s", ext.Name.c_str(), name.c_str()), name);
+			}
+		}
+		else {
+			// init runs in Update once the state is ready
+			ext.LoadAsync();
+		}
 	}
 	return true;
 }
@@ -122,7 +139,7 @@ void OFS_LuaExtensions::ShowExtensions() noexcept
 void OFS_LuaExtensions::ReloadEnabledExtensions() noexcept
 {
     for(auto& ext : Extensions) {
-		if(ext.Active) {
+		if(ext.Active && !ext.Deferred()) {
 			ext.Load();
 		}
 	}
@@ -29,6 +29,13 @@ class OFS_LuaExtensions
         static constexpr const char* DynamicBindingHandler = "OFS_LuaExtensions";
         static bool DevMode;
         static bool ShowLogs;
+        // closed extensions get loaded when they're opened or a binding is used,
+        // opt-in because their update and scriptChange don't run until then
+        static bool LazyLoading;
+        // per call, in millions of instructions, 0 is unlimited
+        static uint32_t InstructionBudget;
+        // 0 disables throttling
+        static float UpdateBudgetMs;
         static OFS::AppLog ExtensionLogBuffer;
         std::vector<OFS_LuaExtension> Extensions;
 
@@ -62,4 +69,7 @@ REFL_TYPE(OFS_LuaExtensions)
     REFL_FIELD(Extensions)
     REFL_FIELD(DevMode)
     REFL_FIELD(ShowLogs)
+    REFL_FIELD(LazyLoading)
+    REFL_FIELD(InstructionBudget)
+    REFL_FIELD(UpdateBudgetMs)
 REFL_END
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "OFS_LuaJobAPI.h"
+#include "OFS_LuaExtensionAPI.h"
+#include "OFS_LuaExtensions.h"
+#include "OFS_LuaScriptAPI.h"
+#include "OFS_LuaBytecodeCache.h"
+
+#include "OFS_Util.h"
+#include "OFS_Profiling.h"
+
+#include "SDL_cpuinfo.h"
+#include "SDL_mutex.h"
+#include "SDL_thread.h"
+
+#include <deque>
+
+static constexpr const char* JobRegistryKey = "OFS_Job";
+// cancellation is checked every this many instructions
+static constexpr int CancelCheckInstructions = 100000;
+
+// MaxConcurrentJobs workers pull the started jobs from the queue, they live as long as the app
+static SDL_mutex* JobQueueMut = nullptr;
+static SDL_cond* JobQueueCond = nullptr;
+static std::deque<std::shared_ptr<OFS_LuaJob::Shared>> JobQueue;
+static int32_t JobWorkers = 0;
+
+bool OFS_LuaJobValue::FromLua(const sol::object& obj, OFS_LuaJobValue& out, std::string& error, int32_t depth) noexcept
+{
+    if(depth > MaxDepth) {
+        error = "Tables passed to or from a job are nested too deep or contain themselves.";
+        return false;
+    }
+
+    switch(obj.get_type()) {
+        case sol::type::none:
+        case sol::type::lua_nil:
+            out.type = Type::Nil;
+            return true;
+        case sol::type::boolean:
+            out.type = Type::Boolean;
+            out.boolean = obj.as<bool>();
+            return true;
+        case sol::type::number:
+        {
+            auto L = obj.lua_state();
+            obj.push(L);
+            bool isInteger = lua_isinteger(L, -1);
+            lua_pop(L, 1);
+            if(isInteger) {
+                out.type = Type::Integer;
+                out.integer = obj.as<lua_Integer>();
+            }
+            else {
+                out.type = Type::Number;
+                out.number = obj.as<lua_Number>();
+            }
+            return true;
+        }
+        case sol::type::string:
+            out.type = Type::String;
+            out.string = obj.as<std::string>();
+            return true;
+        case sol::type::table:
+        {
+            out.type = Type::Table;
+            sol::table table = obj;
+            for(auto&& [key, value] : table) {
+                auto& entry = out.table.emplace_back();
+                if(!FromLua(key, entry.first, error, depth + 1)
+                    || !FromLua(value, entry.second, error, depth + 1)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case sol::type::userdata:
+        {
+            // scripts get copied, script data is shared
+            if(obj.is<OFS_LuaScriptData>()) {
+                out.actions = obj.as<OFS_LuaScriptData&>().Actions();
+            }
+            else if(obj.is<LuaFunscript>()) {
+                out.actions = obj.as<LuaFunscript&>().CopyActions();
+            }
+            else if(obj.is<LuaFunscriptView>()) {
+                out.actions = obj.as<LuaFunscriptView&>().CopyActions();
+            }
+            if(out.actions) {
+                out.type = Type::Actions;
+                return true;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    // Util::Format isn't thread safe
+    error = std::string("Can't pass a ") + sol::type_name(obj.lua_state(), obj.get_type()) + " to or from a job.";
+    return false;
+}
+
+sol::object OFS_LuaJobValue::ToLua(sol::state_view L) const noexcept
+{
+    switch(type) {
+        case Type::Boolean:
+            return sol::make_object(L, boolean);
+        case Type::Integer:
+            return sol::make_object(L, integer);
+        case Type::Number:
+            return sol::make_object(L, number);
+        case Type::String:
+            return sol::make_object(L, string);
+        case Type::Table:
+        {
+            auto t = L.create_table();
+            for(auto& [key, value] : table) {
+                t.raw_set(key.ToLua(L), value.ToLua(L));
+            }
+            return t;
+        }
+        case Type::Actions:
+            return sol::make_object(L, OFS_LuaScriptData(actions));
+        default:
+            return sol::make_object(L, sol::lua_nil);
+    }
+}
+
+lua_Integer OFS_LuaScriptData::Length() const noexcept
+{
+    return actions->size();
+}
+
+std::tuple<lua_Number, lua_Integer> OFS_LuaScriptData::Get(lua_Integer idx, sol::this_state L) const noexcept
+{
+    idx -= 1;
+    if(idx < 0 || idx >= actions->size()) {
+        luaL_error(L.lua_state(), "Out of bounds index.");
+        return std::make_tuple(0.0, 0);
+    }
+    auto action = (*actions)[idx];
+    return std::make_tuple(action.atS, action.pos);
+}
+
+lua_Integer OFS_LuaScriptData::LowerBound(lua_Number time) const noexcept
+{
+    return std::distance(actions->begin(), actions->lower_bound(FunscriptAction(time, 0))) + 1;
+}
+
+lua_Integer OFS_LuaScriptData::UpperBound(lua_Number time) const noexcept
+{
+    return std::distance(actions->begin(), actions->upper_bound(FunscriptAction(time, 0))) + 1;
+}
+
+void OFS_LuaScriptData::Register(sol::state_view L) noexcept
+{
+    auto data = L.new_usertype<OFS_LuaScriptData>("ScriptData", sol::no_constructor);
+    data[sol::meta_function::length] = &OFS_LuaScriptData::Length;
+    data["length"] = &OFS_LuaScriptData::Length;
+    data["get"] = &OFS_LuaScriptData::Get;
+    data["lowerBound"] = &OFS_LuaScriptData::LowerBound;
+    data["upperBound"] = &OFS_LuaScriptData::UpperBound;
+}
+
+static void CancelHook(lua_State* L, lua_Debug* ar) noexcept
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, JobRegistryKey);
+    auto job = static_cast<OFS_LuaJob::Shared*>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+    if(job && job->cancel) {
+        luaL_error(L, "The job was cancelled.");
+    }
+}
+
+void OFS_LuaJob::run(Shared& job) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    sol::state L;
+    L.open_libraries(
+        sol::lib::base,
+        sol::lib::package,
+        sol::lib::coroutine,
+        sol::lib::string,
+        sol::lib::os,
+        sol::lib::table,
+        sol::lib::math,
+        sol::lib::utf8,
+        sol::lib::io
+    );
+
+    // same lookup paths as the extension itself
+    auto directory = Util::PathFromString(job.directory);
+    std::string path = L["package"]["path"];
+    path += ";" + (directory / "?.lua").u8string();
+    path += ";" + (directory / "lib" / "?.lua").u8string();
+    L["package"]["path"] = path;
+    OFS_LuaBytecodeCache::InstallSearcher(L.lua_state());
+
+    lua_pushlightuserdata(L.lua_state(), &job);
+    lua_setfield(L.lua_state(), LUA_REGISTRYINDEX, JobRegistryKey);
+    lua_sethook(L.lua_state(), CancelHook, LUA_MASKCOUNT, CancelCheckInstructions);
+
+    OFS_LuaScriptData::Register(L);
+    // collected and written to the extension log once the job is done
+    L.set_function("print", [&job](sol::variadic_args va) noexcept {
+        for(auto arg : va) {
+            size_t length = 0;
+            auto str = luaL_tolstring(va.lua_state(), arg.stack_index(), &length);
+            job.log.append(str, length);
+            job.log += ' ';
+            lua_pop(va.lua_state(), 1);
+        }
+        job.log += '\n';
+    });
+    L.set_function("progress", [&job](lua_Number progress) noexcept {
+        job.progress = Util::Clamp<float>(progress, 0.f, 1.f);
+    });
+
+    try
+    {
+        auto file = (directory / Util::PathFromString(job.file)).u8string();
+        if(OFS_LuaBytecodeCache::LoadFile(L.lua_state(), file.c_str()) != LUA_OK) {
+            job.error = lua_tostring(L.lua_state(), -1);
+            return;
+        }
+        sol::protected_function chunk(L.lua_state(), -1);
+        lua_pop(L.lua_state(), 1);
+        auto res = chunk();
+        if(!res.valid()) {
+            sol::error err = res;
+            job.error = err.what();
+            return;
+        }
+
+        sol::protected_function func = L[job.function];
+        if(!func.valid()) {
+            job.error = "The function " + job.function + " doesn't exist in " + job.file + ".";
+            return;
+        }
+        res = func(job.args.ToLua(L));
+        if(!res.valid()) {
+            sol::error err = res;
+            job.error = err.what();
+            return;
+        }
+        if(res.return_count() > 0) {
+            OFS_LuaJobValue::FromLua(res.get<sol::object>(), job.result, job.error);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        job.error = e.what();
+    }
+}
+
+int OFS_LuaJob::workerThread(void* user) noexcept
+{
+    for(;;) {
+        SDL_LockMutex(JobQueueMut);
+        while(JobQueue.empty()) {
+            SDL_CondWait(JobQueueCond, JobQueueMut);
+        }
+        auto job = std::move(JobQueue.front());
+        JobQueue.pop_front();
+        SDL_UnlockMutex(JobQueueMut);
+
+        // jobs cancelled while queued are skipped
+        if(!job->cancel) run(*job);
+        job->finished = true;
+    }
+    return 0;
+}
+
+void OFS_LuaJob::startWorkers() noexcept
+{
+    if(JobQueueMut) return;
+    JobQueueMut = SDL_CreateMutex();
+    JobQueueCond = SDL_CreateCond();
+    for(int32_t i = 0, count = OFS_JobAPI::MaxConcurrentJobs(); i < count; i += 1) {
+        auto handle = SDL_CreateThread(workerThread, "OFS_LuaJob", nullptr);
+        if(!handle) break;
+        SDL_DetachThread(handle);
+        JobWorkers += 1;
+    }
+}
+
+OFS_LuaJob::~OFS_LuaJob() noexcept
+{
+    // nobody is interested in the result anymore
+    shared->cancel = true;
+}
+
+bool OFS_LuaJob::Start() noexcept
+{
+    if(JobWorkers == 0) return false;
+    SDL_LockMutex(JobQueueMut);
+    JobQueue.emplace_back(shared);
+    SDL_UnlockMutex(JobQueueMut);
+    SDL_CondSignal(JobQueueCond);
+    return true;
+}
+
+void OFS_LuaJob::Cancel() noexcept
+{
+    shared->cancel = true;
+    callback = sol::protected_function();
+}
+
+sol::protected_function OFS_LuaJob::TakeCallback() noexcept
+{
+    delivered = true;
+    return std::move(callback);
+}
+
+int32_t OFS_JobAPI::MaxConcurrentJobs() noexcept
+{
+    // one core is left for the main thread
+    return std::max(SDL_GetCPUCount() - 1, 1);
+}
+
+OFS_JobAPI::OFS_JobAPI(sol::usertype<OFS_ExtensionAPI>& ofs) noexcept
+{
+    OFS_LuaJob::startWorkers();
+
+    sol::state_view Lua(ofs.lua_state());
+    OFS_LuaScriptData::Register(Lua);
+
+    auto job = Lua.new_usertype<OFS_LuaJob>("Job", sol::no_constructor);
+    job["done"] = sol::readonly_property(&OFS_LuaJob::Done);
+    job["progress"] = sol::readonly_property(&OFS_LuaJob::Progress);
+    job["cancel"] = &OFS_LuaJob::Cancel;
+
+    ofs["Job"] = [this](const char* file, const char* function, sol::object args, sol::protected_function callback, sol::this_state L) noexcept {
+        return createJob(file, function, std::move(args), std::move(callback), L);
+    };
+}
+
+OFS_JobAPI::~OFS_JobAPI() noexcept
+{
+    // the callbacks have to be released while the lua state still exists
+    for(auto& job : jobs) {
+        job->Cancel();
+    }
+}
+
+std::shared_ptr<OFS_LuaJob> OFS_JobAPI::createJob(const char* file, const char* function, sol::object args, sol::protected_function callback, sol::this_state L) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    OFS_LuaExtension* ext = sol::state_view(L)[OFS_LuaExtensions::GlobalExtensionPtr];
+    auto shared = std::make_shared<OFS_LuaJob::Shared>();
+    shared->file = file;
+    shared->function = function;
+    shared->directory = ext->Directory;
+
+    std::string error;
+    if(!OFS_LuaJobValue::FromLua(args, shared->args, error)) {
+        luaL_error(L.lua_state(), "%s", error.c_str());
+        return nullptr;
+    }
+
+    auto job = std::make_shared<OFS_LuaJob>(std::move(shared), std::move(callback));
+    if(!job->Start()) {
+        luaL_error(L.lua_state(), "Failed to start the job.");
+        return nullptr;
+    }
+    jobs.emplace_back(job);
+    return job;
+}
+
+void OFS_JobAPI::TakeFinished(std::vector<std::shared_ptr<OFS_LuaJob>>& finished) noexcept
+{
+    for(auto it = jobs.begin(); it != jobs.end();) {
+        auto& job = *it;
+        if(job->Finished()) {
+            // cancelled jobs don't call back
+            if(!job->Data().cancel) finished.emplace_back(job);
+            it = jobs.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "OFS_Lua.h"
+#include "FunscriptAction.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Copy of a lua value which can be moved between lua states.
+// Only plain data and script actions can be copied.
+struct OFS_LuaJobValue
+{
+    enum class Type : uint8_t
+    {
+        Nil,
+        Boolean,
+        Integer,
+        Number,
+        String,
+        Table,
+        Actions
+    };
+
+    Type type = Type::Nil;
+    bool boolean = false;
+    lua_Integer integer = 0;
+    lua_Number number = 0.0;
+    std::string string;
+    std::vector<std::pair<OFS_LuaJobValue, OFS_LuaJobValue>> table;
+    std::shared_ptr<const FunscriptArray> actions;
+
+    static constexpr int32_t MaxDepth = 32;
+
+    // returns false and sets error if the value can't be copied
+    static bool FromLua(const sol::object& obj, OFS_LuaJobValue& out, std::string& error, int32_t depth = 0) noexcept;
+    sol::object ToLua(sol::state_view L) const noexcept;
+};
+
+// Immutable copy of the actions of a script. Can be shared between lua states.
+class OFS_LuaScriptData
+{
+    private:
+        std::shared_ptr<const FunscriptArray> actions;
+    public:
+        OFS_LuaScriptData(std::shared_ptr<const FunscriptArray> actions) noexcept
+            : actions(std::move(actions)) {}
+
+        inline const std::shared_ptr<const FunscriptArray>& Actions() const noexcept { return actions; }
+
+        lua_Integer Length() const noexcept;
+        std::tuple<lua_Number, lua_Integer> Get(lua_Integer idx, sol::this_state L) const noexcept;
+        // index of the first action at or after time, length + 1 if there is none
+        lua_Integer LowerBound(lua_Number time) const noexcept;
+        // index of the first action after time, length + 1 if there is none
+        lua_Integer UpperBound(lua_Number time) const noexcept;
+
+        static void Register(sol::state_view L) noexcept;
+};
+
+// A function of a lua file running in its own lua state on a worker thread.
+class OFS_LuaJob
+{
+    public:
+        // shared with the worker thread
+        struct Shared
+        {
+            std::string file;
+            std::string function;
+            std::string directory;
+            OFS_LuaJobValue args;
+
+            // written by the worker, read after finished is set
+            OFS_LuaJobValue result;
+            std::string error;
+            std::string log;
+
+            std::atomic<bool> cancel = false;
+            std::atomic<bool> finished = false;
+            std::atomic<float> progress = 0.f;
+        };
+
+    private:
+        std::shared_ptr<Shared> shared;
+        sol::protected_function callback;
+        bool delivered = false;
+
+        static int workerThread(void* user) noexcept;
+        static void run(Shared& job) noexcept;
+
+        friend class OFS_JobAPI;
+        // main thread only, the workers are shared by every extension
+        static void startWorkers() noexcept;
+
+    public:
+        OFS_LuaJob(std::shared_ptr<Shared> shared, sol::protected_function&& callback) noexcept
+            : shared(std::move(shared)), callback(std::move(callback)) {}
+        ~OFS_LuaJob() noexcept;
+
+        bool Start() noexcept;
+
+        inline bool Done() const noexcept { return delivered; }
+        inline float Progress() const noexcept { return shared->progress; }
+        void Cancel() noexcept;
+
+        // main thread only
+        inline bool Finished() const noexcept { return !delivered && shared->finished; }
+        inline const Shared& Data() const noexcept { return *shared; }
+        sol::protected_function TakeCallback() noexcept;
+};
+
+class OFS_JobAPI
+{
+    private:
+        std::vector<std::shared_ptr<OFS_LuaJob>> jobs;
+
+        std::shared_ptr<OFS_LuaJob> createJob(const char* file, const char* function, sol::object args, sol::protected_function callback, sol::this_state L) noexcept;
+    public:
+        // size of the worker pool, the other jobs wait in its queue
+        static int32_t MaxConcurrentJobs() noexcept;
+
+        OFS_JobAPI(sol::usertype<class OFS_ExtensionAPI>& ofs) noexcept;
+        ~OFS_JobAPI() noexcept;
+
+        // Main thread only. Moves the jobs which finished since the last call into finished.
+        void TakeFinished(std::vector<std::shared_ptr<OFS_LuaJob>>& finished) noexcept;
+};
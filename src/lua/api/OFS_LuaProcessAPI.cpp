@@ -1,9 +1,19 @@
 #include "OFS_LuaProcessAPI.h"
 #include "OFS_LuaExtensionAPI.h"
 
+#include "OFS_EventSystem.h"
+#include "OFS_Profiling.h"
+
+#include "SDL_thread.h"
+#include "SDL_timer.h"
+
 OFS_ProcessAPI::~OFS_ProcessAPI() noexcept
 {
-
+    exitUnsub();
+    // processes of unloaded extensions don't keep running
+    for(auto& entry : asyncProcesses) {
+        OFS_LuaAsyncProcess(entry.shared).Kill();
+    }
 }
 
 OFS_ProcessAPI::OFS_ProcessAPI(sol::usertype<OFS_ExtensionAPI>& ofs) noexcept
@@ -15,6 +25,20 @@ OFS_ProcessAPI::OFS_ProcessAPI(sol::usertype<OFS_ExtensionAPI>& ofs) noexcept
     process["join"] = &OFS_LuaProcess::Join;
     process["detach"] = &OFS_LuaProcess::Detach;
     process["kill"] = &OFS_LuaProcess::Shutdown;
+
+    auto async = Lua.new_usertype<OFS_LuaAsyncProcess>("AsyncProcess", sol::no_constructor);
+    async["new"] = [this](const char* program, sol::optional<sol::table> args, sol::optional<sol::table> handlers, sol::this_state L) noexcept {
+        return createAsync(program, std::move(args), std::move(handlers), L);
+    };
+    async["alive"] = &OFS_LuaAsyncProcess::IsAlive;
+    async["exitCode"] = &OFS_LuaAsyncProcess::ExitCode;
+    async["readLines"] = &OFS_LuaAsyncProcess::ReadLines;
+    async["readErrorLines"] = &OFS_LuaAsyncProcess::ReadErrorLines;
+    async["kill"] = &OFS_LuaAsyncProcess::Kill;
+
+    exitUnsub = EV::MakeUnsubscibeFn(OFS_LuaProcessExitEvent::EventType,
+        EV::Queue().appendListener(OFS_LuaProcessExitEvent::EventType,
+            OFS_LuaProcessExitEvent::HandleEvent(EVENT_SYSTEM_BIND(this, &OFS_ProcessAPI::processExited))));
 }
 
 std::unique_ptr<OFS_LuaProcess> OFS_LuaProcess::CreateProcess(const char* prog, sol::variadic_args va) noexcept
@@ -38,4 +62,232 @@ std::unique_ptr<OFS_LuaProcess> OFS_LuaProcess::CreateProcess(const char* prog,
         return std::move(process);
     }
     return nullptr;
-}
\ No newline at end of file
+}
+
+struct ProcessReaderArgs
+{
+    std::shared_ptr<OFS_LuaAsyncProcess::Shared> shared;
+    bool stderrStream;
+};
+
+OFS_LuaAsyncProcess::Shared::~Shared() noexcept
+{
+    if(started) subprocess_destroy(&proc);
+}
+
+static void PushLine(OFS_LuaAsyncProcess::Shared& process, std::vector<std::string>& lines, std::string&& line) noexcept
+{
+    if(!line.empty() && line.back() == '\r') line.pop_back();
+    SDL_AtomicLock(&process.lock);
+    if(lines.size() < OFS_LuaAsyncProcess::MaxQueuedLines) lines.emplace_back(std::move(line));
+    SDL_AtomicUnlock(&process.lock);
+}
+
+static void StreamClosed(OFS_LuaAsyncProcess::Shared& process) noexcept
+{
+    // the last stream to close waits for the exit code
+    if(process.openStreams.fetch_sub(1) != 1) return;
+    // polled under the lock, once the pid is reaped Kill could hit a recycled one
+    for(;;) {
+        SDL_AtomicLock(&process.lock);
+        bool alive = subprocess_alive(&process.proc) > 0;
+        if(!alive) process.reaped = true;
+        SDL_AtomicUnlock(&process.lock);
+        if(!alive) break;
+        SDL_Delay(10);
+    }
+    int code = -1;
+    subprocess_join(&process.proc, &code);
+    EV::Enqueue<OFS_LuaProcessExitEvent>(process.id, code);
+}
+
+int OFS_LuaAsyncProcess::readerThread(void* user) noexcept
+{
+    auto args = static_cast<ProcessReaderArgs*>(user);
+    auto shared = std::move(args->shared);
+    bool stderrStream = args->stderrStream;
+    delete args;
+
+    auto& lines = stderrStream ? shared->stderrLines : shared->stdoutLines;
+    char buffer[4096];
+    std::string partial;
+    for(;;) {
+        unsigned read = stderrStream
+            ? subprocess_read_stderr(&shared->proc, buffer, sizeof(buffer))
+            : subprocess_read_stdout(&shared->proc, buffer, sizeof(buffer));
+        if(read == 0) break;
+
+        partial.append(buffer, read);
+        size_t start = 0;
+        size_t end;
+        while((end = partial.find('\n', start)) != std::string::npos) {
+            PushLine(*shared, lines, partial.substr(start, end - start));
+            start = end + 1;
+        }
+        partial.erase(0, start);
+    }
+    if(!partial.empty()) PushLine(*shared, lines, std::move(partial));
+
+    StreamClosed(*shared);
+    return 0;
+}
+
+bool OFS_LuaAsyncProcess::Start() noexcept
+{
+    int32_t started = 0;
+    for(bool stderrStream : { false, true }) {
+        auto args = new ProcessReaderArgs{ shared, stderrStream };
+        auto handle = SDL_CreateThread(readerThread, "OFS_ProcessReader", args);
+        if(!handle) {
+            delete args;
+            break;
+        }
+        SDL_DetachThread(handle);
+        started += 1;
+    }
+    if(started == 2) return true;
+
+    // without a reader the output can't be drained
+    Kill();
+    for(; started < 2; started += 1) {
+        StreamClosed(*shared);
+    }
+    return false;
+}
+
+sol::optional<lua_Integer> OFS_LuaAsyncProcess::ExitCode() const noexcept
+{
+    if(!shared->exited) return sol::optional<lua_Integer>();
+    return sol::make_optional(shared->exitCode);
+}
+
+std::vector<std::string> OFS_LuaAsyncProcess::ReadLines() noexcept
+{
+    std::vector<std::string> lines;
+    lines.swap(shared->polledStdout);
+    return lines;
+}
+
+std::vector<std::string> OFS_LuaAsyncProcess::ReadErrorLines() noexcept
+{
+    std::vector<std::string> lines;
+    lines.swap(shared->polledStderr);
+    return lines;
+}
+
+void OFS_LuaAsyncProcess::Kill() noexcept
+{
+    // the readers get EOF once it's gone
+    if(shared->exited) return;
+    SDL_AtomicLock(&shared->lock);
+    if(!shared->reaped && !shared->killed.exchange(true)) {
+        subprocess_terminate(&shared->proc);
+    }
+    SDL_AtomicUnlock(&shared->lock);
+}
+
+std::shared_ptr<OFS_LuaAsyncProcess> OFS_ProcessAPI::createAsync(const char* program, sol::optional<sol::table> args, sol::optional<sol::table> handlers, sol::this_state L) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    std::vector<std::string> arguments;
+    arguments.emplace_back(program);
+    if(args) {
+        for(size_t i = 1, size = args->size(); i <= size; i += 1) {
+            sol::object arg = (*args)[i];
+            arg.push(L.lua_state());
+            const char* str = lua_tostring(L.lua_state(), -1);
+            if(str) arguments.emplace_back(str);
+            lua_pop(L.lua_state(), 1);
+            if(!str) {
+                luaL_error(L.lua_state(), "Provided argument can't be turned into a string.");
+                return nullptr;
+            }
+        }
+    }
+    std::vector<const char*> argv;
+    for(auto& arg : arguments) argv.emplace_back(arg.c_str());
+    argv.emplace_back(nullptr);
+
+    static uint64_t processCounter = 0;
+    auto shared = std::make_shared<OFS_LuaAsyncProcess::Shared>();
+    shared->id = ++processCounter;
+    int options = subprocess_option_enable_async | subprocess_option_inherit_environment | subprocess_option_no_window;
+    if(subprocess_create(argv.data(), options, &shared->proc) != 0) {
+        return nullptr;
+    }
+    shared->started = true;
+
+    auto& entry = asyncProcesses.emplace_back();
+    entry.shared = shared;
+    if(handlers) {
+        entry.onStdout = (*handlers)["stdout"];
+        entry.onStderr = (*handlers)["stderr"];
+        entry.onExit = (*handlers)["exit"];
+    }
+
+    auto process = std::make_shared<OFS_LuaAsyncProcess>(std::move(shared));
+    process->Start();
+    return process;
+}
+
+void OFS_ProcessAPI::processExited(const OFS_LuaProcessExitEvent* ev) noexcept
+{
+    for(auto& entry : asyncProcesses) {
+        if(entry.shared->id == ev->ProcessId) {
+            entry.shared->exited = true;
+            entry.shared->exitCode = ev->ExitCode;
+            break;
+        }
+    }
+}
+
+static void QueueLines(std::vector<std::string>& lines, const sol::protected_function& handler,
+    std::vector<std::string>& polled, std::vector<OFS_LuaProcessCallback>& callbacks) noexcept
+{
+    if(handler.valid()) {
+        for(auto& line : lines) {
+            auto& callback = callbacks.emplace_back();
+            callback.function = handler;
+            callback.line = std::move(line);
+        }
+        return;
+    }
+    polled.insert(polled.end(), std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end()));
+    if(polled.size() > OFS_LuaAsyncProcess::MaxQueuedLines) {
+        polled.erase(polled.begin(), polled.begin() + (polled.size() - OFS_LuaAsyncProcess::MaxQueuedLines));
+    }
+}
+
+void OFS_ProcessAPI::TakeCallbacks(std::vector<OFS_LuaProcessCallback>& callbacks) noexcept
+{
+    std::vector<std::string> stdoutLines;
+    std::vector<std::string> stderrLines;
+    for(auto it = asyncProcesses.begin(); it != asyncProcesses.end();) {
+        auto& entry = *it;
+        auto& process = *entry.shared;
+        // all output was queued before the exit event, read the flag first
+        bool exited = process.exited;
+        SDL_AtomicLock(&process.lock);
+        stdoutLines.swap(process.stdoutLines);
+        stderrLines.swap(process.stderrLines);
+        SDL_AtomicUnlock(&process.lock);
+
+        QueueLines(stdoutLines, entry.onStdout, process.polledStdout, callbacks);
+        QueueLines(stderrLines, entry.onStderr, process.polledStderr, callbacks);
+        stdoutLines.clear();
+        stderrLines.clear();
+
+        if(exited) {
+            if(entry.onExit.valid()) {
+                auto& callback = callbacks.emplace_back();
+                callback.function = entry.onExit;
+                callback.exitCode = process.exitCode;
+                callback.exit = true;
+            }
+            it = asyncProcesses.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
@@ -1,7 +1,14 @@
 #pragma once
 #include "OFS_Lua.h"
+#include "OFS_Event.h"
 #include "subprocess.h"
+
+#include "SDL_atomic.h"
+
+#include <atomic>
 #include <memory>
+#include <string>
+#include <vector>
 
 class OFS_LuaProcess
 {
@@ -71,9 +78,98 @@ class OFS_LuaProcess
 	}
 };
 
+// Enqueued once an AsyncProcess exited and all of its output was read.
+class OFS_LuaProcessExitEvent : public OFS_Event<OFS_LuaProcessExitEvent>
+{
+    public:
+    uint64_t ProcessId;
+    int32_t ExitCode;
+    OFS_LuaProcessExitEvent(uint64_t processId, int32_t exitCode) noexcept
+        : ProcessId(processId), ExitCode(exitCode) {}
+};
+
+// A process whose output gets read line by line on reader threads.
+// Nothing blocks the main thread, the lines and the exit get delivered by OFS_ProcessAPI.
+class OFS_LuaAsyncProcess
+{
+    public:
+    // shared with the reader threads
+    struct Shared
+    {
+        uint64_t id = 0;
+        struct subprocess_s proc = {0};
+        bool started = false;
+
+        SDL_SpinLock lock = {0};
+        std::vector<std::string> stdoutLines;
+        std::vector<std::string> stderrLines;
+        // the last reader joins the process
+        std::atomic<int32_t> openStreams = 2;
+        std::atomic<bool> killed = false;
+        // guarded by lock, set once the process was waited on
+        bool reaped = false;
+
+        // main thread only
+        bool exited = false;
+        lua_Integer exitCode = -1;
+        std::vector<std::string> polledStdout;
+        std::vector<std::string> polledStderr;
+
+        ~Shared() noexcept;
+    };
+
+    // lines beyond this get dropped if nobody reads them
+    static constexpr size_t MaxQueuedLines = 10000;
+
+    private:
+    std::shared_ptr<Shared> shared;
+
+    static int readerThread(void* user) noexcept;
+
+    public:
+    OFS_LuaAsyncProcess(std::shared_ptr<Shared> shared) noexcept
+        : shared(std::move(shared)) {}
+
+    inline const std::shared_ptr<Shared>& Data() const noexcept { return shared; }
+
+    bool Start() noexcept;
+    inline bool IsAlive() const noexcept { return !shared->exited; }
+    sol::optional<lua_Integer> ExitCode() const noexcept;
+    // lines read since the last call, only filled if there is no handler
+    std::vector<std::string> ReadLines() noexcept;
+    std::vector<std::string> ReadErrorLines() noexcept;
+    void Kill() noexcept;
+};
+
+// a pending call of an AsyncProcess handler
+struct OFS_LuaProcessCallback
+{
+    sol::protected_function function;
+    std::string line;
+    lua_Integer exitCode = 0;
+    bool exit = false;
+};
+
 class OFS_ProcessAPI
 {
+    private:
+    struct AsyncEntry
+    {
+        std::shared_ptr<OFS_LuaAsyncProcess::Shared> shared;
+        sol::protected_function onStdout;
+        sol::protected_function onStderr;
+        sol::protected_function onExit;
+    };
+    std::vector<AsyncEntry> asyncProcesses;
+    UnsubscribeFn exitUnsub;
+
+    void processExited(const OFS_LuaProcessExitEvent* ev) noexcept;
+    std::shared_ptr<OFS_LuaAsyncProcess> createAsync(const char* program, sol::optional<sol::table> args, sol::optional<sol::table> handlers, sol::this_state L) noexcept;
+
     public:
     OFS_ProcessAPI(sol::usertype<class OFS_ExtensionAPI>& ofs) noexcept;
     ~OFS_ProcessAPI() noexcept;
+
+    // Main thread only. Collects the handler calls for the output and exits since the last call.
+    void TakeCallbacks(std::vector<OFS_LuaProcessCallback>& callbacks) noexcept;
 };
\ No newline at end of file
@@ -12,12 +12,25 @@ OFS_ScriptAPI::OFS_ScriptAPI(sol::usertype<class OFS_ExtensionAPI>& ofs) noexcep
     script["closestAction"] = &LuaFunscript::ClosestAction;
     script["closestActionAfter"] = &LuaFunscript::ClosestActionAfter;
     script["closestActionBefore"] = &LuaFunscript::ClosestActionBefore;
+    script["actionsInRange"] = &LuaFunscript::ActionsInRange;
+    script["indexAtTime"] = &LuaFunscript::IndexAtTime;
     script["selectedIndices"] = &LuaFunscript::SelectedIndices;
     script["markForRemoval"] = &LuaFunscript::MarkForRemoval;
     script["removeMarked"] = &LuaFunscript::RemoveMarked;
     
     script["path"] = sol::readonly_property(&LuaFunscript::Path);
     script["name"] = sol::readonly_property(&LuaFunscript::Name);
+    script["view"] = sol::readonly_property(&LuaFunscript::View);
+
+    auto view = L.new_usertype<LuaFunscriptView>("FunscriptView", sol::no_constructor);
+    view["valid"] = sol::readonly_property(&LuaFunscriptView::Valid);
+    view[sol::meta_function::length] = &LuaFunscriptView::Length;
+    view["length"] = &LuaFunscriptView::Length;
+    view["get"] = &LuaFunscriptView::Get;
+    view["selected"] = &LuaFunscriptView::IsSelected;
+    view["lowerBound"] = &LuaFunscriptView::LowerBound;
+    view["upperBound"] = &LuaFunscriptView::UpperBound;
+    view["range"] = &LuaFunscriptView::Range;
 
     auto action = L.new_usertype<LuaFunscriptAction>("Action",
         sol::constructors<LuaFunscriptAction(lua_Number, lua_Integer), LuaFunscriptAction(lua_Number, lua_Integer, bool)>());
@@ -68,38 +81,106 @@ LuaFunscript::LuaFunscript(int32_t scriptIdx, std::weak_ptr<Funscript> script) n
     : script(script), scriptIdx(scriptIdx)
 {
     FUN_ASSERT(Util::InMainThread(), "Not in main thread.");
-    this->TakeSnapshot();
 }
 
 LuaFunscript::LuaFunscript(const FunscriptArray& actions) noexcept
 {
+    hasSnapshot = true;
     for(auto a : actions) {
         this->actions.emplace_back(a, false);
     }
 }
 
+size_t LuaFunscript::count() const noexcept
+{
+    if(hasSnapshot) return actions.size();
+    auto ref = script.lock();
+    return ref ? ref->Actions().size() : 0;
+}
+
+float LuaFunscript::atTime(size_t idx) const noexcept
+{
+    if(hasSnapshot) return actions[idx].o.atS;
+    return script.lock()->Actions()[idx].atS;
+}
+
+LuaFunscriptAction LuaFunscript::actionAt(size_t idx) const noexcept
+{
+    if(hasSnapshot) return actions[idx];
+    auto ref = script.lock();
+    auto action = ref->Actions()[idx];
+    return LuaFunscriptAction(action, ref->IsSelected(action));
+}
+
+std::unique_ptr<LuaFunscriptView> LuaFunscript::View() const noexcept
+{
+    auto ref = script.lock();
+    if(!ref) return nullptr;
+    return std::make_unique<LuaFunscriptView>(ref);
+}
+
+std::shared_ptr<const FunscriptArray> LuaFunscript::CopyActions() const noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    if(!hasSnapshot) {
+        auto ref = script.lock();
+        return ref ? std::make_shared<const FunscriptArray>(ref->Actions()) : nullptr;
+    }
+    // the lua copy doesn't have to be sorted
+    auto copy = std::make_shared<FunscriptArray>();
+    copy->reserve(actions.size());
+    if(isSorted()) {
+        for(auto& action : actions) {
+            if(copy->empty() || copy->back().atS != action.o.atS) copy->emplace_back_unsorted(action.o);
+        }
+    }
+    else {
+        for(auto& action : actions) copy->emplace(action.o);
+    }
+    return copy;
+}
+
 void LuaFunscript::Commit(sol::this_state L) noexcept
 {
     FUN_ASSERT(Util::InMainThread(), "Not in main thread.");
+    // nothing could have been modified
+    if(!hasSnapshot) return;
     auto app = OpenFunscripter::ptr;
     auto ref = script.lock();
     if(ref) {
         FunscriptArray commit;
         FunscriptArray selection;
         commit.reserve(actions.size());
+        bool wasSorted = isSorted();
         for(auto action : actions) {
-            auto succ = commit.emplace(action.o);
+            bool succ;
+            if(wasSorted) {
+                // appending is enough, only duplicates have to be caught
+                succ = commit.empty() || commit.back().atS != action.o.atS;
+                if(succ) commit.emplace_back_unsorted(action.o);
+            }
+            else {
+                succ = commit.emplace(action.o);
+            }
             if(!succ) {
                 luaL_error(L.lua_state(), "Tried adding multiple actions with the same timestamp.");
                 return;
             }
             if(action.selected) {
-                selection.emplace(action.o);
+                if(wasSorted) selection.emplace_back_unsorted(action.o);
+                else selection.emplace(action.o);
             }
         }
-        app->undoSystem->Snapshot(StateType::CUSTOM_LUA, script);
-        ref->SetActions(commit);
-        ref->SetSelection(selection);
+        float changedStart, changedEnd;
+        if(ref->DiffRange(commit, selection, &changedStart, &changedEnd)) {
+            // the undo entry only holds the changed range
+            app->undoSystem->SnapshotRange(StateType::CUSTOM_LUA, script, changedStart, changedEnd);
+            // only replaces the part which differs and notifies just that range
+            ref->SetActions(commit);
+            if(selection != ref->Selection()) ref->SetSelection(selection);
+        }
+        // keep the lua side in the same order as the script
+        if(!wasSorted) Sort();
     }
 }
 
@@ -131,77 +212,211 @@ const char* LuaFunscript::Name() const noexcept
 
 bool LuaFunscript::HasSelection() const noexcept
 {
+    if(!hasSnapshot) {
+        auto ref = script.lock();
+        return ref && ref->HasSelection();
+    }
     return std::any_of(actions.begin(), actions.end(), [](auto a) { return a.selected; });
 }
 
+bool LuaFunscript::isSorted() const noexcept
+{
+    // the live script is always sorted and so is a snapshot lua never got
+    if(!hasSnapshot || !exposed) return true;
+    // a table kept on the lua side can change between any two calls,
+    // only scan again after something was written
+    if(sortedValid && sortedWrites == LuaFunscriptAction::Writes && sortedSize == actions.size()) return sorted;
+    OFS_PROFILE(__FUNCTION__);
+    sorted = std::is_sorted(actions.begin(), actions.end(),
+        [](auto& a1, auto& a2) {
+            return a1.o.atS < a2.o.atS;
+        });
+    sortedValid = true;
+    sortedWrites = LuaFunscriptAction::Writes;
+    sortedSize = actions.size();
+    return sorted;
+}
+
+size_t LuaFunscript::lowerBound(lua_Number time) const noexcept
+{
+    size_t first = 0;
+    size_t length = count();
+    while(length > 0) {
+        size_t half = length / 2;
+        if(atTime(first + half) < time) {
+            first += half + 1;
+            length -= half + 1;
+        }
+        else {
+            length = half;
+        }
+    }
+    return first;
+}
+
+size_t LuaFunscript::upperBound(lua_Number time) const noexcept
+{
+    size_t first = 0;
+    size_t length = count();
+    while(length > 0) {
+        size_t half = length / 2;
+        if(atTime(first + half) <= time) {
+            first += half + 1;
+            length -= half + 1;
+        }
+        else {
+            length = half;
+        }
+    }
+    return first;
+}
+
 sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>> LuaFunscript::ClosestAction(lua_Number time) noexcept
 {
+    OFS_PROFILE(__FUNCTION__);
+    if(isSorted()) {
+        size_t size = count();
+        if(size == 0) return sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>>();
+        size_t idx = lowerBound(time);
+        if(idx > 0) {
+            // the first action of equal timestamps wins, same as the scan below
+            size_t prevIdx = lowerBound(atTime(idx - 1));
+            if(idx == size || std::abs(atTime(prevIdx) - time) <= std::abs(atTime(idx) - time)) {
+                idx = prevIdx;
+            }
+        }
+        return sol::make_optional(std::make_tuple(actionAt(idx), (lua_Integer)idx + 1));
+    }
+
     float closestDelta = std::numeric_limits<float>::max();
     int closestIdx = -1;
-    LuaFunscriptAction closestAction(FunscriptAction(0, 0), false);
 
-    for(uint32_t i=0, size=actions.size(); i < size; i += 1) {
-        auto a = actions[i];
-        float delta = std::abs(a.at() - time);
+    for(uint32_t i=0, size=count(); i < size; i += 1) {
+        float at = atTime(i);
+        float delta = std::abs(at - time);
         if(delta < closestDelta) {
             closestDelta = delta;
             closestIdx = i;
-            closestAction = a;
         }
     }
     if(closestDelta != std::numeric_limits<float>::max()) {
-        return sol::make_optional(std::make_tuple(closestAction, closestIdx + 1));
+        return sol::make_optional(std::make_tuple(actionAt(closestIdx), closestIdx + 1));
     }
     return sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>>();
 }
 
 sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>> LuaFunscript::ClosestActionAfter(lua_Number time) noexcept
 {
+    OFS_PROFILE(__FUNCTION__);
+    if(isSorted()) {
+        size_t idx = upperBound(time);
+        if(idx < count()) {
+            return sol::make_optional(std::make_tuple(actionAt(idx), (lua_Integer)idx + 1));
+        }
+        return sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>>();
+    }
+
     float closestDelta = std::numeric_limits<float>::max();
     int closestIdx = -1;
-    LuaFunscriptAction closestAction(FunscriptAction(0, 0), false);
 
-    for(uint32_t i=0, size=actions.size(); i < size; i += 1) {
-        auto a = actions[i];
-        if(a.at() < time) continue;
-        float delta = std::abs(a.at() - time);
+    for(uint32_t i=0, size=count(); i < size; i += 1) {
+        float at = atTime(i);
+        if(at < time) continue;
+        float delta = std::abs(at - time);
         if(delta < closestDelta && delta != 0.f) {
             closestDelta = delta;
             closestIdx = i;
-            closestAction = a;
         }
     }
     if(closestDelta != std::numeric_limits<float>::max()) {
-        return sol::make_optional(std::make_tuple(closestAction, closestIdx + 1));
+        return sol::make_optional(std::make_tuple(actionAt(closestIdx), closestIdx + 1));
     }
     return sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>>();
 }
 
 sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>> LuaFunscript::ClosestActionBefore(lua_Number time) noexcept
 {
+    OFS_PROFILE(__FUNCTION__);
+    if(isSorted()) {
+        size_t idx = lowerBound(time);
+        if(idx > 0) {
+            idx = lowerBound(atTime(idx - 1));
+            return sol::make_optional(std::make_tuple(actionAt(idx), (lua_Integer)idx + 1));
+        }
+        return sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>>();
+    }
+
     float closestDelta = std::numeric_limits<float>::max();
     int closestIdx = -1;
-    LuaFunscriptAction closestAction(FunscriptAction(0, 0), false);
 
-    for(uint32_t i=0, size=actions.size(); i < size; i += 1) {
-        auto a = actions[i];
-        if(a.at() > time) continue;
-        float delta = std::abs(a.at() - time);
+    for(uint32_t i=0, size=count(); i < size; i += 1) {
+        float at = atTime(i);
+        if(at > time) continue;
+        float delta = std::abs(at - time);
         if(delta < closestDelta && delta != 0.f) {
             closestDelta = delta;
             closestIdx = i;
-            closestAction = a;
         }
     }
     if(closestDelta != std::numeric_limits<float>::max()) {
-        return sol::make_optional(std::make_tuple(closestAction, closestIdx + 1));
+        return sol::make_optional(std::make_tuple(actionAt(closestIdx), closestIdx + 1));
     }
     return sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>>();
 }
 
+std::tuple<lua_Integer, lua_Integer> LuaFunscript::ActionsInRange(lua_Number fromTime, lua_Number toTime, sol::this_state L) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    if(!isSorted()) {
+        luaL_error(L.lua_state(), "The actions aren't sorted. Call sort() first.");
+        return std::make_tuple(1, 0);
+    }
+    lua_Integer first = lowerBound(fromTime);
+    lua_Integer last = upperBound(toTime);
+    return std::make_tuple(first + 1, std::max(first, last));
+}
+
+sol::optional<lua_Integer> LuaFunscript::IndexAtTime(lua_Number time, sol::optional<lua_Number> maxErrorTime, sol::this_state L) noexcept
+{
+    OFS_PROFILE(__FUNCTION__);
+    if(!isSorted()) {
+        luaL_error(L.lua_state(), "The actions aren't sorted. Call sort() first.");
+        return sol::optional<lua_Integer>();
+    }
+    lua_Number maxError = std::abs(maxErrorTime.value_or(0.0));
+    size_t idx = lowerBound(time - maxError);
+    size_t end = upperBound(time + maxError);
+    if(idx >= end) return sol::optional<lua_Integer>();
+
+    // closest one inside the margin, the first one wins ties
+    size_t closestIdx = idx;
+    lua_Number closestError = std::abs(atTime(idx) - time);
+    for(idx += 1; idx < end; idx += 1) {
+        lua_Number error = std::abs(atTime(idx) - time);
+        if(error >= closestError) break;
+        closestError = error;
+        closestIdx = idx;
+    }
+    return sol::make_optional<lua_Integer>(closestIdx + 1);
+}
+
 std::vector<lua_Integer> LuaFunscript::SelectedIndices() const noexcept
 {
     std::vector<lua_Integer> selectedIndices;
+    if(!hasSnapshot) {
+        auto ref = script.lock();
+        if(!ref) return selectedIndices;
+        // both arrays are sorted
+        auto& live = ref->Actions();
+        auto it = live.begin();
+        for(auto selected : ref->Selection()) {
+            it = std::lower_bound(it, live.end(), selected, ActionLess());
+            if(it != live.end() && *it == selected) {
+                selectedIndices.emplace_back(std::distance(live.begin(), it) + 1);
+            }
+        }
+        return selectedIndices;
+    }
     for(uint32_t i=0, size=actions.size(); i < size; i += 1) {
         if(actions[i].selected) {
             selectedIndices.emplace_back(i+1);
@@ -212,6 +427,7 @@ std::vector<lua_Integer> LuaFunscript::SelectedIndices() const noexcept
 
 void LuaFunscript::MarkForRemoval(lua_Integer idx, sol::this_state L) noexcept
 {
+    TakeSnapshot();
     idx -= 1;
     if(idx >= 0 && idx < actions.size()) {
         markedIndices.insert(idx);
@@ -223,14 +439,109 @@ void LuaFunscript::MarkForRemoval(lua_Integer idx, sol::this_state L) noexcept
 
 lua_Integer LuaFunscript::RemoveMarked() noexcept
 {
-    LuaFunscriptArray filteredActions;
-    for(uint32_t i=0, size=actions.size(); i < size; i += 1) {
-        if(markedIndices.find(i) == markedIndices.end()) {
-            filteredActions.emplace_back(actions[i]);
-        }
+    TakeSnapshot();
+    // move the ranges between marked indices down in one pass
+    auto out = actions.begin();
+    auto next = actions.begin();
+    for(auto idx : markedIndices) {
+        // the table could have shrunk since marking
+        if(idx >= actions.size()) break;
+        auto marked = actions.begin() + idx;
+        out = std::move(next, marked, out);
+        next = marked + 1;
     }
-    auto removedCount = actions.size() - filteredActions.size();
-    actions = std::move(filteredActions);
+    out = std::move(next, actions.end(), out);
+    auto removedCount = std::distance(out, actions.end());
+    actions.erase(out, actions.end());
     markedIndices.clear();
     return removedCount;
+}
+
+LuaFunscriptView::LuaFunscriptView(const std::shared_ptr<Funscript>& script) noexcept
+    : script(script), ref(script.get()), version(script->ActionsVersion())
+{
+    FUN_ASSERT(Util::InMainThread(), "Not in main thread.");
+}
+
+bool LuaFunscriptView::Valid() const noexcept
+{
+    return !script.expired() && ref->ActionsVersion() == version;
+}
+
+const FunscriptArray& LuaFunscriptView::validActions(sol::this_state L) const noexcept
+{
+    if(!Valid()) {
+        luaL_error(L.lua_state(), "The script changed after the view was created.");
+        static const FunscriptArray empty;
+        return empty;
+    }
+    return ref->Actions();
+}
+
+lua_Integer LuaFunscriptView::Length(sol::this_state L) const noexcept
+{
+    return validActions(L).size();
+}
+
+std::tuple<lua_Number, lua_Integer> LuaFunscriptView::Get(lua_Integer idx, sol::this_state L) const noexcept
+{
+    auto& actions = validActions(L);
+    idx -= 1;
+    if(idx < 0 || idx >= actions.size()) {
+        luaL_error(L.lua_state(), "Out of bounds index.");
+        return std::make_tuple(0.0, 0);
+    }
+    auto action = actions[idx];
+    return std::make_tuple(action.atS, action.pos);
+}
+
+bool LuaFunscriptView::IsSelected(lua_Integer idx, sol::this_state L) const noexcept
+{
+    auto& actions = validActions(L);
+    idx -= 1;
+    if(idx < 0 || idx >= actions.size()) {
+        luaL_error(L.lua_state(), "Out of bounds index.");
+        return false;
+    }
+    auto& selection = ref->Selection();
+    return selection.find(actions[idx]) != selection.end();
+}
+
+lua_Integer LuaFunscriptView::LowerBound(lua_Number time, sol::this_state L) const noexcept
+{
+    auto& actions = validActions(L);
+    return std::distance(actions.begin(), actions.lower_bound(FunscriptAction(time, 0))) + 1;
+}
+
+lua_Integer LuaFunscriptView::UpperBound(lua_Number time, sol::this_state L) const noexcept
+{
+    auto& actions = validActions(L);
+    return std::distance(actions.begin(), actions.upper_bound(FunscriptAction(time, 0))) + 1;
+}
+
+sol::object LuaFunscriptView::Range(lua_Number fromTime, lua_Number toTime, sol::this_state L) const noexcept
+{
+    auto& actions = validActions(L);
+    lua_Integer idx = std::distance(actions.begin(), actions.lower_bound(FunscriptAction(fromTime, 0)));
+    lua_Integer end = std::distance(actions.begin(), actions.upper_bound(FunscriptAction(toTime, 0)));
+
+    // for idx, at, pos in view:range(from, to) do ... end
+    auto view = *this;
+    auto next = [view, idx, end](sol::this_state L) mutable noexcept
+        -> sol::optional<std::tuple<lua_Integer, lua_Number, lua_Integer>> {
+        auto& actions = view.validActions(L);
+        if(idx >= end || idx >= actions.size()) {
+            return sol::optional<std::tuple<lua_Integer, lua_Number, lua_Integer>>();
+        }
+        auto action = actions[idx];
+        idx += 1;
+        return sol::make_optional(std::make_tuple(idx, (lua_Number)action.atS, (lua_Integer)action.pos));
+    };
+    return sol::make_object(L, next);
+}
+
+std::shared_ptr<const FunscriptArray> LuaFunscriptView::CopyActions() const noexcept
+{
+    if(!Valid()) return nullptr;
+    return std::make_shared<const FunscriptArray>(ref->Actions());
 }
\ No newline at end of file
@@ -13,6 +13,26 @@ struct LuaFunscriptAction
     FunscriptAction o;
     bool selected = false;
 
+    // bumped by every write which can reorder actions, see LuaFunscript::isSorted.
+    // assignments cover the table writes from lua as those copy into the vector.
+    inline static thread_local uint32_t Writes = 0;
+
+    LuaFunscriptAction(const LuaFunscriptAction&) noexcept = default;
+    LuaFunscriptAction(LuaFunscriptAction&&) noexcept = default;
+
+    inline LuaFunscriptAction& operator=(const LuaFunscriptAction& other) noexcept
+    {
+        o = other.o;
+        selected = other.selected;
+        Writes += 1;
+        return *this;
+    }
+
+    inline LuaFunscriptAction& operator=(LuaFunscriptAction&& other) noexcept
+    {
+        return *this = static_cast<const LuaFunscriptAction&>(other);
+    }
+
     LuaFunscriptAction(FunscriptAction action, bool selected) noexcept
         : o(action), selected(selected) 
     {}
@@ -35,6 +55,7 @@ struct LuaFunscriptAction
     inline void set_at(lua_Number at) noexcept
     {
         o.atS = std::max(0.0, at);
+        Writes += 1;
     }
 
     inline lua_Integer pos() noexcept
@@ -50,20 +71,69 @@ struct LuaFunscriptAction
 
 using LuaFunscriptArray = std::vector<LuaFunscriptAction>;
 
+// Read-only view over the live actions of a script. Nothing gets copied,
+// accessing it after the script changed raises an error.
+class LuaFunscriptView
+{
+    private:
+        std::weak_ptr<Funscript> script;
+        // main thread only, the weak_ptr guards against the script being gone
+        const Funscript* ref = nullptr;
+        uint32_t version = 0;
+
+        const FunscriptArray& validActions(sol::this_state L) const noexcept;
+    public:
+        LuaFunscriptView(const std::shared_ptr<Funscript>& script) noexcept;
+
+        bool Valid() const noexcept;
+        lua_Integer Length(sol::this_state L) const noexcept;
+        std::tuple<lua_Number, lua_Integer> Get(lua_Integer idx, sol::this_state L) const noexcept;
+        bool IsSelected(lua_Integer idx, sol::this_state L) const noexcept;
+        // index of the first action at or after time, length + 1 if there is none
+        lua_Integer LowerBound(lua_Number time, sol::this_state L) const noexcept;
+        // index of the first action after time, length + 1 if there is none
+        lua_Integer UpperBound(lua_Number time, sol::this_state L) const noexcept;
+        // iterator over index, at, pos of the actions in [fromTime, toTime]
+        sol::object Range(lua_Number fromTime, lua_Number toTime, sol::this_state L) const noexcept;
+        // nullptr if the view isn't valid anymore
+        std::shared_ptr<const FunscriptArray> CopyActions() const noexcept;
+};
+
 class LuaFunscript
 {
     private:
         int32_t scriptIdx = -1;
         std::weak_ptr<Funscript> script;
         LuaFunscriptArray actions;
+        // the actions are only copied once something could modify them
+        bool hasSnapshot = false;
+        // lua can reorder the actions at any time once it got the table, see isSorted
+        bool exposed = false;
+        // result of the last check, valid while no action was written and the size is the same
+        mutable bool sortedValid = false;
+        mutable bool sorted = true;
+        mutable uint32_t sortedWrites = 0;
+        mutable size_t sortedSize = 0;
         std::set<uint32_t> markedIndices;
+
+        // reads go to the live script until there is a snapshot
+        size_t count() const noexcept;
+        float atTime(size_t idx) const noexcept;
+        LuaFunscriptAction actionAt(size_t idx) const noexcept;
+
+        bool isSorted() const noexcept;
+        // only valid if isSorted
+        size_t lowerBound(lua_Number time) const noexcept;
+        size_t upperBound(lua_Number time) const noexcept;
     public:
         LuaFunscript(int32_t scriptIdx, std::weak_ptr<Funscript> script) noexcept;
         LuaFunscript(const FunscriptArray& actions) noexcept;
 
         inline void TakeSnapshot() noexcept
         {
+            if(hasSnapshot) return;
             OFS_PROFILE(__FUNCTION__);
+            hasSnapshot = true;
             auto ref = script.lock();
             if(ref) {
                 auto size = ref->Actions().size();
@@ -76,17 +146,29 @@ class LuaFunscript
 
         inline LuaFunscriptArray& Actions() noexcept 
         {
+            // the table can be modified from lua
+            TakeSnapshot();
+            exposed = true;
             return actions;
         }
 
         inline void Sort() noexcept
         {
+            TakeSnapshot();
             std::stable_sort(actions.begin(), actions.end(),
-                [](auto a1, auto a2) {
+                [](auto& a1, auto& a2) {
                     return a1.o.atS < a2.o.atS;
                 });
+            sortedValid = true;
+            sorted = true;
+            sortedWrites = LuaFunscriptAction::Writes;
+            sortedSize = actions.size();
         }
 
+        std::unique_ptr<LuaFunscriptView> View() const noexcept;
+        // immutable copy for jobs, see OFS_LuaJobAPI
+        std::shared_ptr<const FunscriptArray> CopyActions() const noexcept;
+
         void Commit(sol::this_state L) noexcept;
         bool HasSelection() const noexcept;
         std::vector<lua_Integer> SelectedIndices() const noexcept;
@@ -97,6 +179,9 @@ class LuaFunscript
         sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>> ClosestAction(lua_Number time) noexcept;
         sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>> ClosestActionAfter(lua_Number time) noexcept;
         sol::optional<std::tuple<LuaFunscriptAction, lua_Integer>> ClosestActionBefore(lua_Number time) noexcept;
+        // first and last index of the actions in [fromTime, toTime], last < first if there are none
+        std::tuple<lua_Integer, lua_Integer> ActionsInRange(lua_Number fromTime, lua_Number toTime, sol::this_state L) noexcept;
+        sol::optional<lua_Integer> IndexAtTime(lua_Number time, sol::optional<lua_Number> maxErrorTime, sol::this_state L) noexcept;
 
         void MarkForRemoval(lua_Integer actionIdx, sol::this_state L) noexcept;
         lua_Integer RemoveMarked() noexcept;
@@ -19,6 +19,7 @@ struct PreferenceState
 	int32_t currentTheme = static_cast<int32_t>(OFS_Theme::Dark);
 
 	int32_t fastStepAmount = 6;
+	int32_t frameBufferMemoryMb = 256;
 
 	int32_t	vsync = 0;
 	int32_t framerateLimit = 150;
@@ -37,6 +38,7 @@ REFL_TYPE(PreferenceState)
 	REFL_FIELD(defaultFontSize)
 	REFL_FIELD(currentTheme)
 	REFL_FIELD(fastStepAmount)
+	REFL_FIELD(frameBufferMemoryMb)
 	REFL_FIELD(vsync)
 	REFL_FIELD(framerateLimit)
 	REFL_FIELD(forceHwDecoding)
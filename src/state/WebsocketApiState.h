@@ -1,12 +1,14 @@
 #pragma once
 #include "OFS_StateHandle.h"
 #include <string>
+#include <cstdint>
 
 struct WebsocketApiState
 {
     static constexpr auto StateName = "WebsocketApi";
     std::string port = "8080";
     bool serverActive = false;
+    int32_t maxClientLagMs = 5000;
 
     static inline WebsocketApiState& State(uint32_t stateHandle) noexcept
     {
@@ -17,4 +19,5 @@ struct WebsocketApiState
 REFL_TYPE(WebsocketApiState)
     REFL_FIELD(port)
     REFL_FIELD(serverActive)
+    REFL_FIELD(maxClientLagMs)
 REFL_END
\ No newline at end of file